@@ -0,0 +1,309 @@
+/*!*******************************************************************************************
+ *  \file       DF_control_law.hpp
+ *  \brief      ROS-free differential flatness control law.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+#ifndef __DF_CONTROL_LAW_H__
+#define __DF_CONTROL_LAW_H__
+
+#include <string>
+#include <variant>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace controller_plugin_differential_flatness {
+
+struct UAV_reference {
+  Eigen::Vector3d position     = Eigen::Vector3d::Zero();
+  Eigen::Vector3d velocity     = Eigen::Vector3d::Zero();
+  Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+  double yaw                   = 0.0;
+};
+
+struct Acro_command {
+  Eigen::Vector3d PQR = Eigen::Vector3d::Zero();
+  double thrust       = 0.0;
+};
+
+struct DF_gains {
+  Eigen::Matrix3d Kp     = Eigen::Matrix3d::Zero();
+  Eigen::Matrix3d Kd     = Eigen::Matrix3d::Zero();
+  Eigen::Matrix3d Ki     = Eigen::Matrix3d::Zero();
+  Eigen::Matrix3d Kp_ang = Eigen::Matrix3d::Zero();
+  double mass            = 0.0;
+  double antiwindup_cte  = 0.0;
+};
+
+/**
+ * Gains as adopted by a running control loop, with everything derived from them precomputed.
+ * Built once per parameter update with makeGainSet and never modified afterwards.
+ */
+struct DF_gain_set {
+  DF_gains gains;
+  Eigen::Vector3d antiwindup_bound = Eigen::Vector3d::Zero();  // antiwindup_cte / ki, per axis
+  double alpha                     = 0.0;  // trajectory_control.alpha, not used by the law
+};
+
+DF_gain_set makeGainSet(const DF_gains &_gains, const double &_alpha);
+
+/**
+ * Attitude error of the current body to world rotation _rot_matrix with respect to _R_des,
+ * vee of (R_des^T R - R^T R_des) / 2
+ */
+template <typename Scalar>
+Eigen::Matrix<Scalar, 3, 1> computeAttitudeError(const Eigen::Matrix<Scalar, 3, 3> &_R_des,
+                                                 const Eigen::Matrix<Scalar, 3, 3> &_rot_matrix) {
+  const Eigen::Matrix<Scalar, 3, 3> Mat_e_rot =
+      _R_des.transpose() * _rot_matrix - _rot_matrix.transpose() * _R_des;
+  const Eigen::Matrix<Scalar, 3, 1> V_e_rot(Mat_e_rot(2, 1), Mat_e_rot(0, 2), Mat_e_rot(1, 0));
+  return static_cast<Scalar>(1.0f / 2.0f) * V_e_rot;
+}
+
+/** Gain structure policies */
+
+/* Full 3x3 gain matrices, allows coupling between axes */
+struct FullGains {
+  template <typename Scalar>
+  using Gain = Eigen::Matrix<Scalar, 3, 3>;
+
+  template <typename Scalar>
+  static Gain<Scalar> fromMatrix(const Eigen::Matrix3d &_gain) {
+    return _gain.cast<Scalar>();
+  }
+
+  template <typename Scalar>
+  static Eigen::Matrix<Scalar, 3, 1> apply(const Gain<Scalar> &_gain,
+                                           const Eigen::Matrix<Scalar, 3, 1> &_vector) {
+    return _gain * _vector;
+  }
+};
+
+/* Only the diagonal is used, each axis is a scalar product */
+struct DiagonalGains {
+  template <typename Scalar>
+  using Gain = Eigen::Matrix<Scalar, 3, 1>;
+
+  template <typename Scalar>
+  static Gain<Scalar> fromMatrix(const Eigen::Matrix3d &_gain) {
+    return _gain.diagonal().cast<Scalar>();
+  }
+
+  template <typename Scalar>
+  static Eigen::Matrix<Scalar, 3, 1> apply(const Gain<Scalar> &_gain,
+                                           const Eigen::Matrix<Scalar, 3, 1> &_vector) {
+    return _gain.cwiseProduct(_vector);
+  }
+};
+
+/** Anti-windup policies */
+
+/* Clamp each axis of the integral to antiwindup_cte / ki */
+struct ClampAntiwindup {
+  template <typename Scalar>
+  static void apply(Eigen::Matrix<Scalar, 3, 1> &_accum_pos_error,
+                    const Eigen::Matrix<Scalar, 3, 1> &_bound) {
+    _accum_pos_error = _accum_pos_error.cwiseMax(-_bound).cwiseMin(_bound);
+  }
+};
+
+/* Integral is never limited */
+struct NoAntiwindup {
+  template <typename Scalar>
+  static void apply(Eigen::Matrix<Scalar, 3, 1> & /*_accum_pos_error*/,
+                    const Eigen::Matrix<Scalar, 3, 1> & /*_bound*/) {}
+};
+
+/**
+ * Differential flatness control law, independent of ROS.
+ *
+ * Scalar is the type used for the computation, GainStructure and AntiwindupPolicy are one of the
+ * policies above, so every combination is resolved at compile time. The interface is always in
+ * double precision, inputs are converted once on entry and outputs once on exit.
+ *
+ * Only fixed-size Eigen types are used, so a call to computeTrajectoryControl never touches
+ * the heap. The integral term of the position loop is the only state kept between calls.
+ */
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+class DFControlLawT {
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+  using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+  using Gain    = typename GainStructure::template Gain<Scalar>;
+
+  DF_gains gains_;
+
+  // Gains in the layout used by the computation, refreshed by setGains
+  Gain Kp_{Gain::Zero()};
+  Gain Kd_{Gain::Zero()};
+  Gain Ki_{Gain::Zero()};
+  Gain Kp_ang_{Gain::Zero()};
+  Scalar mass_{0};
+  Vector3 antiwindup_bound_{Vector3::Zero()};
+
+  Vector3 accum_pos_error_{Vector3::Zero()};
+
+  Vector3 getForceT(const Scalar &_dt,
+                    const Vector3 &_pos_state,
+                    const Vector3 &_vel_state,
+                    const Vector3 &_pos_reference,
+                    const Vector3 &_vel_reference,
+                    const Vector3 &_acc_reference);
+
+  Vector3 getForceFeedforwardT(const Scalar &_dt,
+                               const Vector3 &_pos_state,
+                               const Vector3 &_vel_state,
+                               const Vector3 &_pos_reference,
+                               const Vector3 &_vel_reference,
+                               const Vector3 &_specific_force);
+
+  static Matrix3 computeDesiredAttitudeT(const Vector3 &_desired_force,
+                                         const Scalar &_yaw_angle_reference);
+
+  static Matrix3 computeDesiredAttitudeFromHeadingT(const Vector3 &_desired_force,
+                                                    const Vector3 &_heading);
+
+  Acro_command computeAttitudeControlT(const Vector3 &_desired_force,
+                                       const Matrix3 &_R_des,
+                                       const Matrix3 &_rot_matrix) const;
+
+public:
+  using scalar_type       = Scalar;
+  using gain_structure    = GainStructure;
+  using antiwindup_policy = AntiwindupPolicy;
+
+  DFControlLawT(){};
+  explicit DFControlLawT(const DF_gains &_gains) { setGains(_gains); };
+  ~DFControlLawT(){};
+
+  void setGains(const DF_gains &_gains) { setGains(makeGainSet(_gains, 0.0)); }
+  void setGains(const DF_gain_set &_gain_set);
+  const DF_gains &getGains() const { return gains_; }
+
+  void resetIntegral() { accum_pos_error_ = Vector3::Zero(); }
+  Eigen::Vector3d getIntegral() const { return accum_pos_error_.template cast<double>(); }
+  void setIntegral(const Eigen::Vector3d &_accum_pos_error) {
+    accum_pos_error_ = _accum_pos_error.cast<Scalar>();
+  }
+
+  /**
+   * Desired force in the world frame. Updates the integral of the position error.
+   */
+  Eigen::Vector3d getForce(const double &_dt,
+                           const Eigen::Vector3d &_pos_state,
+                           const Eigen::Vector3d &_vel_state,
+                           const Eigen::Vector3d &_pos_reference,
+                           const Eigen::Vector3d &_vel_reference,
+                           const Eigen::Vector3d &_acc_reference);
+
+  /**
+   * getForce with the feedforward part precomputed, _specific_force is _acc_reference minus
+   * gravity. The mass is still applied here, so the gains may change between calls.
+   */
+  Eigen::Vector3d getForceFeedforward(const double &_dt,
+                                      const Eigen::Vector3d &_pos_state,
+                                      const Eigen::Vector3d &_vel_state,
+                                      const Eigen::Vector3d &_pos_reference,
+                                      const Eigen::Vector3d &_vel_reference,
+                                      const Eigen::Vector3d &_specific_force);
+
+  /**
+   * Desired attitude whose z axis is aligned with the desired force and whose heading follows
+   * the yaw reference.
+   */
+  static Eigen::Matrix3d computeDesiredAttitude(const Eigen::Vector3d &_desired_force,
+                                                const double &_yaw_angle_reference);
+
+  /**
+   * computeDesiredAttitude with the heading (cos(yaw), sin(yaw), 0) precomputed. Only its
+   * direction is used, so it does not need to be unit length.
+   */
+  static Eigen::Matrix3d computeDesiredAttitudeFromHeading(const Eigen::Vector3d &_desired_force,
+                                                           const Eigen::Vector3d &_heading);
+
+  /**
+   * Body rates and collective thrust that drive the current attitude towards R_des.
+   */
+  Acro_command computeAttitudeControl(const Eigen::Vector3d &_desired_force,
+                                      const Eigen::Matrix3d &_R_des,
+                                      const Eigen::Matrix3d &_rot_matrix) const;
+
+  /**
+   * Full control law. _rot_matrix is the body to world rotation of the current attitude.
+   */
+  Acro_command computeTrajectoryControl(const double &_dt,
+                                        const Eigen::Vector3d &_pos_state,
+                                        const Eigen::Vector3d &_vel_state,
+                                        const Eigen::Matrix3d &_rot_matrix,
+                                        const Eigen::Vector3d &_pos_reference,
+                                        const Eigen::Vector3d &_vel_reference,
+                                        const Eigen::Vector3d &_acc_reference,
+                                        const double &_yaw_angle_reference);
+};
+
+// Instantiated in DF_control_law.cpp
+extern template class DFControlLawT<double, FullGains, ClampAntiwindup>;
+extern template class DFControlLawT<double, FullGains, NoAntiwindup>;
+extern template class DFControlLawT<double, DiagonalGains, ClampAntiwindup>;
+extern template class DFControlLawT<double, DiagonalGains, NoAntiwindup>;
+extern template class DFControlLawT<float, FullGains, ClampAntiwindup>;
+extern template class DFControlLawT<float, FullGains, NoAntiwindup>;
+extern template class DFControlLawT<float, DiagonalGains, ClampAntiwindup>;
+extern template class DFControlLawT<float, DiagonalGains, NoAntiwindup>;
+
+/* Reference law, same behaviour as the original plugin implementation */
+using DFControlLaw = DFControlLawT<double, FullGains, ClampAntiwindup>;
+
+/* Every instantiated law, for runtime selection without heap allocation */
+using DFControlLawVariant = std::variant<DFControlLawT<double, FullGains, ClampAntiwindup>,
+                                         DFControlLawT<double, FullGains, NoAntiwindup>,
+                                         DFControlLawT<double, DiagonalGains, ClampAntiwindup>,
+                                         DFControlLawT<double, DiagonalGains, NoAntiwindup>,
+                                         DFControlLawT<float, FullGains, ClampAntiwindup>,
+                                         DFControlLawT<float, FullGains, NoAntiwindup>,
+                                         DFControlLawT<float, DiagonalGains, ClampAntiwindup>,
+                                         DFControlLawT<float, DiagonalGains, NoAntiwindup>>;
+
+/**
+ * Replace _law with the instantiation named by _scalar_type ("double" or "float"),
+ * _gain_structure ("full" or "diagonal") and _antiwindup ("clamp" or "none"). Gains and the
+ * integral are carried over. Returns false and leaves _law untouched if a name is unknown.
+ */
+bool selectDFControlLaw(const std::string &_scalar_type,
+                        const std::string &_gain_structure,
+                        const std::string &_antiwindup,
+                        DFControlLawVariant &_law);
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,144 @@
+/*!*******************************************************************************************
+ *  \file       DF_control_law_batch.hpp
+ *  \brief      Structure-of-arrays differential flatness control law for many vehicles.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+#ifndef __DF_CONTROL_LAW_BATCH_H__
+#define __DF_CONTROL_LAW_BATCH_H__
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+using DF_batch_array = std::vector<double, Eigen::aligned_allocator<double>>;
+
+struct DF_batch_vec3 {
+  DF_batch_array x;
+  DF_batch_array y;
+  DF_batch_array z;
+
+  void resize(std::size_t _size) {
+    x.assign(_size, 0.0);
+    y.assign(_size, 0.0);
+    z.assign(_size, 0.0);
+  }
+};
+
+struct DF_batch_quaternion {
+  DF_batch_array w;
+  DF_batch_array x;
+  DF_batch_array y;
+  DF_batch_array z;
+
+  void resize(std::size_t _size) {
+    w.assign(_size, 1.0);
+    x.assign(_size, 0.0);
+    y.assign(_size, 0.0);
+    z.assign(_size, 0.0);
+  }
+};
+
+/**
+ * Structure-of-arrays buffers for N vehicles. Index i of every array belongs to vehicle i.
+ *
+ * Gains are per vehicle and diagonal, which is the only structure updateDFParameter writes.
+ * The integrator is kept in accum_pos_error, so consecutive calls carry it as
+ * DFControlLaw::getForce does.
+ */
+struct DF_batch {
+  std::size_t size = 0;
+
+  // State
+  DF_batch_vec3 position;
+  DF_batch_vec3 velocity;
+  DF_batch_quaternion attitude;
+
+  // Reference
+  DF_batch_vec3 ref_position;
+  DF_batch_vec3 ref_velocity;
+  DF_batch_vec3 ref_acceleration;
+  DF_batch_array ref_yaw;
+
+  // Gains
+  DF_batch_vec3 Kp;
+  DF_batch_vec3 Kd;
+  DF_batch_vec3 Ki;
+  DF_batch_vec3 Kp_ang;
+  DF_batch_array mass;
+  DF_batch_array antiwindup_cte;
+
+  // Integrator
+  DF_batch_vec3 accum_pos_error;
+
+  // Output
+  DF_batch_vec3 PQR;
+  DF_batch_array thrust;
+
+  void resize(std::size_t _size);
+
+  void setGains(std::size_t _index, const DF_gains &_gains);
+  Acro_command getCommand(std::size_t _index) const;
+};
+
+/**
+ * Run the control law for vehicles [_begin, _end). Disjoint ranges may be processed from
+ * different threads. Uses AVX2 when the CPU supports it and the library was built with it,
+ * otherwise a scalar loop with the same operation order.
+ */
+void computeTrajectoryControlBatch(DF_batch &_batch,
+                                   const double &_dt,
+                                   std::size_t _begin,
+                                   std::size_t _end);
+
+inline void computeTrajectoryControlBatch(DF_batch &_batch, const double &_dt) {
+  computeTrajectoryControlBatch(_batch, _dt, 0, _batch.size);
+}
+
+/** Scalar kernel, exposed to compare against the vectorized path */
+void computeTrajectoryControlBatchScalar(DF_batch &_batch,
+                                         const double &_dt,
+                                         std::size_t _begin,
+                                         std::size_t _end);
+
+/** True when computeTrajectoryControlBatch dispatches to the AVX2 kernel */
+bool batchKernelUsesAVX2();
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
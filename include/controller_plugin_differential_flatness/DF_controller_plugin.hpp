@@ -4,6 +4,10 @@
 
 #include <rclcpp/logging.hpp>
 #include <rclcpp/rclcpp.hpp>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <vector>
 
 #include "as2_core/utils/frame_utils.hpp"
@@ -11,84 +15,298 @@
 #include "as2_msgs/msg/thrust.hpp"
 #include "as2_msgs/msg/trajectory_point.hpp"
 #include "controller_plugin_base/controller_base.hpp"
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/controller_config.hpp"
+#include "controller_plugin_differential_flatness/command_mailbox.hpp"
+#include "controller_plugin_differential_flatness/controller_snapshot.hpp"
+#include "controller_plugin_differential_flatness/flight_recorder.hpp"
+#include "controller_plugin_differential_flatness/frame_id.hpp"
+#include "controller_plugin_differential_flatness/gain_schedule.hpp"
+#include "controller_plugin_differential_flatness/health_events.hpp"
+#include "controller_plugin_differential_flatness/latency_histogram.hpp"
+#include "controller_plugin_differential_flatness/lookahead_cache.hpp"
+#include "controller_plugin_differential_flatness/multi_rate_control.hpp"
+#include "controller_plugin_differential_flatness/parameter_table.hpp"
+#include "controller_plugin_differential_flatness/perf_counters.hpp"
+#include "controller_plugin_differential_flatness/realtime_thread.hpp"
+#include "controller_plugin_differential_flatness/spsc_queue.hpp"
+#include "controller_plugin_differential_flatness/state_predictor.hpp"
+#include "controller_plugin_differential_flatness/trajectory_reference_buffer.hpp"
+#include "controller_plugin_differential_flatness/trajectory_segment_store.hpp"
+#include "controller_plugin_differential_flatness/triple_buffer.hpp"
 
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <geometry_msgs/msg/pose_stamped.hpp>
 #include <geometry_msgs/msg/twist_stamped.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <nav_msgs/msg/odometry.hpp>
+#include <std_msgs/msg/float64.hpp>
+#include <std_msgs/msg/float64_multi_array.hpp>
+#include <std_msgs/msg/string.hpp>
+#include <std_srvs/srv/trigger.hpp>
 
 namespace controller_plugin_differential_flatness {
 
+/* Attitude is kept both as a unit quaternion and as the body to world rotation matrix, which is
+ * computed once per state update instead of once per tick */
 struct UAV_state {
-  Eigen::Vector3d position       = Eigen::Vector3d::Zero();
-  Eigen::Vector3d velocity       = Eigen::Vector3d::Zero();
-  tf2::Quaternion attitude_state = tf2::Quaternion::getIdentity();
+  Eigen::Quaterniond attitude = Eigen::Quaterniond::Identity();
+  Eigen::Matrix3d rotation    = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d position    = Eigen::Vector3d::Zero();
+  Eigen::Vector3d velocity    = Eigen::Vector3d::Zero();
+  double stamp                = 0.0;  // [s], pose header stamp, 0 if not set
 };
 
-struct UAV_reference {
-  Eigen::Vector3d position     = Eigen::Vector3d::Zero();
-  Eigen::Vector3d velocity     = Eigen::Vector3d::Zero();
-  Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
-  double yaw                   = 0.0;
+struct Control_flags {
+  std::atomic<bool> parameters_read{false};
+  std::atomic<bool> state_received{false};
+  std::atomic<bool> ref_received{false};
 };
 
-struct Acro_command {
-  Eigen::Vector3d PQR = Eigen::Vector3d::Zero();
-  double thrust       = 0.0;
+struct Reference_update {
+  UAV_reference reference;
+  double stamp        = 0.0;  // [s], only used by the reference buffer
+  uint32_t mode_epoch = 0;    // setMode call the reference was accepted under
 };
 
-struct Control_flags {
-  bool parameters_read = false;
-  bool state_received  = false;
-  bool ref_received    = false;
+struct Segment_update {
+  Trajectory_segment segment;
+  uint32_t mode_epoch = 0;
+};
+
+/* Stages of computeOutput with a latency histogram and hardware counters */
+enum class Latency_stage : uint8_t {
+  flag_checks,
+  inputs,  // law adoption, state and reference fetch, state prediction, gain scheduling
+  get_force,
+  attitude,  // desired attitude and attitude control
+  get_output,
+  total,  // whole computeOutput
+  count,
+};
+constexpr std::size_t latency_stage_count = static_cast<std::size_t>(Latency_stage::count);
+
+/* Command computed by the real-time thread, taken by computeOutput */
+struct Realtime_output {
+  Acro_command command;
+  rclcpp::Time stamp;
+  bool valid = false;  // false when the tick did not produce a command
 };
 
+/* Part of an instance in a hot standby pair */
+enum class Standby_role : uint8_t {
+  none,
+  primary,    // publishes a snapshot every tick
+  secondary,  // mirrors the primary, outputs nothing until the primary stops publishing
+};
+
+/* Result of one batch of parameter updates, never modified once published. Instances with the
+ * same gains may share one, see Plugin::shareControlLaw */
+struct Control_law_update {
+  DF_gain_set gain_set;
+  DFControlLawVariant law;  // selected instantiation with gain_set applied and no integral
+  std::shared_ptr<const GainSchedule> gain_schedule;  // replaces the gains every tick if set
+  uint16_t gain_schedule_generation = 0;
+  bool reset_integral               = true;  // trajectory_control.reset_integral of the batch
+};
+
+/** Update with the law and gains of _config, nullptr if the law it names is unknown */
+std::shared_ptr<const Control_law_update> makeControlLawUpdate(
+    const DF_controller_config &_config);
+
 class Plugin : public controller_plugin_base::ControllerBase {
+  // Owned by the thread running computeOutput, refreshed from the buffers below every tick
   UAV_state uav_state_;
+  UAV_state control_state_;  // uav_state_ predicted to the control instant
   UAV_reference control_ref_;
   Acro_command control_command_;
+  double control_stamp_ = 0.0;    // [s] control instant of the last tick
+  bool prewarming_      = false;  // the tick runs from prewarm, see there
+
+  // The integral is cleared before every tick while set, and carries over ticks when cleared. A
+  // hot standby primary only hands it over when it carries it
+  std::atomic<bool> reset_integral_{true};
+
+  // State and reference callbacks may run concurrently with computeOutput, each one is the only
+  // writer of its buffer
+  TripleBuffer<UAV_state> state_buffer_;
+  TripleBuffer<Reference_update> reference_buffer_;
+
+  // Timestamped references, queued by updateReference and interpolated by computeOutput
+  std::atomic<bool> use_reference_buffer_{false};
+  std::atomic<double> reference_lookahead_{0.0};
+  SPSCQueue<Reference_update, 256> reference_queue_;
+  TrajectoryReferenceBuffer reference_trajectory_;
+
+  // Polynomial segments, queued by segmentsCallback and evaluated by computeOutput. They take
+  // precedence over trajectory points while any is stored
+  std::atomic<bool> use_trajectory_segments_{false};
+  SPSCQueue<Segment_update, 64> segment_queue_;
+  TrajectorySegmentStore trajectory_segments_;
+  rclcpp::Subscription<std_msgs::msg::Float64MultiArray>::SharedPtr segments_sub_;
+
+  // Samples of the segments computed ahead by the lookahead cache thread. The cache is allocated
+  // by the first enable and then kept, the tick may hold it. flatness_ holds the terms of
+  // control_ref_ when the tick took them from the cache
+  std::atomic<bool> use_lookahead_cache_{false};
+  std::atomic<double> lookahead_sample_period_{0.002};
+  std::atomic<double> lookahead_horizon_{0.1};
+  std::unique_ptr<LookaheadCache> lookahead_storage_;
+  std::atomic<LookaheadCache *> lookahead_cache_{nullptr};
+  bool lookahead_resync_ = true;  // the cache lacks some of the stored segments
+  Flatness_sample flatness_;
+  bool flatness_valid_ = false;
+
+  // Latency compensation of the state, the applied horizon is published at a low rate
+  std::atomic<bool> use_state_prediction_{false};
+  std::atomic<double> max_prediction_horizon_{0.05};
+  std::atomic<double> prediction_horizon_{0.0};
+  rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr prediction_horizon_pub_;
+
+  // Latency of every stage, recorded by computeOutput and published at a low rate
+  std::atomic<bool> measure_latency_{false};
+  bool measuring_latency_       = false;  // measure_latency_ at the start of the current tick
+  uint64_t latency_stage_start_ = 0;      // [ns]
+  std::array<LatencyHistogram, latency_stage_count> latency_histograms_;
+  std::array<LatencyHistogram::Snapshot, latency_stage_count> latency_published_;
+  LatencyHistogram::Snapshot latency_current_;
+  LatencyHistogram::Snapshot latency_interval_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr latency_pub_;
+
+  // Hardware counters of every stage, read at the same points as the latency clock. The group is
+  // opened by the thread running the tick, summaries are dumped by the perf_counters service
+  std::atomic<bool> measure_perf_{false};
+  bool measuring_perf_ = false;  // measure_perf_ at the start of the current tick
+  PerfCounterGroup perf_group_;
+  std::thread::id perf_thread_;  // thread the group counts
+  Perf_sample perf_tick_start_;
+  Perf_sample perf_stage_start_;
+  Perf_sample perf_now_;
+  std::array<PerfStageCounters, latency_stage_count> perf_counters_;
+  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr perf_service_;
+
   Control_flags flags_;
-  bool hover_flag_ = false;
+  std::atomic<bool> hover_flag_{false};
+  std::atomic<bool> reset_reference_pending_{false};
+
+  // Input mode read by the callbacks and computeOutput, packed as control_mode | yaw_mode << 8
+  std::atomic<uint16_t> active_mode_in_{0};
+  std::atomic<uint32_t> mode_epoch_{0};
 
   as2_msgs::msg::ControlMode control_mode_in_;
   as2_msgs::msg::ControlMode control_mode_out_;
 
-  Eigen::Matrix3d Kp_{Eigen::Matrix3d::Zero()};
-  Eigen::Matrix3d Kd_{Eigen::Matrix3d::Zero()};
-  Eigen::Matrix3d Ki_{Eigen::Matrix3d::Zero()};
-  Eigen::Matrix3d Kp_ang_mat_{Eigen::Matrix3d::Zero()};
-
-  Eigen::Vector3d accum_pos_error_{Eigen::Vector3d::Zero()};
-
-  double mass_;
-  double antiwindup_cte_ = 0.0;
+  // Law and gains used by computeOutput, replaced at tick start when an update is published
+  DFControlLawVariant control_law_;
+  DF_gain_set gain_set_;
+
+  // Position loop at outer_loop_rate_, the attitude loop runs every tick on the latest attitude
+  std::atomic<double> outer_loop_rate_{0.0};
+  MultiRateControl multi_rate_;
+  uint32_t control_mode_epoch_ = 0;  // mode the held position loop output was computed under
+  TripleBuffer<std::shared_ptr<const Control_law_update>> law_buffer_;
+
+  // Gains sampled from the schedule of the adopted update at the current speed. The profile is a
+  // plain index, switched by profileCallback without going through the parameters. Packed as
+  // index | schedule generation << 16, so an index is never applied to another schedule
+  std::atomic<uint32_t> gain_profile_{0};
+  rclcpp::Subscription<std_msgs::msg::String>::SharedPtr gain_profile_sub_;
+
+  // Staged by the parameter callbacks, which are the only writers of law_buffer_
+  DF_gains staged_gains_;
+  double staged_alpha_ = 0.0;
+  DFControlLawVariant staged_law_;
+  std::string law_scalar_type_    = "double";
+  std::string law_gain_structure_ = "full";
+  std::string law_antiwindup_     = "clamp";
+  std::shared_ptr<const GainSchedule> staged_gain_schedule_;
+  uint16_t gain_schedule_generation_ = 0;
+  std::string gain_profile_name_;
+  std::atomic<uint32_t> parameters_to_read_{required_parameters_mask};  // bit per DF_parameter
+
+  // Real-time mode, the tick runs on realtime_thread_ and computeOutput only publishes its output.
+  // The options are staged by the parameter callbacks and applied at the end of the batch
+  bool realtime_enabled_         = false;
+  bool realtime_options_changed_ = false;
+  Realtime_options realtime_options_;
+  PeriodicThread realtime_thread_;
+  TripleBuffer<Realtime_output> realtime_output_;
+  Realtime_output realtime_command_;         // last output taken by computeOutput
+  std::atomic<bool> reset_pending_{false};  // reset() while the real-time thread owns the state
+
+  // Flight recorder, computeOutput pushes every tick and the recorder thread writes them to disk
+  bool recorder_enabled_         = false;
+  bool recorder_options_changed_ = false;
+  bool recorder_started_         = false;  // until stopped, even if its thread failed on a write
+  std::string recorder_directory_ = "/tmp";
+  FlightRecorder flight_recorder_;
+  uint64_t reported_recorder_overruns_ = 0;
+
+  // Command mailbox for a bridge on the same machine, written by computeCommand on every command
+  bool mailbox_enabled_         = false;
+  bool mailbox_options_changed_ = false;
+  std::string mailbox_name_;
+  CommandMailboxWriter command_mailbox_;
+
+  // Hot standby. The primary publishes a snapshot every tick, the secondary restores each new one
+  // and takes over when they stop for standby_timeout_. Options are staged by the parameter
+  // callbacks, the rest is owned by the tick
+  bool standby_options_changed_ = false;
+  std::string standby_role_name_ = "none";
+  std::string standby_channel_;
+  std::string standby_channel_name_;  // resolved name the secondary keeps trying to open
+  std::atomic<Standby_role> standby_role_{Standby_role::none};
+  std::atomic<double> standby_timeout_{0.05};
+  std::atomic<bool> standby_reset_{false};       // the tick forgets the primary and stands by
+  std::atomic<bool> standby_took_over_{false};  // set by the tick, logged by reportStandby
+  SnapshotChannelWriter snapshot_writer_;
+  SnapshotChannelReader snapshot_reader_;
+  uint64_t standby_sequence_    = 0;    // last snapshot restored, 0 for none
+  double standby_last_snapshot_ = 0.0;  // [s] control instant it was restored at
+  bool standby_active_          = false;
+
+  // Odometry subscription created by ownInitialize when trajectory_control.odometry_topic is set.
+  // It replaces the pose and twist path instead of running alongside it: updateState and
+  // updateOdometry both write state_buffer_, which takes a single writer, so updateState then
+  // drops every pair
+  bool use_odometry_ = false;
+  rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odometry_sub_;
 
   std::string odom_frame_id_      = "odom";
   std::string base_link_frame_id_ = "base_link";
 
-  const Eigen::Vector3d gravitational_accel_ = Eigen::Vector3d(0, 0, -9.81);
-
-  const std::vector<std::string> parameters_list_ = {
-      "mass",
-      "trajectory_control.antiwindup_cte",
-      "trajectory_control.alpha",
-      "trajectory_control.kp.x",
-      "trajectory_control.kp.y",
-      "trajectory_control.kp.z",
-      "trajectory_control.ki.x",
-      "trajectory_control.ki.y",
-      "trajectory_control.ki.z",
-      "trajectory_control.kd.x",
-      "trajectory_control.kd.y",
-      "trajectory_control.kd.z",
-      "trajectory_control.roll_control.kp",
-      "trajectory_control.pitch_control.kp",
-      "trajectory_control.yaw_control.kp",
-  };
-  std::vector<std::string> parameters_to_read_{parameters_list_};  // copy mutable
+  // Interned by ownInitialize, checked against every state message. Rejected messages are counted
+  // by the callbacks, per path as each accepts other frames, and reported by reportStateFrames at
+  // a low rate
+  InternedFrameId odom_frame_;
+  InternedFrameId base_link_frame_;
+  std::atomic<uint64_t> rejected_pose_twist_{0};  // by updateState
+  std::atomic<uint64_t> rejected_odometry_{0};    // by updateOdometry
+  uint64_t reported_pose_twist_ = 0;
+  uint64_t reported_odometry_   = 0;
+
+  // Health events, raised by the tick instead of logging and reported by reportHealth as logs
+  // and diagnostics on controller/health. computeOutput raises its own while the real-time thread
+  // runs the tick, each channel has a single producer
+  HealthEvents tick_events_;
+  HealthEvents output_events_;
+  HealthEventThrottle health_throttle_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr health_pub_;
+
+  // Every low rate report runs from report(), on this timer or when the owner calls it
+  bool external_reports_ = false;  // no timer, see useExternalReports
+  rclcpp::TimerBase::SharedPtr report_timer_;
+  uint32_t report_count_ = 0;
 
 public:
   Plugin(){};
-  ~Plugin(){};
+  ~Plugin() {
+    realtime_thread_.stop();
+    flight_recorder_.stop();
+    if (lookahead_storage_) {
+      lookahead_storage_->stop();
+    }
+  };
 
   /** Virtual functions from ControllerBase */
   void ownInitialize() override;
@@ -97,6 +315,39 @@ public:
 
   void updateReference(const as2_msgs::msg::TrajectoryPoint &ref) override;
 
+  /**
+   * State from a single odometry message instead of a pose and twist pair. The pose must be in the
+   * odom frame, and the twist in the odom or the base_link frame. Same threading as updateState,
+   * and never called concurrently with it: the plugin subscribes to the odometry_topic parameter
+   * when it is set and then ignores updateState, an owner calling it directly feeds only one.
+   */
+  void updateOdometry(const nav_msgs::msg::Odometry &_odom_msg);
+
+  /** State messages dropped so far because of their frame ids */
+  uint64_t getRejectedStates() const {
+    return rejected_pose_twist_.load(std::memory_order_relaxed) +
+           rejected_odometry_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Low rate reports: health events and the prediction horizon on every call, latency, recorder,
+   * standby and state frames on every fifth. A timer of the instance calls it at 5 Hz unless
+   * useExternalReports was called. Never call it from the thread that runs the ticks.
+   */
+  void report();
+
+  /**
+   * Run no report timer, the owner calls report() at about 5 Hz instead. Lets a host of many
+   * instances drive all their reports from one timer. Called before initialize, the timer is never
+   * created.
+   */
+  void useExternalReports();
+
+  /** Times _event was raised so far */
+  uint64_t getHealthEvents(Health_event _event) const {
+    return tick_events_.getCount(_event) + output_events_.getCount(_event);
+  }
+
   bool setMode(const as2_msgs::msg::ControlMode &mode_in,
                const as2_msgs::msg::ControlMode &mode_out) override;
 
@@ -115,12 +366,83 @@ public:
   rcl_interfaces::msg::SetParametersResult parametersCallback(
       const std::vector<rclcpp::Parameter> &parameters);
 
-private:
+  /**
+   * Run the whole tick _iterations times in hover, whatever the flags and the mode, so the pages
+   * and cache lines it touches are resident before arming. Nothing is recorded, published or
+   * written to the mailbox, and the integrator, command and standby state are restored afterwards.
+   * Inputs the callbacks published are taken as the first tick would take them, while reference
+   * resets and mode changes are left for it. Call it from the thread that runs the ticks before
+   * they start. The real-time thread does it on its own before its first tick.
+   */
+  void prewarm(std::size_t _iterations = 100);
+
+  /**
+   * Use _update instead of the gain parameters, until the next parameter update, including its
+   * reset_integral. Every instance flying the same gains can hold the same update, so they are
+   * parsed and stored once. The next tick still copies the law and the gain set out of it, since
+   * the law holds the integral of the instance and a gain schedule rewrites the gains. Call it
+   * from the thread that runs the parameter callbacks.
+   */
+  void shareControlLaw(std::shared_ptr<const Control_law_update> _update);
+
+  /**
+   * Integrator, reference and command of the last tick, under the mode it ran in. Call it from the
+   * thread that runs the ticks.
+   */
+  Controller_snapshot takeSnapshot() const;
+
+  /**
+   * Continue from _snapshot, so the next tick starts where the instance that took it left off.
+   * Returns false, and changes nothing, if it was taken under another mode than the current one.
+   * Call it from the thread that runs the ticks.
+   */
+  bool restoreSnapshot(const Controller_snapshot &_snapshot);
+
+protected:
   /** Controller especific functions */
-  bool checkParamList(const std::string &param, std::vector<std::string> &_params_list);
-
-  void updateDFParameter(std::string _parameter_name, const rclcpp::Parameter &_param);
-
+  void updateDFParameter(const std::string &_parameter_name, const rclcpp::Parameter &_param);
+  bool updateControlLaw();
+  void publishControlLaw();
+  void adoptControlLaw();
+  bool updateGainSchedule(const std::string &_path);
+  bool selectGainProfile(const std::string &_name);
+  void scheduleGains();
+  void updateRealtime();
+  void updateRecorder();
+  void stopRecorder();
+  void recordFlight(const double &_dt, const double &_now);
+  void reportRecorder();
+  void updateMailbox();
+  void updateLookahead();
+  void updateStandby();
+  void reportStandby();
+  bool followPrimary(const double &_now);
+  bool sampleLookahead(LookaheadCache &_cache, const double &_t);
+  void realtimeTick(double _dt);
+  bool computeCommand(const double &_dt, rclcpp::Time &_stamp);
+
+  void segmentsCallback(const std_msgs::msg::Float64MultiArray::SharedPtr _msg);
+  void profileCallback(const std_msgs::msg::String::SharedPtr _msg);
+  void storeState(const geometry_msgs::msg::Pose &_pose,
+                  const Eigen::Vector3d &_velocity,
+                  bool _body_velocity,
+                  const builtin_interfaces::msg::Time &_stamp);
+  void reportStateFrames();
+  void fetchInputs(const double &_now);
+  void predictState(const double &_now);
+  void publishPredictionHorizon();
+  void reportHealth();
+  void appendHealthStatus(const Health_record &_record,
+                          uint64_t _occurrences,
+                          diagnostic_msgs::msg::DiagnosticArray &_msg);
+  uint64_t beginLatency();
+  void recordLatency(Latency_stage _stage);
+  void recordTotalLatency(uint64_t _tick_start);
+  void publishLatency();
+  bool updatePerfCounters();
+  void dumpPerfCounters(const std::shared_ptr<std_srvs::srv::Trigger::Request> _request,
+                        std::shared_ptr<std_srvs::srv::Trigger::Response> _response);
+  void resetControlState();
   void resetState();
   void resetReferences();
   void resetCommands();
@@ -129,19 +451,15 @@ private:
                       geometry_msgs::msg::TwistStamped &twist,
                       as2_msgs::msg::Thrust &thrust);
 
-  bool getOutput(geometry_msgs::msg::TwistStamped &twist_msg, as2_msgs::msg::Thrust &thrust_msg);
-
-  Eigen::Vector3d getForce(const double &_dt,
-                           const Eigen::Vector3d &_pos_state,
-                           const Eigen::Vector3d &_vel_state,
-                           const Eigen::Vector3d &_pos_reference,
-                           const Eigen::Vector3d &_vel_reference,
-                           const Eigen::Vector3d &_acc_reference);
+  bool getOutput(const rclcpp::Time &_stamp,
+                 const Acro_command &_command,
+                 geometry_msgs::msg::TwistStamped &twist_msg,
+                 as2_msgs::msg::Thrust &thrust_msg);
 
   Acro_command computeTrajectoryControl(const double &_dt,
                                         const Eigen::Vector3d &_pos_state,
                                         const Eigen::Vector3d &_vel_state,
-                                        const tf2::Quaternion &_attitude_state,
+                                        const Eigen::Matrix3d &_rot_matrix,
                                         const Eigen::Vector3d &_pos_reference,
                                         const Eigen::Vector3d &_vel_reference,
                                         const Eigen::Vector3d &_acc_reference,
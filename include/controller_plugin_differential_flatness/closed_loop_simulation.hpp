@@ -0,0 +1,91 @@
+/*!*******************************************************************************************
+ *  \file       closed_loop_simulation.hpp
+ *  \brief      Closed loop simulation of the control law with a quadrotor plant.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __CLOSED_LOOP_SIMULATION_H__
+#define __CLOSED_LOOP_SIMULATION_H__
+
+#include <cstdint>
+#include <string>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/quadrotor_plant.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* Built in references, all start hovering or on the path so the metrics measure tracking */
+enum class Reference_trajectory : uint8_t {
+  step,        // 1 m step in x and y, 0.5 m in z and 0.5 rad in yaw at t = 1 s
+  circle,      // 2 m radius at 1 rad/s
+  lemniscate,  // figure eight, 2 m wide at 0.8 rad/s
+};
+
+bool parseReferenceTrajectory(const std::string &_name, Reference_trajectory &_trajectory);
+void sampleReferenceTrajectory(Reference_trajectory _trajectory,
+                               const double &_t,
+                               UAV_reference &_reference);
+
+struct Simulation_options {
+  Reference_trajectory trajectory = Reference_trajectory::circle;
+  double duration                 = 20.0;  // [s]
+  double control_dt               = 0.01;  // [s] period of computeTrajectoryControl
+  double outer_loop_rate          = 0.0;   // [Hz] translational loop, 0 runs it every tick
+  int plant_substeps              = 10;    // plant steps per control period
+  double mass_scale               = 1.0;   // plant mass over the configured mass
+  // As Plugin::computeOutput with trajectory_control.reset_integral set, its default
+  bool reset_integral_each_tick = true;
+  Plant_params plant;  // mass is taken from the law gains and mass_scale
+};
+
+struct Tracking_metrics {
+  uint64_t ticks            = 0;
+  double rms_position_error = 0.0;    // [m]
+  double max_position_error = 0.0;    // [m]
+  double rms_velocity_error = 0.0;    // [m/s]
+  double rms_yaw_error      = 0.0;    // [rad]
+  double max_tilt           = 0.0;    // [rad]
+  bool diverged             = false;  // position error above 100 m or not finite
+};
+
+/**
+ * Close the loop between _law and a QuadrotorPlant for _options.duration seconds. The law sees
+ * the exact plant state. Runs are deterministic, the same inputs give bitwise equal metrics.
+ */
+Tracking_metrics simulateClosedLoop(DFControlLawVariant &_law, const Simulation_options &_options);
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
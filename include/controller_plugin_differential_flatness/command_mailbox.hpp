@@ -0,0 +1,130 @@
+/*!*******************************************************************************************
+ *  \file       command_mailbox.hpp
+ *  \brief      Lock-free shared memory mailbox with the last command, for a co-located bridge.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __COMMAND_MAILBOX_H__
+#define __COMMAND_MAILBOX_H__
+
+#include <cstdint>
+#include <string>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/shm_seqlock_slot.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* Command read from a mailbox */
+struct Mailbox_command {
+  uint64_t sequence = 0;  // 1 for the first command ever written to the segment
+  int64_t stamp_ns  = 0;  // control instant in the clock of the writer
+  Acro_command command;
+};
+
+/**
+ * Layout of the POSIX shared memory segment, a single seqlock slot with magic "DFCMD\0\0\0" and
+ * the words stamp_ns, thrust and PQR. The command sequence is half of the slot counter.
+ */
+constexpr std::size_t command_mailbox_words = 5;
+using Command_mailbox_layout                = Seqlock_slot_layout<command_mailbox_words>;
+
+/**
+ * Writer side, owned by the controller. write never blocks, allocates or makes a system call, and
+ * is safe to call from any thread, including concurrently with open and close: a write racing
+ * another write is dropped.
+ *
+ * The segment is not removed on close, so a restarted writer keeps the sequence going and the
+ * readers already attached keep seeing its commands. Use remove to delete it.
+ */
+class CommandMailboxWriter {
+  SeqlockSlotWriter<command_mailbox_words> slot_;
+
+public:
+  CommandMailboxWriter(){};
+  ~CommandMailboxWriter(){};
+
+  CommandMailboxWriter(const CommandMailboxWriter &) = delete;
+  CommandMailboxWriter &operator=(const CommandMailboxWriter &) = delete;
+
+  /**
+   * Create or attach to the segment _name, a shm_open name such as "/df_commands". Closes the
+   * previous one. Returns false with the reason in _error.
+   */
+  bool open(const std::string &_name, std::string &_error);
+  void close() { slot_.close(); }
+
+  bool isOpen() const { return slot_.isOpen(); }
+  const std::string &getName() const { return slot_.getName(); }
+
+  /** Returns false if the mailbox is closed or another write is in progress */
+  bool write(const Acro_command &_command, int64_t _stamp_ns);
+
+  /** Delete the segment _name, readers already attached keep their mapping */
+  static bool remove(const std::string &_name) { return removeSharedSegment(_name); }
+};
+
+/**
+ * Reader side, for the bridge process. Read only, it never stalls the writer. A reader that
+ * polls faster than the controller sees the same sequence again, a slower one skips commands.
+ */
+class CommandMailboxReader {
+  SeqlockSlotReader<command_mailbox_words> slot_;
+
+public:
+  CommandMailboxReader(){};
+  ~CommandMailboxReader(){};
+
+  CommandMailboxReader(const CommandMailboxReader &) = delete;
+  CommandMailboxReader &operator=(const CommandMailboxReader &) = delete;
+
+  /** Attach to the segment _name. Fails until a writer has created it */
+  bool open(const std::string &_name, std::string &_error);
+  void close() { slot_.close(); }
+
+  bool isOpen() const { return slot_.isOpen(); }
+
+  /** Sequence of the last complete command, 0 if none. Cheap enough to poll */
+  uint64_t sequence() const { return slot_.sequence(); }
+
+  /**
+   * Copy of the last command. Returns false if nothing was written yet, or if the slot kept
+   * changing for _max_retries attempts, which only happens if the writer died during a write.
+   */
+  bool read(Mailbox_command &_command, int _max_retries = 1000) const;
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,89 @@
+/*!*******************************************************************************************
+ *  \file       controller_config.hpp
+ *  \brief      Plugin parameters applied without ROS, for the offline tools.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __CONTROLLER_CONFIG_H__
+#define __CONTROLLER_CONFIG_H__
+
+#include <string>
+#include <string_view>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/parameter_table.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* Parameters of the plugin that change the control law */
+struct DF_controller_config {
+  DF_gains gains;
+  double alpha               = 0.0;
+  std::string scalar_type    = "double";
+  std::string gain_structure = "full";
+  std::string antiwindup     = "clamp";
+  bool reset_integral        = true;  // clear the integral before every tick
+};
+
+/**
+ * Write a gain parameter (mass, antiwindup_cte, kp, ki, kd and the attitude kp) into _gains.
+ * Returns false for any other parameter.
+ */
+bool setGainParameter(DF_parameter _parameter, const double &_value, DF_gains &_gains);
+
+/**
+ * Set the parameter with full name _name from its text value, as Plugin::updateDFParameter does.
+ * Parameters that do not change the control law are accepted and ignored. Returns false for
+ * unknown names, values that are not numbers and reset_integral values other than true or false.
+ */
+bool setConfigParameter(std::string_view _name,
+                        const std::string &_value,
+                        DF_controller_config &_config,
+                        uint32_t &_parameters_to_read);
+
+/**
+ * Read a ROS 2 parameter file such as config/default_controller.yaml, taking the ros__parameters
+ * of every node in it, the wildcard one included. Nested keys form the plugin parameter names, as
+ * in trajectory_control.kp.x. Every required parameter must be present.
+ */
+bool loadControllerConfig(const std::string &_path,
+                          DF_controller_config &_config,
+                          std::string &_error);
+
+/** Law instantiation selected by _config with its gains set */
+bool makeControlLaw(const DF_controller_config &_config, DFControlLawVariant &_law);
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,135 @@
+/*!*******************************************************************************************
+ *  \file       controller_snapshot.hpp
+ *  \brief      Versioned snapshot of the controller state and its shared memory channel.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __CONTROLLER_SNAPSHOT_H__
+#define __CONTROLLER_SNAPSHOT_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <Eigen/Core>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/shm_seqlock_slot.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* State a controller needs to continue another one's flight without a transient */
+struct Controller_snapshot {
+  double stamp  = 0.0;  // [s], control instant of the tick it was taken at
+  uint16_t mode = 0;    // control_mode | yaw_mode << 8 of that tick
+  Eigen::Vector3d integral = Eigen::Vector3d::Zero();  // accumulated position error
+  UAV_reference reference;
+  Acro_command command;
+};
+
+/**
+ * Wire format, in 64 bit words: word 0 is version << 32 | word count, then stamp, mode, integral,
+ * reference position, velocity, acceleration and yaw, command PQR and thrust. Doubles are stored
+ * as their bit patterns. A new field goes at the end with a new version.
+ */
+constexpr uint32_t controller_snapshot_version = 1;
+constexpr std::size_t controller_snapshot_words = 20;
+using Snapshot_words                            = std::array<uint64_t, controller_snapshot_words>;
+
+void packSnapshot(const Controller_snapshot &_snapshot, Snapshot_words &_words);
+
+/** Returns false if _words were written by another version */
+bool unpackSnapshot(const Snapshot_words &_words, Controller_snapshot &_snapshot);
+
+/* Layout of the channel segment, a seqlock slot of the packed words with magic "DFSNAP\0\0" */
+using Snapshot_channel_layout = Seqlock_slot_layout<controller_snapshot_words>;
+
+/**
+ * Primary side of a hot standby pair, publishes a snapshot every tick to a POSIX shared memory
+ * segment. publish never blocks, allocates or makes a system call, and is safe to call while
+ * another thread opens or closes the channel.
+ */
+class SnapshotChannelWriter {
+  SeqlockSlotWriter<controller_snapshot_words> slot_;
+
+public:
+  SnapshotChannelWriter(){};
+  ~SnapshotChannelWriter(){};
+
+  SnapshotChannelWriter(const SnapshotChannelWriter &) = delete;
+  SnapshotChannelWriter &operator=(const SnapshotChannelWriter &) = delete;
+
+  /** Create or attach to the segment _name. Returns false with the reason in _error */
+  bool open(const std::string &_name, std::string &_error);
+  void close() { slot_.close(); }
+  bool isOpen() const { return slot_.isOpen(); }
+
+  /** Returns false if the channel is closed or another publish is in progress */
+  bool publish(const Controller_snapshot &_snapshot);
+
+  /** Delete the segment _name */
+  static bool remove(const std::string &_name) { return removeSharedSegment(_name); }
+};
+
+/**
+ * Standby side, reads the last snapshot of the primary. read never blocks or makes a system call,
+ * and is safe to call while another thread opens or closes the channel.
+ */
+class SnapshotChannelReader {
+  SeqlockSlotReader<controller_snapshot_words> slot_;
+
+public:
+  SnapshotChannelReader(){};
+  ~SnapshotChannelReader(){};
+
+  SnapshotChannelReader(const SnapshotChannelReader &) = delete;
+  SnapshotChannelReader &operator=(const SnapshotChannelReader &) = delete;
+
+  /** Attach to the segment _name. Fails until a primary has created it */
+  bool open(const std::string &_name, std::string &_error);
+  void close() { slot_.close(); }
+  bool isOpen() const { return slot_.isOpen(); }
+
+  /**
+   * Last snapshot and its sequence, 1 for the first one published to the segment. Returns false
+   * if the channel is closed, nothing was published, the writer is another version, or the slot
+   * kept changing for _max_retries attempts.
+   */
+  bool read(Controller_snapshot &_snapshot, uint64_t &_sequence, int _max_retries = 1000);
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
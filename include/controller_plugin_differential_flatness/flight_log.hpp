@@ -0,0 +1,85 @@
+/*!*******************************************************************************************
+ *  \file       flight_log.hpp
+ *  \brief      Recorded flights for offline replay of the control law.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __FLIGHT_LOG_H__
+#define __FLIGHT_LOG_H__
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* One computeOutput tick: inputs of the control law and the command that was sent */
+struct Flight_sample {
+  double dt = 0.0;
+  Eigen::Vector3d position    = Eigen::Vector3d::Zero();
+  Eigen::Vector3d velocity    = Eigen::Vector3d::Zero();
+  Eigen::Quaterniond attitude = Eigen::Quaterniond::Identity();
+  UAV_reference reference;
+  Acro_command command;
+};
+
+struct Flight_log {
+  std::string name;
+  std::vector<Flight_sample> samples;
+};
+
+/**
+ * Both formats store, per sample and in this order, 25 doubles:
+ *   dt, position xyz, velocity xyz, attitude wxyz, reference position xyz,
+ *   reference velocity xyz, reference acceleration xyz, reference yaw, command pqr, thrust
+ *
+ * CSV has a header line with these column names. Binary is little endian: the 8 byte magic
+ * "DFLOG\0\0\0", a uint32 version (1), a uint32 with the number of doubles per sample (25),
+ * a uint64 sample count and then the samples.
+ */
+constexpr std::size_t flight_sample_fields = 25;
+
+/** Load a flight, CSV if the extension is .csv and binary otherwise. _error is set on failure */
+bool loadFlightLog(const std::string &_path, Flight_log &_log, std::string &_error);
+
+bool saveFlightLogBinary(const std::string &_path, const Flight_log &_log);
+bool saveFlightLogCSV(const std::string &_path, const Flight_log &_log);
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
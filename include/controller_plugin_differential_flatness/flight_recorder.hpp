@@ -0,0 +1,194 @@
+/*!*******************************************************************************************
+ *  \file       flight_recorder.hpp
+ *  \brief      Lock-free recorder of the control law internals to a memory-mapped file.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __FLIGHT_RECORDER_H__
+#define __FLIGHT_RECORDER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/flight_log.hpp"
+#include "controller_plugin_differential_flatness/spsc_queue.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* One control tick: inputs, internals of the control law and the command, all in doubles */
+struct Flight_record {
+  double stamp;  // [s], control instant in the node clock
+  double dt;
+  double position[3];
+  double velocity[3];
+  double attitude[4];  // w, x, y, z
+  double ref_position[3];
+  double ref_velocity[3];
+  double ref_acceleration[3];
+  double ref_yaw;
+  double position_error[3];
+  double velocity_error[3];
+  double accum_pos_error[3];
+  double desired_force[3];
+  double R_des[9];  // row major
+  double E_rot[3];
+  double PQR[3];
+  double thrust;
+};
+
+constexpr std::size_t flight_record_fields = 50;
+static_assert(std::is_trivially_copyable<Flight_record>::value &&
+                  sizeof(Flight_record) == flight_record_fields * sizeof(double),
+              "Flight_record is written to disk as is");
+
+/**
+ * Fill _record from the state and reference of a tick and the law internals. Errors and E_rot are
+ * computed here, so the law does not export them on every tick.
+ */
+void fillFlightRecord(const double &_stamp,
+                      const double &_dt,
+                      const Eigen::Vector3d &_position,
+                      const Eigen::Vector3d &_velocity,
+                      const Eigen::Quaterniond &_attitude,
+                      const Eigen::Matrix3d &_rot_matrix,
+                      const UAV_reference &_reference,
+                      const Eigen::Vector3d &_accum_pos_error,
+                      const Eigen::Vector3d &_desired_force,
+                      const Eigen::Matrix3d &_R_des,
+                      const Acro_command &_command,
+                      Flight_record &_record);
+
+/** Inputs and command of _record, for control_law_replay */
+Flight_sample toFlightSample(const Flight_record &_record);
+
+/**
+ * Binary file, little endian: the 8 byte magic "DFREC\0\0\0", a uint32 version (1), a uint32 with
+ * the record size in bytes, a uint64 record count and then the records. The count is updated after
+ * every drain, so a file left by a crashed process is readable up to the last drain.
+ */
+bool loadFlightRecording(const std::string &_path,
+                         std::vector<Flight_record> &_records,
+                         std::string &_error);
+
+/**
+ * Records pushed by the control thread are queued in a fixed ring and appended by a background
+ * thread to a memory-mapped file. push never blocks, allocates or makes a system call: a full
+ * ring drops the record and counts an overrun.
+ *
+ * push is the producer side and must be called from a single thread at a time. start and stop are
+ * called from another thread, the producer may keep pushing while they run.
+ */
+class FlightRecorder {
+public:
+  static constexpr std::size_t queue_capacity = 1024;
+
+private:
+  using Queue = SPSCQueue<Flight_record, queue_capacity>;
+
+  // About 400 kB, only allocated by the first start and then kept, the producer may hold it
+  std::unique_ptr<Queue> queue_storage_;
+  std::atomic<Queue *> queue_{nullptr};
+  std::atomic<bool> recording_{false};
+  std::atomic<uint64_t> recorded_{0};
+  std::atomic<uint64_t> overruns_{0};
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_requested_ = false;
+
+  // File, only touched by the writer thread while it runs
+  int fd_                  = -1;
+  unsigned char *map_      = nullptr;
+  std::size_t mapped_size_ = 0;
+  uint64_t file_records_   = 0;
+  std::string path_;
+  std::string error_;
+
+  void run(double _drain_period);
+  bool drain();
+  bool reserve(uint64_t _records);
+  bool closeFile();
+
+public:
+  FlightRecorder(){};
+  ~FlightRecorder() { stop(); };
+
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+  /**
+   * Create _path and start appending to it every _drain_period seconds. Records queued before the
+   * call are discarded. Returns false with the reason in _error if the file can not be created.
+   */
+  bool start(const std::string &_path, double _drain_period, std::string &_error);
+
+  /** Append what is left in the ring and close the file. Returns false if a write failed */
+  bool stop();
+
+  /** Producer side, returns false without counting an overrun if the recorder never started */
+  bool push(const Flight_record &_record) {
+    Queue *queue = queue_.load(std::memory_order_acquire);
+    if (queue == nullptr) {
+      return false;
+    }
+    if (!queue->push(_record)) {
+      overruns_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  bool recording() const { return recording_.load(std::memory_order_acquire); }
+  uint64_t getRecorded() const { return recorded_.load(std::memory_order_relaxed); }
+  uint64_t getOverruns() const { return overruns_.load(std::memory_order_relaxed); }
+  /** Reason of the last failed write, only valid after stop */
+  const std::string &getError() const { return error_; }
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,83 @@
+/*!*******************************************************************************************
+ *  \file       flight_replay.hpp
+ *  \brief      Offline replay of recorded flights through the control law.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __FLIGHT_REPLAY_H__
+#define __FLIGHT_REPLAY_H__
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/flight_log.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+struct Replay_options {
+  // Plugin::computeOutput clears the integral before every tick, unless
+  // trajectory_control.reset_integral is false. Match the flight's setting to reproduce its
+  // commands
+  bool reset_integral_each_tick = true;
+};
+
+/* Difference between the replayed and the recorded commands of one or more flights */
+struct Replay_statistics {
+  uint64_t ticks             = 0;
+  double sum_sq_pqr_error    = 0.0;  // squared norm of the body rate error, summed
+  double max_pqr_error       = 0.0;  // [rad/s]
+  double sum_sq_thrust_error = 0.0;
+  double max_thrust_error    = 0.0;  // [N]
+
+  double rmsPQRError() const { return ticks ? std::sqrt(sum_sq_pqr_error / ticks) : 0.0; }
+  double rmsThrustError() const { return ticks ? std::sqrt(sum_sq_thrust_error / ticks) : 0.0; }
+
+  void merge(const Replay_statistics &_other);
+};
+
+/**
+ * Run every sample of _log through _law in order, as Plugin::computeTrajectoryControl does, so
+ * the integral is carried from one tick to the next. _law keeps its state after the call.
+ * If _commands is not null it receives the replayed command of every sample.
+ */
+Replay_statistics replayFlight(const Flight_log &_log,
+                               DFControlLawVariant &_law,
+                               const Replay_options &_options,
+                               std::vector<Acro_command> *_commands);
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,108 @@
+/*!*******************************************************************************************
+ *  \file       gain_schedule.hpp
+ *  \brief      Gain scheduling tables interpolated on the control tick.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __GAIN_SCHEDULE_H__
+#define __GAIN_SCHEDULE_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* Diagonals of Kp, Ki, Kd and Kp_ang, in this order */
+using Scheduled_gains = Eigen::Matrix<double, 12, 1>;
+
+/**
+ * Gain tables for several payload profiles. Each profile has its own mass and anti-windup
+ * constant and a table of gains over the vehicle speed, interpolated linearly between
+ * breakpoints and held beyond the ends.
+ *
+ * Loaded once from YAML:
+ *
+ *   profiles:
+ *     - name: nominal
+ *       mass: 0.82
+ *       antiwindup_cte: 1.0
+ *       points:
+ *         - speed: 0.0              # [m/s], strictly increasing
+ *           kp: [6.0, 6.0, 6.0]
+ *           ki: [0.005, 0.005, 0.065]
+ *           kd: [1.5, 1.5, 3.0]
+ *           kp_ang: [5.5, 5.5, 2.0]  # roll, pitch, yaw
+ *
+ * Breakpoints and gains of all profiles are stored back to back in two arrays, so a sample only
+ * reads a few contiguous cache lines and never allocates.
+ */
+class GainSchedule {
+  struct Profile {
+    std::string name;
+    double mass           = 0.0;
+    double antiwindup_cte = 0.0;
+    std::size_t first     = 0;  // index of the first breakpoint
+    std::size_t count     = 0;
+  };
+
+  std::vector<Profile> profiles_;
+  std::vector<double> speeds_;
+  std::vector<Scheduled_gains> gains_;
+
+public:
+  GainSchedule(){};
+  ~GainSchedule(){};
+
+  /** Replace the tables with the ones in the YAML file _path. Untouched on error */
+  bool loadFile(const std::string &_path, std::string &_error);
+  /** Same as loadFile, from YAML text */
+  bool loadString(const std::string &_yaml, std::string &_error);
+
+  std::size_t profileCount() const { return profiles_.size(); }
+  const std::string &profileName(std::size_t _profile) const { return profiles_[_profile].name; }
+  /** Index of the profile called _name, or profileCount() if there is none */
+  std::size_t findProfile(const std::string &_name) const;
+
+  /** Gains of _profile at _speed. _profile must be below profileCount() */
+  void sample(std::size_t _profile, const double &_speed, DF_gains &_gains) const;
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,171 @@
+/*!*******************************************************************************************
+ *  \file       health_events.hpp
+ *  \brief      Health events raised by the control tick and reported off the tick.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __HEALTH_EVENTS_H__
+#define __HEALTH_EVENTS_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "controller_plugin_differential_flatness/spsc_queue.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* Conditions the control tick reports instead of logging them */
+enum class Health_event : uint8_t {
+  state_not_received,
+  reference_not_received,
+  parameters_missing,        // detail: bits of the required parameters not read, see parameterBit
+  unknown_yaw_mode,          // detail: yaw mode
+  unknown_control_mode,      // detail: control mode
+  realtime_command_stale,    // detail: age of the command [us]
+  perf_counters_disabled,    // detail: errno of the failed open
+  perf_counter_unavailable,  // detail: bits of the Perf_event not available
+  count,
+};
+constexpr std::size_t health_event_count = static_cast<std::size_t>(Health_event::count);
+
+/* Same values as the levels of diagnostic_msgs/DiagnosticStatus */
+enum class Health_level : uint8_t {
+  ok    = 0,
+  warn  = 1,
+  error = 2,
+};
+
+struct Health_event_info {
+  const char *name;
+  Health_level level;
+  double report_period;  // [s] shortest interval between two reports
+  bool report_changes;   // a new detail is reported regardless of report_period
+};
+
+/* Indexed by Health_event */
+constexpr std::array<Health_event_info, health_event_count> health_event_info = {{
+    {"state_not_received", Health_level::warn, 5.0, false},
+    {"reference_not_received", Health_level::warn, 5.0, false},
+    {"parameters_missing", Health_level::warn, 5.0, true},
+    {"unknown_yaw_mode", Health_level::error, 5.0, true},
+    {"unknown_control_mode", Health_level::error, 5.0, true},
+    {"realtime_command_stale", Health_level::error, 1.0, false},
+    {"perf_counters_disabled", Health_level::error, 0.0, false},
+    {"perf_counter_unavailable", Health_level::warn, 0.0, false},
+}};
+
+struct Health_record {
+  Health_event event = Health_event::count;
+  uint64_t detail    = 0;  // of the last raise
+  uint64_t count     = 0;  // raises of the event so far
+};
+
+/**
+ * Events raised by the control tick, drained by a non real-time thread that formats and reports
+ * them.
+ *
+ * raise() is wait-free and never formats, allocates or locks. It counts the event and queues its
+ * code, unless the code is still queued, in which case only the count and the detail change. A
+ * fault repeating every tick takes a single queue slot, so the queue never fills. One producer
+ * thread and one consumer thread.
+ */
+class HealthEvents {
+  SPSCQueue<Health_event, 16> queue_;
+  std::array<std::atomic<uint64_t>, health_event_count> counts_{};
+  std::array<std::atomic<uint64_t>, health_event_count> details_{};
+  std::array<std::atomic<bool>, health_event_count> queued_{};
+
+  static_assert(health_event_count <= 16, "Every event must fit in the queue at once");
+
+public:
+  HealthEvents(){};
+  ~HealthEvents(){};
+
+  HealthEvents(const HealthEvents &) = delete;
+  HealthEvents &operator=(const HealthEvents &) = delete;
+
+  /** Producer side */
+  void raise(Health_event _event, uint64_t _detail = 0) {
+    const std::size_t i = static_cast<std::size_t>(_event);
+    details_[i].store(_detail, std::memory_order_relaxed);
+    counts_[i].store(counts_[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (!queued_[i].exchange(true, std::memory_order_acq_rel)) {
+      queue_.push(_event);
+    }
+  }
+
+  /** Consumer side, returns false if no event was raised since the last pop */
+  bool pop(Health_record &_record);
+
+  /** Times _event was raised, any thread */
+  uint64_t getCount(Health_event _event) const {
+    return counts_[static_cast<std::size_t>(_event)].load(std::memory_order_relaxed);
+  }
+};
+
+/**
+ * Rate limit of the reports of every event, see Health_event_info. Owned by the reporting thread.
+ */
+class HealthEventThrottle {
+  std::array<double, health_event_count> last_report_;
+  std::array<uint64_t, health_event_count> reported_counts_{};
+  std::array<uint64_t, health_event_count> reported_details_{};
+  std::array<Health_record, health_event_count> pending_{};  // event is count if none
+
+public:
+  HealthEventThrottle();
+
+  /**
+   * True if _record is due for a report at _now [s]. _occurrences is then set to the raises since
+   * the last report of the event. A record that is not due is kept pending until takeDue returns
+   * it, or a later record of the same event is admitted.
+   */
+  bool admit(const Health_record &_record, const double &_now, uint64_t &_occurrences);
+
+  /**
+   * A pending record whose report period expired at _now, admitted as by admit. Call it until it
+   * returns false, so an event that is not raised again is still reported.
+   */
+  bool takeDue(const double &_now, Health_record &_record, uint64_t &_occurrences);
+};
+
+/** Log message of _record. Allocates, never call it from the tick */
+std::string describeHealthEvent(const Health_record &_record);
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
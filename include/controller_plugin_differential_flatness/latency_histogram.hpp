@@ -0,0 +1,112 @@
+/*!*******************************************************************************************
+ *  \file       latency_histogram.hpp
+ *  \brief      Lock-free fixed bucket latency histogram.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __LATENCY_HISTOGRAM_H__
+#define __LATENCY_HISTOGRAM_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace controller_plugin_differential_flatness {
+
+/**
+ * Latency histogram with log-linear buckets, as in HDR histograms. Values below 2^sub_bucket_bits
+ * have their own bucket, above that every power of two is split in 2^sub_bucket_bits buckets,
+ * so the relative error of a reported value is below 2^-sub_bucket_bits (~6%). Values are in
+ * nanoseconds and saturate at 2^max_exponent ns (~68 s).
+ *
+ * record() is wait-free and only does relaxed loads and stores, so there must be a single
+ * writer. Any thread may take a snapshot() concurrently, counts are monotonic and a snapshot
+ * is at most one sample behind.
+ */
+class LatencyHistogram {
+public:
+  static constexpr uint8_t sub_bucket_bits      = 4;
+  static constexpr uint8_t max_exponent         = 36;
+  static constexpr std::size_t sub_bucket_count = std::size_t(1) << sub_bucket_bits;
+  static constexpr std::size_t bucket_count =
+      (max_exponent - sub_bucket_bits + 2) * sub_bucket_count;
+
+  /* Copy of the counts, differences of snapshots give the distribution of an interval */
+  struct Snapshot {
+    std::array<uint64_t, bucket_count> counts{};
+    uint64_t count  = 0;
+    uint64_t max_ns = 0;  // exact maximum since the histogram was created
+
+    /* Upper bound of the bucket holding the _quantile (0..1) sample, 0 if empty */
+    uint64_t percentile(const double &_quantile) const;
+    /* Upper bound of the highest non empty bucket, 0 if empty */
+    uint64_t maxBucket() const;
+  };
+
+private:
+  std::array<std::atomic<uint64_t>, bucket_count> counts_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> max_ns_{0};
+
+public:
+  LatencyHistogram(){};
+  ~LatencyHistogram(){};
+
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  static std::size_t bucketIndex(uint64_t _value_ns);
+  static uint64_t bucketUpperBound(std::size_t _index);
+
+  /** Writer side */
+  void record(uint64_t _value_ns) {
+    std::atomic<uint64_t> &bucket = counts_[bucketIndex(_value_ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (_value_ns > max_ns_.load(std::memory_order_relaxed)) {
+      max_ns_.store(_value_ns, std::memory_order_relaxed);
+    }
+  }
+
+  /** Reader side, any thread */
+  void snapshot(Snapshot &_snapshot) const;
+
+  /** Counts recorded between _previous and _current, max_ns is the one of _current */
+  static void difference(const Snapshot &_current, const Snapshot &_previous, Snapshot &_result);
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,165 @@
+/*!*******************************************************************************************
+ *  \file       lookahead_cache.hpp
+ *  \brief      Flatness terms of the reference precomputed over the upcoming horizon.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __LOOKAHEAD_CACHE_H__
+#define __LOOKAHEAD_CACHE_H__
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <Eigen/Core>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+#include "controller_plugin_differential_flatness/spsc_queue.hpp"
+#include "controller_plugin_differential_flatness/trajectory_segment_store.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* Terms of the control law that only depend on the reference */
+struct Flatness_sample {
+  UAV_reference reference;
+  Eigen::Vector3d specific_force = Eigen::Vector3d::Zero();  // acceleration minus gravity
+  Eigen::Vector3d heading        = Eigen::Vector3d::UnitX();  // (cos(yaw), sin(yaw), 0)
+};
+
+/** Reference terms of _reference, as sampled by the cache */
+Flatness_sample makeFlatnessSample(const UAV_reference &_reference);
+
+struct Lookahead_options {
+  double sample_period = 0.002;  // [s] between cached samples
+  double horizon       = 0.1;    // [s] kept filled ahead of the last sampled instant
+};
+
+/**
+ * Samples of the trajectory segments on a fixed time grid, filled ahead of the control tick by a
+ * background thread, so the tick replaces the polynomial evaluation and the trigonometry by a
+ * linear interpolation between two cached samples.
+ *
+ * The consumer side (reset, pushSegment, sample) belongs to a single thread, the control tick.
+ * Segments reach the worker through a queue, and every push or reset starts a new epoch: samples
+ * built before the worker caught up with it are never returned, sample misses instead and the
+ * caller evaluates the segments itself. Nothing the consumer calls blocks or allocates.
+ *
+ * start and stop run the worker, from any other thread.
+ */
+class LookaheadCache {
+public:
+  static constexpr std::size_t capacity       = 256;  // samples, bounds horizon / sample_period
+  static constexpr std::size_t queue_capacity = 128;
+
+private:
+  struct Command {
+    bool reset = false;  // clear the segments and restart the grid, otherwise push segment
+    double origin = 0.0;
+    Lookahead_options options;
+    Trajectory_segment segment;
+  };
+
+  SPSCQueue<Command, queue_capacity> commands_;
+  std::array<Flatness_sample, capacity> samples_;  // sample n of the grid lives in n % capacity
+
+  // Last epoch requested by the consumer, and the epoch and end index of the samples built
+  // for it, packed as epoch << 48 | end
+  std::atomic<uint32_t> requested_epoch_{0};
+  std::atomic<uint64_t> window_{0};
+  // First grid index the consumer may still read, the worker never overwrites it
+  std::atomic<int64_t> cursor_{0};
+
+  // Consumer side
+  uint32_t epoch_   = 0;
+  bool epoch_valid_ = false;  // every command of the epoch reached the queue
+  double origin_    = 0.0;
+  Lookahead_options options_;
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+
+  // Worker side
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_requested_ = false;
+  TrajectorySegmentStore segments_;
+  uint32_t built_epoch_ = 0;
+  double worker_origin_ = 0.0;
+  Lookahead_options worker_options_;
+  int64_t next_ = 0;  // next grid index to fill
+
+  void run();
+  void catchUp();
+  void fill();
+  void requestEpoch();
+
+public:
+  LookaheadCache(){};
+  ~LookaheadCache() { stop(); };
+
+  LookaheadCache(const LookaheadCache &) = delete;
+  LookaheadCache &operator=(const LookaheadCache &) = delete;
+
+  void start();
+  void stop();
+  bool running() const { return thread_.joinable(); }
+
+  /**
+   * Drop every segment and sample, the grid restarts at _now with _options. Returns false if the
+   * queue is full, nothing is served until a reset succeeds.
+   */
+  bool reset(const double &_now, const Lookahead_options &_options);
+
+  /** Returns false if the queue is full, nothing is served until the next reset */
+  bool pushSegment(const Trajectory_segment &_segment);
+
+  /**
+   * Interpolated terms at _t. Returns false when they are not cached: before the worker built the
+   * current epoch, past the filled horizon, or at a time earlier than a previous call. A miss
+   * moves the horizon forward to _t, later calls from _t on are served again once it is filled.
+   */
+  bool sample(const double &_t, Flatness_sample &_sample);
+
+  const Lookahead_options &getOptions() const { return options_; }
+  uint64_t getHits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t getMisses() const { return misses_.load(std::memory_order_relaxed); }
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
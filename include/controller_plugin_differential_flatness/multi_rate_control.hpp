@@ -0,0 +1,111 @@
+/*!*******************************************************************************************
+ *  \file       multi_rate_control.hpp
+ *  \brief      Outer position loop running slower than the attitude loop.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __MULTI_RATE_CONTROL_H__
+#define __MULTI_RATE_CONTROL_H__
+
+#include <Eigen/Core>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/**
+ * Schedule and output of the translational loop (getForce and the desired attitude) when it runs
+ * at a lower rate than the attitude loop. Between runs the desired force and attitude are held,
+ * and the attitude loop turns them into body rates and thrust with the latest attitude.
+ */
+class MultiRateControl {
+  double period_  = 0.0;  // [s], 0 runs the outer loop every tick
+  double elapsed_ = 0.0;  // [s] since the last outer loop run
+  bool valid_     = false;
+
+  Eigen::Vector3d desired_force_ = Eigen::Vector3d::Zero();
+  Eigen::Matrix3d R_des_         = Eigen::Matrix3d::Identity();
+
+public:
+  MultiRateControl(){};
+  ~MultiRateControl(){};
+
+  /** Outer loop rate in Hz, 0 or less runs it every tick. A new rate invalidates the output */
+  void setRate(const double &_rate);
+  double getPeriod() const { return period_; }
+
+  /** Force the outer loop to run on the next tick, e.g. after a reference reset or new gains */
+  void invalidate() { valid_ = false; }
+
+  /**
+   * Advance by one tick of _dt. Returns true when the outer loop has to run, in which case
+   * _outer_dt is the time it covers, to be used as the integration step of the position loop.
+   * The outer loop runs on the tick closest to its period.
+   */
+  bool outerLoopDue(const double &_dt, double &_outer_dt);
+
+  void storeOuterLoop(const Eigen::Vector3d &_desired_force, const Eigen::Matrix3d &_R_des);
+  const Eigen::Vector3d &getDesiredForce() const { return desired_force_; }
+  const Eigen::Matrix3d &getDesiredAttitude() const { return R_des_; }
+};
+
+/**
+ * One tick of _law at the attitude rate. The translational part runs only when _multi_rate says
+ * it is due, otherwise its last output is reused.
+ */
+template <typename Law>
+Acro_command computeMultiRateControl(Law &_law,
+                                     MultiRateControl &_multi_rate,
+                                     const double &_dt,
+                                     const Eigen::Vector3d &_pos_state,
+                                     const Eigen::Vector3d &_vel_state,
+                                     const Eigen::Matrix3d &_rot_matrix,
+                                     const Eigen::Vector3d &_pos_reference,
+                                     const Eigen::Vector3d &_vel_reference,
+                                     const Eigen::Vector3d &_acc_reference,
+                                     const double &_yaw_angle_reference) {
+  double outer_dt = _dt;
+  if (_multi_rate.outerLoopDue(_dt, outer_dt)) {
+    const Eigen::Vector3d desired_force = _law.getForce(
+        outer_dt, _pos_state, _vel_state, _pos_reference, _vel_reference, _acc_reference);
+    _multi_rate.storeOuterLoop(desired_force,
+                               _law.computeDesiredAttitude(desired_force, _yaw_angle_reference));
+  }
+  return _law.computeAttitudeControl(_multi_rate.getDesiredForce(),
+                                     _multi_rate.getDesiredAttitude(), _rot_matrix);
+}
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,148 @@
+/*!*******************************************************************************************
+ *  \file       multi_vehicle_host.hpp
+ *  \brief      Many plugin instances in one process, behind a single executor and a batched tick.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __MULTI_VEHICLE_HOST_H__
+#define __MULTI_VEHICLE_HOST_H__
+
+#include <rclcpp/rclcpp.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "as2_core/node.hpp"
+#include "as2_msgs/msg/thrust.hpp"
+#include "as2_msgs/msg/trajectory_point.hpp"
+#include "controller_plugin_differential_flatness/DF_controller_plugin.hpp"
+#include "controller_plugin_differential_flatness/thread_pool.hpp"
+
+#include <geometry_msgs/msg/pose_stamped.hpp>
+#include <geometry_msgs/msg/twist_stamped.hpp>
+
+namespace controller_plugin_differential_flatness {
+
+/* One hosted vehicle: its node, its plugin and the intra-process endpoints the host drives */
+struct Hosted_vehicle {
+  std::shared_ptr<as2::Node> node;
+  std::shared_ptr<Plugin> plugin;
+  std::size_t profile = 0;
+
+  rclcpp::Subscription<geometry_msgs::msg::PoseStamped>::SharedPtr pose_sub;
+  rclcpp::Subscription<geometry_msgs::msg::TwistStamped>::SharedPtr twist_sub;
+  rclcpp::Subscription<as2_msgs::msg::TrajectoryPoint>::SharedPtr reference_sub;
+  rclcpp::Publisher<geometry_msgs::msg::TwistStamped>::SharedPtr twist_pub;
+  rclcpp::Publisher<as2_msgs::msg::Thrust>::SharedPtr thrust_pub;
+
+  // Last pose, paired with the next twist as the controller handler does
+  geometry_msgs::msg::PoseStamped pose;
+  bool pose_received = false;
+
+  // Written by the batched tick
+  geometry_msgs::msg::PoseStamped pose_out;
+  geometry_msgs::msg::TwistStamped twist_out;
+  as2_msgs::msg::Thrust thrust_out;
+};
+
+/**
+ * Node hosting many instances of the plugin, one per vehicle, as a replacement for one controller
+ * process per vehicle.
+ *
+ * Each vehicle gets a lightweight node in its own namespace, without parameter services, and every
+ * node uses intra-process communication, so a simulator in the same process exchanges state and
+ * commands without serialization. The host and all vehicle nodes are spun by one executor.
+ *
+ * Gains come from one file per profile, in the format of loadControllerConfig. Each profile is
+ * parsed once into an immutable Control_law_update shared by all the vehicles flying it, with its
+ * reset_integral. Each plugin still copies the law and the gain set out of it, as they hold the
+ * integral and the scheduled gains of the vehicle.
+ *
+ * A single timer runs the control tick of every vehicle, spread over a ThreadPool, and publishes
+ * the commands. The same timer drives the low rate reports of the plugins, which create no timers
+ * of their own: each tick reports a slice of the vehicles, so each one reports at about 5 Hz.
+ *
+ * The host replaces the controller handler of each vehicle: its state, reference and command
+ * endpoints below, or the plugin's own odometry subscription when odometry_topic is set. Still
+ * per vehicle are the endpoints of the plugin itself, under controller/ in the vehicle namespace:
+ * the trajectory_segments and gain_profile subscriptions, the prediction_horizon, latency and
+ * health publishers and the perf_counters service.
+ * Parameters of the host node:
+ *   vehicles          number of vehicles
+ *   namespace_prefix  vehicle i lives in /<prefix><i>
+ *   rate              [Hz] of the batched tick
+ *   threads           workers of the tick, 0 for one per core
+ *   gains_files       one file per profile
+ *   vehicle_profiles  profile of vehicle i is vehicle_profiles[i % size], all 0 if empty
+ *   odometry_topic    state from nav_msgs/Odometry on this topic of every vehicle instead of
+ *                     the pose and twist topics, empty for pose and twist
+ */
+class MultiVehicleHost : public rclcpp::Node {
+  std::vector<std::shared_ptr<const Control_law_update>> profiles_;
+  std::vector<Hosted_vehicle> vehicles_;
+  std::string odometry_topic_;
+  std::vector<uint8_t> produced_;  // computeOutput result of every vehicle in the last tick
+  std::unique_ptr<ThreadPool> pool_;
+  rclcpp::TimerBase::SharedPtr tick_timer_;
+  double period_             = 0.0;  // [s] of tick_timer_, dt of the first tick
+  std::size_t report_stride_ = 1;    // ticks between two reports of a vehicle
+  std::size_t report_phase_  = 0;    // first vehicle reported by the next tick
+  std::chrono::steady_clock::time_point last_tick_;
+  bool first_tick_ = true;
+
+  bool loadProfiles(const std::vector<std::string> &_gains_files);
+  void addVehicle(std::size_t _index, const std::string &_namespace, std::size_t _profile);
+  void tick();
+
+public:
+  explicit MultiVehicleHost(const rclcpp::NodeOptions &_options = rclcpp::NodeOptions());
+  ~MultiVehicleHost(){};
+
+  /** Add the host and every vehicle node to _executor */
+  void addToExecutor(rclcpp::Executor &_executor);
+
+  std::size_t vehicleCount() const { return vehicles_.size(); }
+  std::size_t profileCount() const { return profiles_.size(); }
+  const Hosted_vehicle &vehicle(std::size_t _index) const { return vehicles_[_index]; }
+  /** Update shared by the vehicles flying _profile */
+  const std::shared_ptr<const Control_law_update> &profile(std::size_t _profile) const {
+    return profiles_[_profile];
+  }
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,243 @@
+/*!*******************************************************************************************
+ *  \file       parameter_table.hpp
+ *  \brief      Compile time lookup table of the plugin parameter names.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __PARAMETER_TABLE_H__
+#define __PARAMETER_TABLE_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace controller_plugin_differential_flatness {
+
+/* Every parameter handled by the plugin. The required ones come first, in bit order */
+enum class DF_parameter : uint8_t {
+  mass,
+  antiwindup_cte,
+  alpha,
+  kp_x,
+  kp_y,
+  kp_z,
+  ki_x,
+  ki_y,
+  ki_z,
+  kd_x,
+  kd_y,
+  kd_z,
+  roll_kp,
+  pitch_kp,
+  yaw_kp,
+  // Optional, they have a default value
+  law_scalar_type,
+  law_gain_structure,
+  law_antiwindup,
+  reset_integral,
+  reference_buffer_enabled,
+  reference_buffer_lookahead,
+  state_prediction_enabled,
+  state_prediction_max_horizon,
+  latency_enabled,
+  segments_enabled,
+  outer_loop_rate,
+  realtime_enabled,
+  realtime_rate,
+  realtime_priority,
+  realtime_cpu,
+  realtime_lock_memory,
+  realtime_prefault_stack,
+  gain_schedule_file,
+  gain_schedule_profile,
+  recorder_enabled,
+  recorder_directory,
+  perf_counters_enabled,
+  mailbox_enabled,
+  mailbox_name,
+  lookahead_cache_enabled,
+  lookahead_cache_sample_period,
+  lookahead_cache_horizon,
+  standby_role,
+  standby_channel,
+  standby_timeout,
+  odometry_topic,
+  unknown,
+};
+
+constexpr std::size_t parameter_count          = static_cast<std::size_t>(DF_parameter::unknown);
+constexpr std::size_t required_parameter_count = static_cast<std::size_t>(DF_parameter::yaw_kp) + 1;
+
+/* Full parameter names, indexed by DF_parameter */
+constexpr std::array<std::string_view, parameter_count> parameter_names = {
+    "mass",
+    "trajectory_control.antiwindup_cte",
+    "trajectory_control.alpha",
+    "trajectory_control.kp.x",
+    "trajectory_control.kp.y",
+    "trajectory_control.kp.z",
+    "trajectory_control.ki.x",
+    "trajectory_control.ki.y",
+    "trajectory_control.ki.z",
+    "trajectory_control.kd.x",
+    "trajectory_control.kd.y",
+    "trajectory_control.kd.z",
+    "trajectory_control.roll_control.kp",
+    "trajectory_control.pitch_control.kp",
+    "trajectory_control.yaw_control.kp",
+    "trajectory_control.law.scalar_type",
+    "trajectory_control.law.gain_structure",
+    "trajectory_control.law.antiwindup",
+    "trajectory_control.reset_integral",
+    "trajectory_control.reference_buffer.enabled",
+    "trajectory_control.reference_buffer.lookahead",
+    "trajectory_control.state_prediction.enabled",
+    "trajectory_control.state_prediction.max_horizon",
+    "trajectory_control.latency.enabled",
+    "trajectory_control.segments.enabled",
+    "trajectory_control.outer_loop.rate",
+    "trajectory_control.realtime.enabled",
+    "trajectory_control.realtime.rate",
+    "trajectory_control.realtime.priority",
+    "trajectory_control.realtime.cpu",
+    "trajectory_control.realtime.lock_memory",
+    "trajectory_control.realtime.prefault_stack",
+    "trajectory_control.gain_schedule.file",
+    "trajectory_control.gain_schedule.profile",
+    "trajectory_control.recorder.enabled",
+    "trajectory_control.recorder.directory",
+    "trajectory_control.perf_counters.enabled",
+    "trajectory_control.mailbox.enabled",
+    "trajectory_control.mailbox.name",
+    "trajectory_control.lookahead_cache.enabled",
+    "trajectory_control.lookahead_cache.sample_period",
+    "trajectory_control.lookahead_cache.horizon",
+    "trajectory_control.standby.role",
+    "trajectory_control.standby.channel",
+    "trajectory_control.standby.timeout",
+    "trajectory_control.odometry_topic",
+};
+
+/* Prefix the plugin parameters were read without before the table, kept as an alias */
+constexpr std::string_view parameter_prefix = "trajectory_control.";
+
+/* Short name of parameter _index, its full name without parameter_prefix, empty if it has none */
+constexpr std::string_view parameterAlias(std::size_t _index) {
+  const std::string_view name = parameter_names[_index];
+  if (name.substr(0, parameter_prefix.size()) != parameter_prefix) {
+    return std::string_view();
+  }
+  return name.substr(parameter_prefix.size());
+}
+
+/* Bit i set for every required parameter i */
+constexpr uint32_t required_parameters_mask = (1u << required_parameter_count) - 1u;
+static_assert(required_parameter_count < 32, "Required parameters must fit in the mask");
+
+/* Bit of _parameter in the required mask, 0 for the parameters that do not fit in it */
+constexpr uint32_t parameterBit(DF_parameter _parameter) {
+  return static_cast<uint8_t>(_parameter) < 32 ? 1u << static_cast<uint8_t>(_parameter) : 0u;
+}
+
+/* 64 bit FNV-1a */
+constexpr uint64_t hashParameterName(std::string_view _name) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : _name) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+namespace parameter_table {
+
+constexpr std::size_t slot_count = 256;
+constexpr uint8_t empty_slot     = 0xFF;
+static_assert(2 * parameter_count < slot_count / 2, "Keep the table at most half full");
+
+/* Entry i < parameter_count is the full name of parameter i, entry parameter_count + i its alias */
+constexpr std::string_view entryName(std::size_t _entry) {
+  return _entry < parameter_count ? parameter_names[_entry]
+                                  : parameterAlias(_entry - parameter_count);
+}
+
+/* Open addressing table built at compile time, slot -> entry */
+constexpr std::array<uint8_t, slot_count> buildSlots() {
+  std::array<uint8_t, slot_count> slots{};
+  for (auto &slot : slots) {
+    slot = empty_slot;
+  }
+  for (std::size_t i = 0; i < 2 * parameter_count; i++) {
+    if (entryName(i).empty()) {
+      continue;
+    }
+    std::size_t slot = hashParameterName(entryName(i)) % slot_count;
+    while (slots[slot] != empty_slot) {
+      slot = (slot + 1) % slot_count;
+    }
+    slots[slot] = static_cast<uint8_t>(i);
+  }
+  return slots;
+}
+
+constexpr std::array<uint8_t, slot_count> slots = buildSlots();
+
+};  // namespace parameter_table
+
+/**
+ * Parameter with the full name _name, or with its name without the "trajectory_control."
+ * prefix, or DF_parameter::unknown. One hash and one string comparison in the common case, no
+ * allocation.
+ */
+constexpr DF_parameter findParameter(std::string_view _name) {
+  std::size_t slot = hashParameterName(_name) % parameter_table::slot_count;
+  while (parameter_table::slots[slot] != parameter_table::empty_slot) {
+    const uint8_t entry = parameter_table::slots[slot];
+    if (parameter_table::entryName(entry) == _name) {
+      return static_cast<DF_parameter>(entry % parameter_count);
+    }
+    slot = (slot + 1) % parameter_table::slot_count;
+  }
+  return DF_parameter::unknown;
+}
+
+static_assert(findParameter("mass") == DF_parameter::mass, "Parameter table is inconsistent");
+static_assert(findParameter("trajectory_control.yaw_control.kp") == DF_parameter::yaw_kp,
+              "Parameter table is inconsistent");
+static_assert(findParameter("yaw_control.kp") == DF_parameter::yaw_kp,
+              "Parameter table is inconsistent");
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,143 @@
+/*!*******************************************************************************************
+ *  \file       perf_counters.hpp
+ *  \brief      Hardware performance counters of the calling thread, per stage summaries.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace controller_plugin_differential_flatness {
+
+enum class Perf_event : uint8_t {
+  cycles,
+  instructions,
+  cache_misses,
+  branch_misses,
+  count,
+};
+constexpr std::size_t perf_event_count = static_cast<std::size_t>(Perf_event::count);
+
+constexpr std::array<const char *, perf_event_count> perf_event_names = {
+    "cycles", "instructions", "cache_misses", "branch_misses"};
+
+/* Counter values at one instant, indexed by Perf_event. Unavailable events stay at 0 */
+struct Perf_sample {
+  std::array<uint64_t, perf_event_count> values{};
+};
+
+/**
+ * Hardware counters of the calling thread opened as a single perf_event_open group, so all of
+ * them are read with one read() call and are scheduled together. Only user space is counted,
+ * which needs kernel.perf_event_paranoid <= 2 and no privileges. Events the CPU or the
+ * hypervisor do not expose are left out of the group and read as 0.
+ *
+ * Counters follow the thread that opened the group, read() may be called from that thread only.
+ */
+class PerfCounterGroup {
+  int leader_fd_ = -1;
+  std::array<int, perf_event_count> fds_{-1, -1, -1, -1};
+  std::array<uint8_t, perf_event_count> group_index_{};  // position of each event in a read
+  std::size_t group_size_ = 0;
+  uint32_t available_     = 0;  // bit per Perf_event
+
+public:
+  PerfCounterGroup(){};
+  ~PerfCounterGroup() { close(); };
+
+  PerfCounterGroup(const PerfCounterGroup &) = delete;
+  PerfCounterGroup &operator=(const PerfCounterGroup &) = delete;
+
+  /**
+   * Open and start the counters for the calling thread. Returns 0, or the errno of the failure if
+   * not even the cycle counter is available. Nothing is allocated, so the tick may call it.
+   */
+  int open();
+  void close();
+
+  bool isOpen() const { return leader_fd_ >= 0; }
+  bool isAvailable(Perf_event _event) const {
+    return available_ & (1u << static_cast<uint8_t>(_event));
+  }
+
+  /** Current value of every counter, one system call */
+  bool read(Perf_sample &_sample) const;
+};
+
+/**
+ * Sums of counter deltas over the samples of one stage. record() only does relaxed loads and
+ * stores, so there must be a single writer. Any thread may take a snapshot() concurrently.
+ */
+class PerfStageCounters {
+  std::array<std::atomic<uint64_t>, perf_event_count> sums_{};
+  std::atomic<uint64_t> samples_{0};
+
+public:
+  struct Snapshot {
+    std::array<uint64_t, perf_event_count> sums{};
+    uint64_t samples = 0;
+
+    /* Mean of _event per sample, 0 if empty */
+    double mean(Perf_event _event) const;
+    /* Instructions per cycle, 0 if no cycles were counted */
+    double ipc() const;
+  };
+
+  PerfStageCounters(){};
+  ~PerfStageCounters(){};
+
+  PerfStageCounters(const PerfStageCounters &) = delete;
+  PerfStageCounters &operator=(const PerfStageCounters &) = delete;
+
+  /** Writer side, adds _end - _start */
+  void record(const Perf_sample &_start, const Perf_sample &_end) {
+    for (std::size_t i = 0; i < perf_event_count; i++) {
+      sums_[i].store(sums_[i].load(std::memory_order_relaxed) + (_end.values[i] - _start.values[i]),
+                     std::memory_order_relaxed);
+    }
+    samples_.store(samples_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  /** Reader side, any thread */
+  void snapshot(Snapshot &_snapshot) const;
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
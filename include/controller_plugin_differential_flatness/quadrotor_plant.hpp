@@ -0,0 +1,91 @@
+/*!*******************************************************************************************
+ *  \file       quadrotor_plant.hpp
+ *  \brief      Rigid body quadrotor model driven by ACRO commands.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __QUADROTOR_PLANT_H__
+#define __QUADROTOR_PLANT_H__
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+struct Plant_params {
+  double mass                 = 0.82;  // [kg]
+  double rate_time_constant   = 0.03;  // [s] first order response of the body rates
+  double thrust_time_constant = 0.02;  // [s] first order response of the collective thrust
+  double linear_drag          = 0.0;   // [N s/m]
+  double max_thrust           = 30.0;  // [N]
+};
+
+struct Plant_state {
+  Eigen::Vector3d position    = Eigen::Vector3d::Zero();
+  Eigen::Vector3d velocity    = Eigen::Vector3d::Zero();
+  Eigen::Quaterniond attitude = Eigen::Quaterniond::Identity();  // body to world
+  Eigen::Vector3d body_rates  = Eigen::Vector3d::Zero();
+  double thrust               = 0.0;
+};
+
+/**
+ * Quadrotor as the low level ACRO controller sees it: body rates and collective thrust follow the
+ * command with a first order lag, thrust is clamped to [0, max_thrust] along the body z axis.
+ * Translation is integrated with semi-implicit Euler. Deterministic and allocation free.
+ */
+class QuadrotorPlant {
+  Plant_params params_;
+  Plant_state state_;
+
+public:
+  QuadrotorPlant(){};
+  explicit QuadrotorPlant(const Plant_params &_params) : params_(_params){};
+  ~QuadrotorPlant(){};
+
+  const Plant_params &getParams() const { return params_; }
+  const Plant_state &getState() const { return state_; }
+  void setState(const Plant_state &_state) { state_ = _state; }
+
+  /** Hovering at _position with the thrust that compensates gravity */
+  void resetHover(const Eigen::Vector3d &_position, const double &_yaw);
+
+  /** Advance _dt seconds holding _command */
+  void step(const Acro_command &_command, const double &_dt);
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
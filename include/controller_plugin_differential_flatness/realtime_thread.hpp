@@ -0,0 +1,108 @@
+/*!*******************************************************************************************
+ *  \file       realtime_thread.hpp
+ *  \brief      Periodic thread with real-time scheduling, CPU pinning and prefaulted memory.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __REALTIME_THREAD_H__
+#define __REALTIME_THREAD_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace controller_plugin_differential_flatness {
+
+struct Realtime_options {
+  double rate                = 500.0;       // [Hz]
+  int priority               = 80;          // SCHED_FIFO priority, 0 keeps the default scheduler
+  int cpu                    = -1;          // CPU the thread is pinned to, -1 for any
+  bool lock_memory           = true;        // mlockall the whole process
+  std::size_t prefault_stack = 256 * 1024;  // [bytes] of stack touched before the first tick
+};
+
+/** SCHED_FIFO at _priority if it is positive and pin to _cpu if it is not negative */
+bool setCurrentThreadRealtime(int _priority, int _cpu, std::string &_error);
+
+/** Lock current and future pages of the process in memory */
+bool lockProcessMemory(std::string &_error);
+
+/** Touch _bytes of the calling thread stack so the first ticks do not page fault on it */
+void prefaultStack(std::size_t _bytes);
+
+/**
+ * Thread calling a tick function at a fixed rate on absolute CLOCK_MONOTONIC deadlines. The
+ * thread applies Realtime_options to itself, calls the setup function once and then ticks until
+ * stop. A tick that overruns its deadline is counted and the following deadlines are realigned,
+ * there is no burst of catch-up ticks.
+ */
+class PeriodicThread {
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> ticks_{0};
+  std::atomic<uint64_t> overruns_{0};
+
+  void run(const Realtime_options &_options, const std::function<void(double)> &_tick);
+
+public:
+  PeriodicThread(){};
+  ~PeriodicThread() { stop(); };
+
+  PeriodicThread(const PeriodicThread &) = delete;
+  PeriodicThread &operator=(const PeriodicThread &) = delete;
+
+  /**
+   * Start the thread. _tick receives the measured time since the previous tick in seconds.
+   * Blocks until the thread has applied the options and run _setup. Returns false with the reason
+   * in _error if part of the options could not be applied, the thread keeps running without it.
+   */
+  bool start(const Realtime_options &_options,
+             std::function<void()> _setup,
+             std::function<void(double)> _tick,
+             std::string &_error);
+
+  /** Join the thread after its current tick. Does nothing if it is not running */
+  void stop();
+
+  bool running() const { return running_.load(std::memory_order_acquire); }
+  uint64_t getTicks() const { return ticks_.load(std::memory_order_relaxed); }
+  uint64_t getOverruns() const { return overruns_.load(std::memory_order_relaxed); }
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
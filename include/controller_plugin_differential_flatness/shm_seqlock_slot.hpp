@@ -0,0 +1,281 @@
+/*!*******************************************************************************************
+ *  \file       shm_seqlock_slot.hpp
+ *  \brief      Seqlock slot of 64 bit words in POSIX shared memory, shared by the mailbox and standby.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+#ifndef __SHM_SEQLOCK_SLOT_H__
+#define __SHM_SEQLOCK_SLOT_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace controller_plugin_differential_flatness {
+
+/* Doubles travel as their bit patterns, so every word of a slot is a lock-free atomic */
+inline uint64_t doubleBits(double _value) {
+  uint64_t bits;
+  std::memcpy(&bits, &_value, sizeof(bits));
+  return bits;
+}
+
+inline double bitsDouble(uint64_t _bits) {
+  double value;
+  std::memcpy(&value, &_bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Layout of a POSIX shared memory segment holding a single seqlock slot of N words. The counter is
+ * odd while a write is in progress and the sequence of the last complete write is half of it.
+ * Zero bytes are a valid state for every atomic, a new segment starts with nothing written.
+ */
+template <std::size_t N>
+struct Seqlock_slot_layout {
+  std::atomic<uint64_t> magic;  // identifies the payload, written last by the creator
+  uint32_t version;             // of the payload layout
+  uint32_t size;                // sizeof(Seqlock_slot_layout)
+  alignas(64) std::atomic<uint64_t> counter;
+  std::atomic<uint64_t> words[N];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The slot is shared between processes");
+
+/**
+ * Map _size bytes of the segment _name, creating it if _writable. Returns nullptr with the reason
+ * in _error, or if a read only segment is smaller than _size.
+ */
+void *mapSharedSegment(const std::string &_name,
+                       std::size_t _size,
+                       bool _writable,
+                       std::string &_error);
+void unmapSharedSegment(const void *_map, std::size_t _size);
+bool removeSharedSegment(const std::string &_name);
+
+/**
+ * Writer side of a slot. write never blocks, allocates or makes a system call, and is safe to call
+ * from any thread, including concurrently with open and close: a write racing another write is
+ * dropped.
+ *
+ * The segment is not removed on close, so a restarted writer keeps the sequence going and the
+ * readers already attached keep seeing its writes. Use remove to delete it.
+ */
+template <std::size_t N>
+class SeqlockSlotWriter {
+  using Layout = Seqlock_slot_layout<N>;
+
+  std::atomic<Layout *> slot_{nullptr};
+  std::atomic<uint32_t> writers_{0};  // writes using slot_, close waits for them
+  std::string name_;
+
+public:
+  SeqlockSlotWriter(){};
+  ~SeqlockSlotWriter() { close(); };
+
+  SeqlockSlotWriter(const SeqlockSlotWriter &) = delete;
+  SeqlockSlotWriter &operator=(const SeqlockSlotWriter &) = delete;
+
+  /**
+   * Create or attach to the segment _name, a shm_open name such as "/df_commands". A segment of
+   * another _magic, _version or size is reset. Closes the previous one. Returns false with the
+   * reason in _error.
+   */
+  bool open(const std::string &_name, uint64_t _magic, uint32_t _version, std::string &_error) {
+    close();
+    void *map = mapSharedSegment(_name, sizeof(Layout), true, _error);
+    if (map == nullptr) {
+      return false;
+    }
+
+    Layout *slot = static_cast<Layout *>(map);
+    if (slot->magic.load(std::memory_order_acquire) == _magic && slot->version == _version &&
+        slot->size == sizeof(Layout)) {
+      // Close a write left open by a writer that died in it
+      const uint64_t counter = slot->counter.load(std::memory_order_relaxed);
+      if (counter & 1) {
+        slot->counter.store(counter + 1, std::memory_order_release);
+      }
+    } else {
+      slot->magic.store(0, std::memory_order_relaxed);
+      slot->version = _version;
+      slot->size    = sizeof(Layout);
+      slot->counter.store(0, std::memory_order_relaxed);
+      slot->magic.store(_magic, std::memory_order_release);
+    }
+
+    name_ = _name;
+    slot_.store(slot);
+    return true;
+  }
+
+  void close() {
+    Layout *slot = slot_.exchange(nullptr);
+    if (slot == nullptr) {
+      return;
+    }
+    // A write that loaded the old pointer finishes before the mapping goes away
+    while (writers_.load() != 0) {
+      std::this_thread::yield();
+    }
+    unmapSharedSegment(slot, sizeof(Layout));
+  }
+
+  bool isOpen() const { return slot_.load(std::memory_order_relaxed) != nullptr; }
+  const std::string &getName() const { return name_; }
+
+  /** Returns false if the slot is closed or another write is in progress */
+  bool write(const std::array<uint64_t, N> &_words) {
+    // Sequentially consistent with close, so either close sees this writer or this writer sees
+    // the cleared pointer
+    writers_.fetch_add(1);
+    Layout *slot = slot_.load();
+    bool written = false;
+
+    uint64_t counter = slot != nullptr ? slot->counter.load(std::memory_order_relaxed) : 1;
+    if (!(counter & 1) &&
+        slot->counter.compare_exchange_strong(counter, counter + 1, std::memory_order_relaxed)) {
+      std::atomic_thread_fence(std::memory_order_release);
+      for (std::size_t i = 0; i < N; i++) {
+        slot->words[i].store(_words[i], std::memory_order_relaxed);
+      }
+      slot->counter.store(counter + 2, std::memory_order_release);
+      written = true;
+    }
+
+    writers_.fetch_sub(1, std::memory_order_release);
+    return written;
+  }
+
+  /** Delete the segment _name, readers already attached keep their mapping */
+  static bool remove(const std::string &_name) { return removeSharedSegment(_name); }
+};
+
+/**
+ * Reader side of a slot, read only, it never stalls the writer. read never blocks or makes a
+ * system call, and is safe to call while another thread opens or closes the slot.
+ */
+template <std::size_t N>
+class SeqlockSlotReader {
+  using Layout = Seqlock_slot_layout<N>;
+
+  std::atomic<const Layout *> slot_{nullptr};
+  mutable std::atomic<uint32_t> readers_{0};  // reads using slot_, close waits for them
+
+public:
+  SeqlockSlotReader(){};
+  ~SeqlockSlotReader() { close(); };
+
+  SeqlockSlotReader(const SeqlockSlotReader &) = delete;
+  SeqlockSlotReader &operator=(const SeqlockSlotReader &) = delete;
+
+  /** Attach to the segment _name. Fails until a writer with _magic and _version has created it */
+  bool open(const std::string &_name, uint64_t _magic, uint32_t _version, std::string &_error) {
+    close();
+    const void *map = mapSharedSegment(_name, sizeof(Layout), false, _error);
+    if (map == nullptr) {
+      return false;
+    }
+    const Layout *slot = static_cast<const Layout *>(map);
+    if (slot->magic.load(std::memory_order_acquire) != _magic || slot->version != _version ||
+        slot->size != sizeof(Layout)) {
+      _error = _name + " has another layout than version " + std::to_string(_version);
+      unmapSharedSegment(map, sizeof(Layout));
+      return false;
+    }
+    slot_.store(slot);
+    return true;
+  }
+
+  void close() {
+    const Layout *slot = slot_.exchange(nullptr);
+    if (slot == nullptr) {
+      return;
+    }
+    while (readers_.load() != 0) {
+      std::this_thread::yield();
+    }
+    unmapSharedSegment(slot, sizeof(Layout));
+  }
+
+  bool isOpen() const { return slot_.load(std::memory_order_relaxed) != nullptr; }
+
+  /** Sequence of the last complete write, 0 if none. Cheap enough to poll */
+  uint64_t sequence() const {
+    readers_.fetch_add(1);
+    const Layout *slot = slot_.load();
+    // An odd counter is a write in progress, the last complete one is still counter / 2
+    const uint64_t counter = slot != nullptr ? slot->counter.load(std::memory_order_acquire) : 0;
+    readers_.fetch_sub(1, std::memory_order_release);
+    return counter >> 1;
+  }
+
+  /**
+   * Words and sequence of the last complete write. Returns false if the slot is closed, nothing was
+   * written yet, or the slot kept changing for _max_retries attempts, which only happens if the
+   * writer died during a write.
+   */
+  bool read(std::array<uint64_t, N> &_words, uint64_t &_sequence, int _max_retries) const {
+    readers_.fetch_add(1);
+    const Layout *slot = slot_.load();
+    bool read          = false;
+
+    for (int attempt = 0; slot != nullptr && attempt < _max_retries; attempt++) {
+      const uint64_t before = slot->counter.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;
+      }
+      for (std::size_t i = 0; i < N; i++) {
+        _words[i] = slot->words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->counter.load(std::memory_order_relaxed) != before) {
+        continue;
+      }
+      read      = before != 0;
+      _sequence = before >> 1;
+      break;
+    }
+
+    readers_.fetch_sub(1, std::memory_order_release);
+    return read;
+  }
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,100 @@
+/*!*******************************************************************************************
+ *  \file       spsc_queue.hpp
+ *  \brief      Bounded lock-free single producer, single consumer queue.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace controller_plugin_differential_flatness {
+
+/**
+ * Fixed capacity ring between one producer thread and one consumer thread. Storage is allocated
+ * with the queue, push and pop never allocate, block or retry.
+ */
+template <typename T, std::size_t Capacity>
+class SPSCQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+  std::array<T, Capacity> items_;
+
+  alignas(64) std::atomic<std::size_t> head_{0};  // next slot to pop, written by the consumer
+  alignas(64) std::atomic<std::size_t> tail_{0};  // next slot to push, written by the producer
+
+public:
+  SPSCQueue(){};
+  ~SPSCQueue(){};
+
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+  /** Producer side, returns false if the queue is full */
+  bool push(const T &_item) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    items_[tail & (Capacity - 1)] = _item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Consumer side, returns false if the queue is empty */
+  bool pop(T &_item) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    _item = items_[head & (Capacity - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Approximate number of queued items, exact when called from either side while idle */
+  std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,69 @@
+/*!*******************************************************************************************
+ *  \file       state_predictor.hpp
+ *  \brief      Latency compensation of the measured UAV state.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __STATE_PREDICTOR_H__
+#define __STATE_PREDICTOR_H__
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace controller_plugin_differential_flatness {
+
+/**
+ * World frame acceleration produced by a collective thrust along the body z axis of _attitude,
+ * gravity included. Returns zero when no thrust has been commanded yet, so an idle vehicle is
+ * not predicted to be falling.
+ */
+Eigen::Vector3d commandedAcceleration(const double &_thrust,
+                                      const double &_mass,
+                                      const Eigen::Quaterniond &_attitude);
+
+/**
+ * Propagate a state _horizon seconds forward with constant acceleration and constant body rates.
+ * Position and velocity are integrated exactly for the constant acceleration, the attitude is
+ * rotated by the body rates in the body frame. Fixed size only, no allocation.
+ */
+void propagateState(const double &_horizon,
+                    const Eigen::Vector3d &_acceleration,
+                    const Eigen::Vector3d &_body_rates,
+                    Eigen::Vector3d &_position,
+                    Eigen::Vector3d &_velocity,
+                    Eigen::Quaterniond &_attitude);
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
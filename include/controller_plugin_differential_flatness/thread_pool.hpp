@@ -0,0 +1,93 @@
+/*!*******************************************************************************************
+ *  \file       thread_pool.hpp
+ *  \brief      Fixed size thread pool for offline tools.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace controller_plugin_differential_flatness {
+
+/**
+ * Workers started once and reused by every parallelFor call. Meant for offline tools and the
+ * batched tick of MultiVehicleHost, a single plugin never runs on it.
+ */
+class ThreadPool {
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  uint64_t generation_ = 0;
+  std::size_t running_ = 0;
+  bool stop_           = false;
+
+  const std::function<void(std::size_t)> *task_ = nullptr;
+  std::size_t task_count_                       = 0;
+  std::atomic<std::size_t> next_index_{0};
+
+  void workerLoop();
+  void runTasks();
+
+public:
+  /** _threads workers, the hardware concurrency if 0 */
+  explicit ThreadPool(std::size_t _threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  std::size_t size() const { return workers_.size() + 1; }
+
+  /**
+   * Call _task(i) for every i in [0, _count), spread over the workers and the calling thread.
+   * Returns when all calls have finished. Indices are handed out one at a time, so tasks of
+   * very different length are balanced.
+   */
+  void parallelFor(std::size_t _count, const std::function<void(std::size_t)> &_task);
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
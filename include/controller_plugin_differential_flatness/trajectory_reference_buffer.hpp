@@ -0,0 +1,96 @@
+/*!*******************************************************************************************
+ *  \file       trajectory_reference_buffer.hpp
+ *  \brief      Time-indexed trajectory reference buffer with interpolation.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __TRAJECTORY_REFERENCE_BUFFER_H__
+#define __TRAJECTORY_REFERENCE_BUFFER_H__
+
+#include <array>
+#include <cstddef>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+struct Timed_reference {
+  double stamp = 0.0;  // [s]
+  UAV_reference reference;
+};
+
+/**
+ * Bounded, preallocated buffer of timestamped trajectory points, ordered by stamp.
+ *
+ * A point older than the last stored one is treated as a replan: every stored point at or after
+ * its stamp is dropped before it is appended. When full, the oldest point is dropped.
+ */
+class TrajectoryReferenceBuffer {
+public:
+  static constexpr std::size_t capacity = 256;
+
+private:
+  std::array<Timed_reference, capacity> points_;
+  std::size_t head_ = 0;  // index of the oldest point
+  std::size_t size_ = 0;
+
+  const Timed_reference &at(std::size_t _i) const { return points_[(head_ + _i) % capacity]; }
+
+public:
+  TrajectoryReferenceBuffer(){};
+  ~TrajectoryReferenceBuffer(){};
+
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void push(const Timed_reference &_point);
+
+  /**
+   * Reference at time _t. Position uses cubic Hermite interpolation with the stored velocities,
+   * velocity and acceleration are linear and yaw follows the shortest arc. Before the first point
+   * or after the last one, that point is held. Returns false if the buffer is empty.
+   */
+  bool sample(const double &_t, UAV_reference &_reference) const;
+
+  /** Drop points that can no longer be used, keeping the last one at or before _t */
+  void discardBefore(const double &_t);
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,128 @@
+/*!*******************************************************************************************
+ *  \file       trajectory_segment_store.hpp
+ *  \brief      Preallocated store of polynomial trajectory segments.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __TRAJECTORY_SEGMENT_STORE_H__
+#define __TRAJECTORY_SEGMENT_STORE_H__
+
+#include <array>
+#include <cstddef>
+
+#include <Eigen/Core>
+
+#include "controller_plugin_differential_flatness/DF_control_law.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+/* Up to 7th order polynomials, enough for minimum snap trajectories */
+constexpr std::size_t segment_coefficient_count = 8;
+
+/**
+ * Polynomial in tau = t - start for x, y, z and yaw, valid for t in [start, start + duration].
+ * Row i holds the coefficients of axis i in ascending powers of tau.
+ */
+struct Trajectory_segment {
+  double start    = 0.0;  // [s]
+  double duration = 0.0;  // [s]
+  Eigen::Matrix<double, 4, segment_coefficient_count, Eigen::RowMajor> coefficients =
+      Eigen::Matrix<double, 4, segment_coefficient_count, Eigen::RowMajor>::Zero();
+};
+
+/**
+ * Layout of a segment in a flat array of doubles, as received in std_msgs/Float64MultiArray:
+ *   [start, duration, x_0 .. x_7, y_0 .. y_7, z_0 .. z_7, yaw_0 .. yaw_7]
+ * A message carries any number of consecutive records. Lower order polynomials are zero padded.
+ */
+constexpr std::size_t segment_record_size = 2 + 4 * segment_coefficient_count;
+
+/** Read one record. Returns false if the duration is not positive or a value is not finite */
+bool parseTrajectorySegment(const double *_record, Trajectory_segment &_segment);
+
+/** Reference at _t, which is clamped to the segment bounds. Uses Horner's scheme */
+void evaluateTrajectorySegment(const Trajectory_segment &_segment,
+                               const double &_t,
+                               UAV_reference &_reference);
+
+/**
+ * Bounded, preallocated buffer of segments, ordered by start time.
+ *
+ * Follows the same rules as TrajectoryReferenceBuffer: a segment starting before the end of the
+ * last stored one is a replan and replaces every stored segment from its start on, and when full
+ * the oldest segment is dropped.
+ */
+class TrajectorySegmentStore {
+public:
+  static constexpr std::size_t capacity = 64;
+
+private:
+  std::array<Trajectory_segment, capacity> segments_;
+  std::size_t head_ = 0;  // index of the oldest segment
+  std::size_t size_ = 0;
+
+  Trajectory_segment &at(std::size_t _i) { return segments_[(head_ + _i) % capacity]; }
+  const Trajectory_segment &at(std::size_t _i) const {
+    return segments_[(head_ + _i) % capacity];
+  }
+
+public:
+  TrajectorySegmentStore(){};
+  ~TrajectorySegmentStore(){};
+
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  /** Stored segment _i, 0 being the oldest */
+  const Trajectory_segment &segment(std::size_t _i) const { return at(_i); }
+
+  void push(const Trajectory_segment &_segment);
+
+  /**
+   * Reference at time _t from the segment that contains it. Before the first segment its start is
+   * used. After the end of a segment, when no later one has started, its end position and yaw are
+   * held with zero velocity and acceleration. Returns false if the store is empty.
+   */
+  bool sample(const double &_t, UAV_reference &_reference) const;
+
+  /** Drop segments that can no longer be used, keeping the last one started at or before _t */
+  void discardBefore(const double &_t);
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,100 @@
+/*!*******************************************************************************************
+ *  \file       triple_buffer.hpp
+ *  \brief      Wait-free single producer, single consumer snapshot handoff.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __TRIPLE_BUFFER_H__
+#define __TRIPLE_BUFFER_H__
+
+#include <atomic>
+#include <cstdint>
+
+namespace controller_plugin_differential_flatness {
+
+/**
+ * Latest-value handoff between one writer thread and one reader thread.
+ *
+ * Writer and reader each own one of the three slots, and the third one is exchanged through a
+ * single atomic. Neither side ever waits or retries, and a slot is never accessed by both
+ * threads at the same time, so T does not need to be trivially copyable.
+ */
+template <typename T>
+class TripleBuffer {
+  static constexpr uint8_t index_mask = 0x3;
+  static constexpr uint8_t fresh_bit  = 0x4;
+
+  T buffers_[3];
+
+  alignas(64) std::atomic<uint8_t> middle_{1};
+  alignas(64) uint8_t back_ = 0;   // owned by the writer
+  alignas(64) uint8_t front_ = 2;  // owned by the reader
+
+public:
+  TripleBuffer(){};
+  ~TripleBuffer(){};
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  /** Writer side: slot to fill before publish() */
+  T &writeBuffer() { return buffers_[back_]; }
+
+  /** Writer side: make the filled slot the latest value */
+  void publish() {
+    back_ = middle_.exchange(back_ | fresh_bit, std::memory_order_acq_rel) & index_mask;
+  }
+
+  /** Writer side: copy and publish */
+  void write(const T &_value) {
+    writeBuffer() = _value;
+    publish();
+  }
+
+  /** Reader side: take the latest published value, returns false if there was none new */
+  bool update() {
+    if (!(middle_.load(std::memory_order_relaxed) & fresh_bit)) {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+
+  /** Reader side: value taken by the last update() */
+  const T &read() const { return buffers_[front_]; }
+};
+
+};  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -0,0 +1,293 @@
+/*!*******************************************************************************************
+ *  \file       DF_control_law.cpp
+ *  \brief      ROS-free differential flatness control law.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+#include "DF_control_law.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+namespace controller_plugin_differential_flatness {
+
+DF_gain_set makeGainSet(const DF_gains &_gains, const double &_alpha) {
+  DF_gain_set gain_set;
+  gain_set.gains = _gains;
+  gain_set.alpha = _alpha;
+
+  // Bounds only change with the gains, so the division is not repeated every tick
+  const Eigen::Vector3d ki_diagonal = _gains.Ki.diagonal();
+  for (uint8_t j = 0; j < 3; j++) {
+    gain_set.antiwindup_bound[j] = _gains.antiwindup_cte / ki_diagonal[j];
+  }
+  return gain_set;
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+void DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::setGains(
+    const DF_gain_set &_gain_set) {
+  const DF_gains &gains = _gain_set.gains;
+
+  gains_            = gains;
+  Kp_               = GainStructure::template fromMatrix<Scalar>(gains.Kp);
+  Kd_               = GainStructure::template fromMatrix<Scalar>(gains.Kd);
+  Ki_               = GainStructure::template fromMatrix<Scalar>(gains.Ki);
+  Kp_ang_           = GainStructure::template fromMatrix<Scalar>(gains.Kp_ang);
+  mass_             = static_cast<Scalar>(gains.mass);
+  antiwindup_bound_ = _gain_set.antiwindup_bound.cast<Scalar>();
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+typename DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::Vector3
+DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::getForceT(const Scalar &_dt,
+                                                                  const Vector3 &_pos_state,
+                                                                  const Vector3 &_vel_state,
+                                                                  const Vector3 &_pos_reference,
+                                                                  const Vector3 &_vel_reference,
+                                                                  const Vector3 &_acc_reference) {
+  const Vector3 gravitational_accel(0, 0, static_cast<Scalar>(-9.81));
+
+  // Compute the error force contribution
+
+  const Vector3 position_error = _pos_reference - _pos_state;
+  const Vector3 velocity_error = _vel_reference - _vel_state;
+
+  // TODO: check if apply _dt to each constant or apply it to the whole vector each iteration
+  accum_pos_error_ += position_error * _dt;
+
+  AntiwindupPolicy::apply(accum_pos_error_, antiwindup_bound_);
+
+  const Vector3 desired_force = GainStructure::apply(Kp_, position_error) +
+                                GainStructure::apply(Kd_, velocity_error) +
+                                GainStructure::apply(Ki_, accum_pos_error_) -
+                                mass_ * gravitational_accel + mass_ * _acc_reference;
+
+  return desired_force;
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+typename DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::Vector3
+DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::getForceFeedforwardT(
+    const Scalar &_dt,
+    const Vector3 &_pos_state,
+    const Vector3 &_vel_state,
+    const Vector3 &_pos_reference,
+    const Vector3 &_vel_reference,
+    const Vector3 &_specific_force) {
+  const Vector3 position_error = _pos_reference - _pos_state;
+  const Vector3 velocity_error = _vel_reference - _vel_state;
+
+  accum_pos_error_ += position_error * _dt;
+
+  AntiwindupPolicy::apply(accum_pos_error_, antiwindup_bound_);
+
+  return GainStructure::apply(Kp_, position_error) + GainStructure::apply(Kd_, velocity_error) +
+         GainStructure::apply(Ki_, accum_pos_error_) + mass_ * _specific_force;
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+typename DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::Matrix3
+DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::computeDesiredAttitudeT(
+    const Vector3 &_desired_force,
+    const Scalar &_yaw_angle_reference) {
+  const Vector3 xc_des(std::cos(_yaw_angle_reference), std::sin(_yaw_angle_reference), 0);
+  return computeDesiredAttitudeFromHeadingT(_desired_force, xc_des);
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+typename DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::Matrix3
+DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::computeDesiredAttitudeFromHeadingT(
+    const Vector3 &_desired_force,
+    const Vector3 &_heading) {
+  const Vector3 xc_des = _heading;
+  const Vector3 zb_des = _desired_force.normalized();
+  const Vector3 yb_des = zb_des.cross(xc_des).normalized();
+  const Vector3 xb_des = yb_des.cross(zb_des).normalized();
+
+  // Compute the rotation matrix desidered
+  Matrix3 R_des;
+  R_des.col(0) = xb_des;
+  R_des.col(1) = yb_des;
+  R_des.col(2) = zb_des;
+  return R_des;
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+Acro_command DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::computeAttitudeControlT(
+    const Vector3 &_desired_force,
+    const Matrix3 &_R_des,
+    const Matrix3 &_rot_matrix) const {
+  // Compute the rotation matrix error
+  const Vector3 E_rot = computeAttitudeError<Scalar>(_R_des, _rot_matrix);
+
+  Acro_command acro_command;
+  acro_command.thrust = (float)_desired_force.dot(_rot_matrix.col(2).normalized());
+  acro_command.PQR    = (-GainStructure::apply(Kp_ang_, E_rot)).template cast<double>();
+  return acro_command;
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+Eigen::Vector3d DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::getForce(
+    const double &_dt,
+    const Eigen::Vector3d &_pos_state,
+    const Eigen::Vector3d &_vel_state,
+    const Eigen::Vector3d &_pos_reference,
+    const Eigen::Vector3d &_vel_reference,
+    const Eigen::Vector3d &_acc_reference) {
+  return getForceT(static_cast<Scalar>(_dt), _pos_state.cast<Scalar>(), _vel_state.cast<Scalar>(),
+                   _pos_reference.cast<Scalar>(), _vel_reference.cast<Scalar>(),
+                   _acc_reference.cast<Scalar>())
+      .template cast<double>();
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+Eigen::Vector3d DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::getForceFeedforward(
+    const double &_dt,
+    const Eigen::Vector3d &_pos_state,
+    const Eigen::Vector3d &_vel_state,
+    const Eigen::Vector3d &_pos_reference,
+    const Eigen::Vector3d &_vel_reference,
+    const Eigen::Vector3d &_specific_force) {
+  return getForceFeedforwardT(static_cast<Scalar>(_dt), _pos_state.cast<Scalar>(),
+                              _vel_state.cast<Scalar>(), _pos_reference.cast<Scalar>(),
+                              _vel_reference.cast<Scalar>(), _specific_force.cast<Scalar>())
+      .template cast<double>();
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+Eigen::Matrix3d DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::computeDesiredAttitude(
+    const Eigen::Vector3d &_desired_force,
+    const double &_yaw_angle_reference) {
+  return computeDesiredAttitudeT(_desired_force.cast<Scalar>(),
+                                 static_cast<Scalar>(_yaw_angle_reference))
+      .template cast<double>();
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+Eigen::Matrix3d
+DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::computeDesiredAttitudeFromHeading(
+    const Eigen::Vector3d &_desired_force,
+    const Eigen::Vector3d &_heading) {
+  return computeDesiredAttitudeFromHeadingT(_desired_force.cast<Scalar>(), _heading.cast<Scalar>())
+      .template cast<double>();
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+Acro_command DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::computeAttitudeControl(
+    const Eigen::Vector3d &_desired_force,
+    const Eigen::Matrix3d &_R_des,
+    const Eigen::Matrix3d &_rot_matrix) const {
+  return computeAttitudeControlT(_desired_force.cast<Scalar>(), _R_des.cast<Scalar>(),
+                                 _rot_matrix.cast<Scalar>());
+}
+
+template <typename Scalar, typename GainStructure, typename AntiwindupPolicy>
+Acro_command DFControlLawT<Scalar, GainStructure, AntiwindupPolicy>::computeTrajectoryControl(
+    const double &_dt,
+    const Eigen::Vector3d &_pos_state,
+    const Eigen::Vector3d &_vel_state,
+    const Eigen::Matrix3d &_rot_matrix,
+    const Eigen::Vector3d &_pos_reference,
+    const Eigen::Vector3d &_vel_reference,
+    const Eigen::Vector3d &_acc_reference,
+    const double &_yaw_angle_reference) {
+  const Vector3 desired_force =
+      getForceT(static_cast<Scalar>(_dt), _pos_state.cast<Scalar>(), _vel_state.cast<Scalar>(),
+                _pos_reference.cast<Scalar>(), _vel_reference.cast<Scalar>(),
+                _acc_reference.cast<Scalar>());
+
+  // Compute the desired attitude
+  const Matrix3 R_des =
+      computeDesiredAttitudeT(desired_force, static_cast<Scalar>(_yaw_angle_reference));
+
+  return computeAttitudeControlT(desired_force, R_des, _rot_matrix.cast<Scalar>());
+}
+
+template class DFControlLawT<double, FullGains, ClampAntiwindup>;
+template class DFControlLawT<double, FullGains, NoAntiwindup>;
+template class DFControlLawT<double, DiagonalGains, ClampAntiwindup>;
+template class DFControlLawT<double, DiagonalGains, NoAntiwindup>;
+template class DFControlLawT<float, FullGains, ClampAntiwindup>;
+template class DFControlLawT<float, FullGains, NoAntiwindup>;
+template class DFControlLawT<float, DiagonalGains, ClampAntiwindup>;
+template class DFControlLawT<float, DiagonalGains, NoAntiwindup>;
+
+template <typename Law>
+static void replaceLaw(DFControlLawVariant &_law) {
+  const DF_gains gains = std::visit([](const auto &law) { return law.getGains(); }, _law);
+  const Eigen::Vector3d integral =
+      std::visit([](const auto &law) { return law.getIntegral(); }, _law);
+
+  Law new_law(gains);
+  new_law.setIntegral(integral);
+  _law = new_law;
+}
+
+template <typename Scalar, typename GainStructure>
+static bool selectAntiwindup(const std::string &_antiwindup, DFControlLawVariant &_law) {
+  if (_antiwindup == "clamp") {
+    replaceLaw<DFControlLawT<Scalar, GainStructure, ClampAntiwindup>>(_law);
+  } else if (_antiwindup == "none") {
+    replaceLaw<DFControlLawT<Scalar, GainStructure, NoAntiwindup>>(_law);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <typename Scalar>
+static bool selectGainStructure(const std::string &_gain_structure,
+                                const std::string &_antiwindup,
+                                DFControlLawVariant &_law) {
+  if (_gain_structure == "full") {
+    return selectAntiwindup<Scalar, FullGains>(_antiwindup, _law);
+  } else if (_gain_structure == "diagonal") {
+    return selectAntiwindup<Scalar, DiagonalGains>(_antiwindup, _law);
+  }
+  return false;
+}
+
+bool selectDFControlLaw(const std::string &_scalar_type,
+                        const std::string &_gain_structure,
+                        const std::string &_antiwindup,
+                        DFControlLawVariant &_law) {
+  if (_scalar_type == "double") {
+    return selectGainStructure<double>(_gain_structure, _antiwindup, _law);
+  } else if (_scalar_type == "float") {
+    return selectGainStructure<float>(_gain_structure, _antiwindup, _law);
+  }
+  return false;
+}
+
+}  // namespace controller_plugin_differential_flatness
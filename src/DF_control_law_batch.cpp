@@ -0,0 +1,172 @@
+/*!*******************************************************************************************
+ *  \file       DF_control_law_batch.cpp
+ *  \brief      Structure-of-arrays differential flatness control law for many vehicles.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "DF_control_law_batch.hpp"
+#include "DF_control_law_batch_kernel.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+#ifdef DF_BATCH_HAVE_AVX2
+void computeTrajectoryControlBatchAVX2(batch_kernel::BatchView &_batch,
+                                       const double &_dt,
+                                       std::size_t _begin,
+                                       std::size_t _end);
+#endif
+
+static batch_kernel::BatchView makeView(DF_batch &_b) {
+  return {_b.position.x.data(),
+          _b.position.y.data(),
+          _b.position.z.data(),
+          _b.velocity.x.data(),
+          _b.velocity.y.data(),
+          _b.velocity.z.data(),
+          _b.attitude.w.data(),
+          _b.attitude.x.data(),
+          _b.attitude.y.data(),
+          _b.attitude.z.data(),
+          _b.ref_position.x.data(),
+          _b.ref_position.y.data(),
+          _b.ref_position.z.data(),
+          _b.ref_velocity.x.data(),
+          _b.ref_velocity.y.data(),
+          _b.ref_velocity.z.data(),
+          _b.ref_acceleration.x.data(),
+          _b.ref_acceleration.y.data(),
+          _b.ref_acceleration.z.data(),
+          _b.ref_yaw.data(),
+          _b.Kp.x.data(),
+          _b.Kp.y.data(),
+          _b.Kp.z.data(),
+          _b.Kd.x.data(),
+          _b.Kd.y.data(),
+          _b.Kd.z.data(),
+          _b.Ki.x.data(),
+          _b.Ki.y.data(),
+          _b.Ki.z.data(),
+          _b.Kp_ang.x.data(),
+          _b.Kp_ang.y.data(),
+          _b.Kp_ang.z.data(),
+          _b.mass.data(),
+          _b.antiwindup_cte.data(),
+          _b.accum_pos_error.x.data(),
+          _b.accum_pos_error.y.data(),
+          _b.accum_pos_error.z.data(),
+          _b.PQR.x.data(),
+          _b.PQR.y.data(),
+          _b.PQR.z.data(),
+          _b.thrust.data()};
+}
+
+void DF_batch::resize(std::size_t _size) {
+  size = _size;
+  position.resize(_size);
+  velocity.resize(_size);
+  attitude.resize(_size);
+  ref_position.resize(_size);
+  ref_velocity.resize(_size);
+  ref_acceleration.resize(_size);
+  ref_yaw.assign(_size, 0.0);
+  Kp.resize(_size);
+  Kd.resize(_size);
+  Ki.resize(_size);
+  Kp_ang.resize(_size);
+  mass.assign(_size, 0.0);
+  antiwindup_cte.assign(_size, 0.0);
+  accum_pos_error.resize(_size);
+  PQR.resize(_size);
+  thrust.assign(_size, 0.0);
+}
+
+void DF_batch::setGains(std::size_t _index, const DF_gains &_gains) {
+  Kp.x[_index]           = _gains.Kp(0, 0);
+  Kp.y[_index]           = _gains.Kp(1, 1);
+  Kp.z[_index]           = _gains.Kp(2, 2);
+  Kd.x[_index]           = _gains.Kd(0, 0);
+  Kd.y[_index]           = _gains.Kd(1, 1);
+  Kd.z[_index]           = _gains.Kd(2, 2);
+  Ki.x[_index]           = _gains.Ki(0, 0);
+  Ki.y[_index]           = _gains.Ki(1, 1);
+  Ki.z[_index]           = _gains.Ki(2, 2);
+  Kp_ang.x[_index]       = _gains.Kp_ang(0, 0);
+  Kp_ang.y[_index]       = _gains.Kp_ang(1, 1);
+  Kp_ang.z[_index]       = _gains.Kp_ang(2, 2);
+  mass[_index]           = _gains.mass;
+  antiwindup_cte[_index] = _gains.antiwindup_cte;
+}
+
+Acro_command DF_batch::getCommand(std::size_t _index) const {
+  Acro_command command;
+  command.PQR    = Eigen::Vector3d(PQR.x[_index], PQR.y[_index], PQR.z[_index]);
+  command.thrust = thrust[_index];
+  return command;
+}
+
+bool batchKernelUsesAVX2() {
+#ifdef DF_BATCH_HAVE_AVX2
+  static const bool cpu_has_avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return cpu_has_avx2;
+#else
+  return false;
+#endif
+}
+
+void computeTrajectoryControlBatchScalar(DF_batch &_batch,
+                                         const double &_dt,
+                                         std::size_t _begin,
+                                         std::size_t _end) {
+  batch_kernel::BatchView view = makeView(_batch);
+  for (std::size_t i = _begin; i < _end; i++) {
+    batch_kernel::step<batch_kernel::ScalarLane>(view, _dt, i);
+  }
+}
+
+void computeTrajectoryControlBatch(DF_batch &_batch,
+                                   const double &_dt,
+                                   std::size_t _begin,
+                                   std::size_t _end) {
+#ifdef DF_BATCH_HAVE_AVX2
+  if (batchKernelUsesAVX2()) {
+    batch_kernel::BatchView view = makeView(_batch);
+    computeTrajectoryControlBatchAVX2(view, _dt, _begin, _end);
+    return;
+  }
+#endif
+  computeTrajectoryControlBatchScalar(_batch, _dt, _begin, _end);
+}
+
+}  // namespace controller_plugin_differential_flatness
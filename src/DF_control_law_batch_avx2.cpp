@@ -0,0 +1,103 @@
+/*!*******************************************************************************************
+ *  \file       DF_control_law_batch_avx2.cpp
+ *  \brief      AVX2 lane for the batched control law kernel.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+// This translation unit is only built when the compiler accepts -mavx2 -mfma, and it is only
+// called after a runtime check of the CPU features.
+
+#include <immintrin.h>
+
+#include "DF_control_law_batch_kernel.hpp"
+
+namespace controller_plugin_differential_flatness {
+namespace batch_kernel {
+namespace {
+
+struct AVX2Value {
+  __m256d v;
+};
+
+inline AVX2Value operator+(const AVX2Value &_a, const AVX2Value &_b) {
+  return {_mm256_add_pd(_a.v, _b.v)};
+}
+inline AVX2Value operator-(const AVX2Value &_a, const AVX2Value &_b) {
+  return {_mm256_sub_pd(_a.v, _b.v)};
+}
+inline AVX2Value operator*(const AVX2Value &_a, const AVX2Value &_b) {
+  return {_mm256_mul_pd(_a.v, _b.v)};
+}
+inline AVX2Value operator/(const AVX2Value &_a, const AVX2Value &_b) {
+  return {_mm256_div_pd(_a.v, _b.v)};
+}
+
+struct AVX2Lane {
+  using type                         = AVX2Value;
+  static constexpr std::size_t width = 4;
+
+  static type load(const double *_ptr) { return {_mm256_loadu_pd(_ptr)}; }
+  static void store(double *_ptr, const type &_value) { _mm256_storeu_pd(_ptr, _value.v); }
+  static type set1(const double &_value) { return {_mm256_set1_pd(_value)}; }
+  static type sqrt(const type &_value) { return {_mm256_sqrt_pd(_value.v)}; }
+  // The intrinsics return their second operand when either is NaN, ScalarLane returns _a. The
+  // operands are swapped so both paths keep _a, e.g. a 0 / 0 anti-windup bound when Ki is 0
+  static type min(const type &_a, const type &_b) { return {_mm256_min_pd(_b.v, _a.v)}; }
+  static type max(const type &_a, const type &_b) { return {_mm256_max_pd(_b.v, _a.v)}; }
+  static type positiveOr(const type &_value, const type &_fallback) {
+    const __m256d mask = _mm256_cmp_pd(_value.v, _mm256_setzero_pd(), _CMP_GT_OQ);
+    return {_mm256_blendv_pd(_fallback.v, _value.v, mask)};
+  }
+  static type roundToFloat(const type &_value) {
+    return {_mm256_cvtps_pd(_mm256_cvtpd_ps(_value.v))};
+  }
+};
+
+}  // namespace
+}  // namespace batch_kernel
+
+void computeTrajectoryControlBatchAVX2(batch_kernel::BatchView &_batch,
+                                       const double &_dt,
+                                       std::size_t _begin,
+                                       std::size_t _end) {
+  std::size_t i = _begin;
+  for (; i + batch_kernel::AVX2Lane::width <= _end; i += batch_kernel::AVX2Lane::width) {
+    batch_kernel::step<batch_kernel::AVX2Lane>(_batch, _dt, i);
+  }
+  for (; i < _end; i++) {
+    batch_kernel::step<batch_kernel::ScalarLane>(_batch, _dt, i);
+  }
+}
+
+}  // namespace controller_plugin_differential_flatness
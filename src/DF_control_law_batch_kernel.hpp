@@ -0,0 +1,215 @@
+/*!*******************************************************************************************
+ *  \file       DF_control_law_batch_kernel.hpp
+ *  \brief      Vector-width agnostic kernel shared by the batched control law paths.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#ifndef __DF_CONTROL_LAW_BATCH_KERNEL_H__
+#define __DF_CONTROL_LAW_BATCH_KERNEL_H__
+
+#include <cmath>
+#include <cstddef>
+
+namespace controller_plugin_differential_flatness {
+namespace batch_kernel {
+
+/* Raw pointers into DF_batch. The vectorized translation unit is built with different
+ * instruction set flags, so it only sees plain arrays and never Eigen types. */
+struct BatchView {
+  const double *position_x, *position_y, *position_z;
+  const double *velocity_x, *velocity_y, *velocity_z;
+  const double *attitude_w, *attitude_x, *attitude_y, *attitude_z;
+  const double *ref_position_x, *ref_position_y, *ref_position_z;
+  const double *ref_velocity_x, *ref_velocity_y, *ref_velocity_z;
+  const double *ref_acceleration_x, *ref_acceleration_y, *ref_acceleration_z;
+  const double *ref_yaw;
+  const double *Kp_x, *Kp_y, *Kp_z;
+  const double *Kd_x, *Kd_y, *Kd_z;
+  const double *Ki_x, *Ki_y, *Ki_z;
+  const double *Kp_ang_x, *Kp_ang_y, *Kp_ang_z;
+  const double *mass;
+  const double *antiwindup_cte;
+  double *accum_pos_error_x, *accum_pos_error_y, *accum_pos_error_z;
+  double *PQR_x, *PQR_y, *PQR_z;
+  double *thrust;
+};
+
+/* Everything below is compiled once per including translation unit, with that unit's instruction
+ * set flags. Internal linkage keeps the linker from merging the -mavx2 -mfma copy of the scalar
+ * path with the baseline one, which would run FMA instructions on CPUs without them. */
+namespace {
+
+/* Lane type for the scalar path. A vector lane must provide the same static interface and
+ * arithmetic operators on its value type. */
+struct ScalarLane {
+  using type                         = double;
+  static constexpr std::size_t width = 1;
+
+  static type load(const double *_ptr) { return *_ptr; }
+  static void store(double *_ptr, const type &_value) { *_ptr = _value; }
+  static type set1(const double &_value) { return _value; }
+  static type sqrt(const type &_value) { return std::sqrt(_value); }
+  static type min(const type &_a, const type &_b) { return _b < _a ? _b : _a; }
+  static type max(const type &_a, const type &_b) { return _a < _b ? _b : _a; }
+  /* _value when _value > 0, _fallback otherwise */
+  static type positiveOr(const type &_value, const type &_fallback) {
+    return _value > 0.0 ? _value : _fallback;
+  }
+  static type roundToFloat(const type &_value) {
+    return static_cast<double>(static_cast<float>(_value));
+  }
+};
+
+/* Same operation order as DFControlLaw::computeTrajectoryControl with diagonal gains, so both
+ * paths agree up to floating point contraction */
+template <class L>
+inline void step(BatchView &_b, const double &_dt, std::size_t _i) {
+  using V = typename L::type;
+
+  double cos_yaw[L::width];
+  double sin_yaw[L::width];
+  for (std::size_t k = 0; k < L::width; k++) {
+    cos_yaw[k] = std::cos(_b.ref_yaw[_i + k]);
+    sin_yaw[k] = std::sin(_b.ref_yaw[_i + k]);
+  }
+
+  const V zero = L::set1(0.0);
+  const V one  = L::set1(1.0);
+  const V dt   = L::set1(_dt);
+
+  // getForce
+  const V ex  = L::load(&_b.ref_position_x[_i]) - L::load(&_b.position_x[_i]);
+  const V ey  = L::load(&_b.ref_position_y[_i]) - L::load(&_b.position_y[_i]);
+  const V ez  = L::load(&_b.ref_position_z[_i]) - L::load(&_b.position_z[_i]);
+  const V evx = L::load(&_b.ref_velocity_x[_i]) - L::load(&_b.velocity_x[_i]);
+  const V evy = L::load(&_b.ref_velocity_y[_i]) - L::load(&_b.velocity_y[_i]);
+  const V evz = L::load(&_b.ref_velocity_z[_i]) - L::load(&_b.velocity_z[_i]);
+
+  const V kix = L::load(&_b.Ki_x[_i]);
+  const V kiy = L::load(&_b.Ki_y[_i]);
+  const V kiz = L::load(&_b.Ki_z[_i]);
+  const V aw  = L::load(&_b.antiwindup_cte[_i]);
+
+  V ax = L::load(&_b.accum_pos_error_x[_i]) + ex * dt;
+  V ay = L::load(&_b.accum_pos_error_y[_i]) + ey * dt;
+  V az = L::load(&_b.accum_pos_error_z[_i]) + ez * dt;
+
+  const V bx = aw / kix;
+  const V by = aw / kiy;
+  const V bz = aw / kiz;
+  ax         = L::min(L::max(ax, zero - bx), bx);
+  ay         = L::min(L::max(ay, zero - by), by);
+  az         = L::min(L::max(az, zero - bz), bz);
+  L::store(&_b.accum_pos_error_x[_i], ax);
+  L::store(&_b.accum_pos_error_y[_i], ay);
+  L::store(&_b.accum_pos_error_z[_i], az);
+
+  const V mass = L::load(&_b.mass[_i]);
+  const V fx   = L::load(&_b.Kp_x[_i]) * ex + L::load(&_b.Kd_x[_i]) * evx + kix * ax -
+               mass * zero + mass * L::load(&_b.ref_acceleration_x[_i]);
+  const V fy = L::load(&_b.Kp_y[_i]) * ey + L::load(&_b.Kd_y[_i]) * evy + kiy * ay -
+               mass * zero + mass * L::load(&_b.ref_acceleration_y[_i]);
+  const V fz = L::load(&_b.Kp_z[_i]) * ez + L::load(&_b.Kd_z[_i]) * evz + kiz * az -
+               mass * L::set1(-9.81) + mass * L::load(&_b.ref_acceleration_z[_i]);
+
+  // computeDesiredAttitude
+  const V xcx = L::load(cos_yaw);
+  const V xcy = L::load(sin_yaw);
+
+  V n             = L::positiveOr(L::sqrt(fx * fx + fy * fy + fz * fz), one);
+  const V zbx     = fx / n;
+  const V zby     = fy / n;
+  const V zbz     = fz / n;
+  const V ybx_raw = zby * zero - zbz * xcy;
+  const V yby_raw = zbz * xcx - zbx * zero;
+  const V ybz_raw = zbx * xcy - zby * xcx;
+  n = L::positiveOr(L::sqrt(ybx_raw * ybx_raw + yby_raw * yby_raw + ybz_raw * ybz_raw), one);
+  const V ybx     = ybx_raw / n;
+  const V yby     = yby_raw / n;
+  const V ybz     = ybz_raw / n;
+  const V xbx_raw = yby * zbz - ybz * zby;
+  const V xby_raw = ybz * zbx - ybx * zbz;
+  const V xbz_raw = ybx * zby - yby * zbx;
+  n = L::positiveOr(L::sqrt(xbx_raw * xbx_raw + xby_raw * xby_raw + xbz_raw * xbz_raw), one);
+  const V xbx     = xbx_raw / n;
+  const V xby     = xby_raw / n;
+  const V xbz     = xbz_raw / n;
+
+  // Attitude as a rotation matrix, same expansion as Eigen::Quaternion::toRotationMatrix
+  const V qw  = L::load(&_b.attitude_w[_i]);
+  const V qx  = L::load(&_b.attitude_x[_i]);
+  const V qy  = L::load(&_b.attitude_y[_i]);
+  const V qz  = L::load(&_b.attitude_z[_i]);
+  const V two = L::set1(2.0);
+  const V tx  = two * qx;
+  const V ty  = two * qy;
+  const V tz  = two * qz;
+  const V twx = tx * qw;
+  const V twy = ty * qw;
+  const V twz = tz * qw;
+  const V txx = tx * qx;
+  const V txy = ty * qx;
+  const V txz = tz * qx;
+  const V tyy = ty * qy;
+  const V tyz = tz * qy;
+  const V tzz = tz * qz;
+  const V r00 = one - (tyy + tzz);
+  const V r01 = txy - twz;
+  const V r02 = txz + twy;
+  const V r10 = txy + twz;
+  const V r11 = one - (txx + tzz);
+  const V r12 = tyz - twx;
+  const V r20 = txz - twy;
+  const V r21 = tyz + twx;
+  const V r22 = one - (txx + tyy);
+
+  // computeAttitudeControl
+  const V e_rot_x = ((zbx * r01 + zby * r11 + zbz * r21) - (r02 * ybx + r12 * yby + r22 * ybz));
+  const V e_rot_y = ((xbx * r02 + xby * r12 + xbz * r22) - (r00 * zbx + r10 * zby + r20 * zbz));
+  const V e_rot_z = ((ybx * r00 + yby * r10 + ybz * r20) - (r01 * xbx + r11 * xby + r21 * xbz));
+  const V half    = L::set1(0.5);
+
+  L::store(&_b.PQR_x[_i], (zero - L::load(&_b.Kp_ang_x[_i])) * (half * e_rot_x));
+  L::store(&_b.PQR_y[_i], (zero - L::load(&_b.Kp_ang_y[_i])) * (half * e_rot_y));
+  L::store(&_b.PQR_z[_i], (zero - L::load(&_b.Kp_ang_z[_i])) * (half * e_rot_z));
+
+  n = L::positiveOr(L::sqrt(r02 * r02 + r12 * r12 + r22 * r22), one);
+  L::store(&_b.thrust[_i], L::roundToFloat(fx * (r02 / n) + fy * (r12 / n) + fz * (r22 / n)));
+}
+
+}  // namespace
+}  // namespace batch_kernel
+}  // namespace controller_plugin_differential_flatness
+
+#endif
@@ -36,13 +36,81 @@
 
 #include "DF_controller_plugin.hpp"
 #include <Eigen/src/Core/GlobalFunctions.h>
+#include <algorithm>
+#include <as2_core/names/topics.hpp>
 #include <as2_core/utils/tf_utils.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <functional>
 
 namespace controller_plugin_differential_flatness {
 
+static constexpr std::array<const char *, latency_stage_count> latency_stage_names = {
+    "flag_checks", "inputs", "get_force", "attitude", "get_output", "total"};
+
+/* Monotonic clock for the latency histograms, in nanoseconds */
+static inline uint64_t latencyClockNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/* Period of report(), and the calls between two runs of the 1 Hz reports */
+static constexpr std::chrono::milliseconds report_period(200);
+static constexpr uint32_t slow_report_divider = 5;
+
+/* Mode of the prewarm ticks, packed as active_mode_in_ */
+static constexpr uint16_t prewarm_mode = as2_msgs::msg::ControlMode::HOVER |
+                                         as2_msgs::msg::ControlMode::YAW_ANGLE << 8;
+
 void Plugin::ownInitialize() {
   odom_frame_id_      = as2::tf::generateTfName(node_ptr_, odom_frame_id_);
   base_link_frame_id_ = as2::tf::generateTfName(node_ptr_, base_link_frame_id_);
+  odom_frame_.assign(odom_frame_id_);
+  base_link_frame_.assign(base_link_frame_id_);
+
+  // Read once, the state source is not switched in flight
+  const std::string odometry_parameter = "trajectory_control.odometry_topic";
+  const std::string odometry_topic =
+      node_ptr_->has_parameter(odometry_parameter)
+          ? node_ptr_->get_parameter(odometry_parameter).as_string()
+          : node_ptr_->declare_parameter<std::string>(odometry_parameter, "");
+  use_odometry_ = !odometry_topic.empty();
+  if (use_odometry_) {
+    odometry_sub_ = node_ptr_->create_subscription<nav_msgs::msg::Odometry>(
+        odometry_topic, as2_names::topics::self_localization::qos,
+        [this](const nav_msgs::msg::Odometry::SharedPtr _msg) { updateOdometry(*_msg); });
+    RCLCPP_INFO(node_ptr_->get_logger(), "State from the odometry on %s, pose and twist ignored",
+                odometry_topic.c_str());
+  }
+
+  prediction_horizon_pub_ =
+      node_ptr_->create_publisher<std_msgs::msg::Float64>("controller/prediction_horizon", 10);
+
+  segments_sub_ = node_ptr_->create_subscription<std_msgs::msg::Float64MultiArray>(
+      "controller/trajectory_segments", 10,
+      std::bind(&Plugin::segmentsCallback, this, std::placeholders::_1));
+
+  gain_profile_sub_ = node_ptr_->create_subscription<std_msgs::msg::String>(
+      "controller/gain_profile", 10,
+      std::bind(&Plugin::profileCallback, this, std::placeholders::_1));
+
+  latency_pub_ =
+      node_ptr_->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("controller/latency", 10);
+
+  health_pub_ =
+      node_ptr_->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("controller/health", 10);
+
+  if (!external_reports_) {
+    report_timer_ = node_ptr_->create_wall_timer(report_period, std::bind(&Plugin::report, this));
+  }
+
+  perf_service_ = node_ptr_->create_service<std_srvs::srv::Trigger>(
+      "controller/perf_counters", std::bind(&Plugin::dumpPerfCounters, this,
+                                            std::placeholders::_1, std::placeholders::_2));
   reset();
   return;
 };
@@ -52,15 +120,6 @@ bool Plugin::updateParams(const std::vector<std::string> &_params_list) {
   return result.successful;
 };
 
-bool Plugin::checkParamList(const std::string &param, std::vector<std::string> &_params_list) {
-  if (find(_params_list.begin(), _params_list.end(), param) != _params_list.end()) {
-    // Remove the parameter from the list of parameters to be read
-    _params_list.erase(std::remove(_params_list.begin(), _params_list.end(), param),
-                       _params_list.end());
-  };
-  return !_params_list.size();  // Return true if the list is empty
-};
-
 rcl_interfaces::msg::SetParametersResult Plugin::parametersCallback(
     const std::vector<rclcpp::Parameter> &parameters) {
   rcl_interfaces::msg::SetParametersResult result;
@@ -70,99 +129,665 @@ rcl_interfaces::msg::SetParametersResult Plugin::parametersCallback(
   for (auto &param : parameters) {
     updateDFParameter(param.get_name(), param);
   }
+
+  // The whole batch reaches computeOutput at once, so it never runs with half of the new gains
+  publishControlLaw();
+  flags_.parameters_read = parameters_to_read_ == 0;
+  updateRealtime();
+  updateRecorder();
+  updateMailbox();
+  updateLookahead();
+  updateStandby();
+  if (reset_integral_.load(std::memory_order_relaxed) &&
+      standby_role_.load(std::memory_order_relaxed) != Standby_role::none) {
+    RCLCPP_WARN(node_ptr_->get_logger(),
+                "Standby role %s with reset_integral set, the integral is cleared every tick and "
+                "the secondary takes over without it",
+                standby_role_name_.c_str());
+  }
   return result;
 }
 
-void Plugin::updateDFParameter(std::string _parameter_name, const rclcpp::Parameter &_param) {
-  std::string controller    = _parameter_name.substr(0, _parameter_name.find("."));
-  std::string param_subname = _parameter_name.substr(_parameter_name.find(".") + 1);
-
-  if (controller == "trajectory_control") {
-    // TODO check if this is a good way to do it or it is better to write the full name
-    _parameter_name = param_subname;
-  }
-
-  if (_parameter_name == "mass") {
-    mass_ = _param.get_value<double>();
-  } else if (_parameter_name == "antiwindup_cte") {
-    antiwindup_cte_ = _param.get_value<double>();
-  } else if (_parameter_name == "kp.x") {
-    Kp_(0, 0) = _param.get_value<double>();
-  } else if (_parameter_name == "kp.y") {
-    Kp_(1, 1) = _param.get_value<double>();
-  } else if (_parameter_name == "kp.z") {
-    Kp_(2, 2) = _param.get_value<double>();
-  } else if (_parameter_name == "ki.x") {
-    Ki_(0, 0) = _param.get_value<double>();
-  } else if (_parameter_name == "ki.y") {
-    Ki_(1, 1) = _param.get_value<double>();
-  } else if (_parameter_name == "ki.z") {
-    Ki_(2, 2) = _param.get_value<double>();
-  } else if (_parameter_name == "kd.x") {
-    Kd_(0, 0) = _param.get_value<double>();
-  } else if (_parameter_name == "kd.y") {
-    Kd_(1, 1) = _param.get_value<double>();
-  } else if (_parameter_name == "kd.z") {
-    Kd_(2, 2) = _param.get_value<double>();
-  } else if (_parameter_name == "roll_control.kp") {
-    Kp_ang_mat_(0, 0) = _param.get_value<double>();
-  } else if (_parameter_name == "pitch_control.kp") {
-    Kp_ang_mat_(1, 1) = _param.get_value<double>();
-  } else if (_parameter_name == "yaw_control.kp") {
-    Kp_ang_mat_(2, 2) = _param.get_value<double>();
-  }
-  flags_.parameters_read = checkParamList(_param.get_name(), parameters_to_read_);
+void Plugin::updateDFParameter(const std::string &_parameter_name,
+                               const rclcpp::Parameter &_param) {
+  const DF_parameter parameter = findParameter(_parameter_name);
+  switch (parameter) {
+    case DF_parameter::alpha:
+      staged_alpha_ = _param.get_value<double>();
+      break;
+    case DF_parameter::law_scalar_type:
+      law_scalar_type_ = _param.get_value<std::string>();
+      updateControlLaw();
+      return;
+    case DF_parameter::law_gain_structure:
+      law_gain_structure_ = _param.get_value<std::string>();
+      updateControlLaw();
+      return;
+    case DF_parameter::law_antiwindup:
+      law_antiwindup_ = _param.get_value<std::string>();
+      updateControlLaw();
+      return;
+    case DF_parameter::reset_integral:
+      reset_integral_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::reference_buffer_enabled:
+      use_reference_buffer_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::reference_buffer_lookahead:
+      reference_lookahead_ = _param.get_value<double>();
+      return;
+    case DF_parameter::realtime_enabled:
+      realtime_options_changed_ |= realtime_enabled_ != _param.get_value<bool>();
+      realtime_enabled_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::realtime_rate:
+      realtime_options_.rate    = _param.get_value<double>();
+      realtime_options_changed_ = true;
+      return;
+    case DF_parameter::realtime_priority:
+      realtime_options_.priority = static_cast<int>(_param.get_value<int64_t>());
+      realtime_options_changed_  = true;
+      return;
+    case DF_parameter::realtime_cpu:
+      realtime_options_.cpu     = static_cast<int>(_param.get_value<int64_t>());
+      realtime_options_changed_ = true;
+      return;
+    case DF_parameter::realtime_lock_memory:
+      realtime_options_.lock_memory = _param.get_value<bool>();
+      realtime_options_changed_     = true;
+      return;
+    case DF_parameter::realtime_prefault_stack:
+      realtime_options_.prefault_stack = static_cast<std::size_t>(_param.get_value<int64_t>());
+      realtime_options_changed_        = true;
+      return;
+    case DF_parameter::outer_loop_rate:
+      outer_loop_rate_ = _param.get_value<double>();
+      return;
+    case DF_parameter::recorder_enabled:
+      recorder_options_changed_ |= recorder_enabled_ != _param.get_value<bool>();
+      recorder_enabled_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::recorder_directory:
+      recorder_options_changed_ |= recorder_directory_ != _param.get_value<std::string>();
+      recorder_directory_ = _param.get_value<std::string>();
+      return;
+    case DF_parameter::mailbox_enabled:
+      mailbox_options_changed_ |= mailbox_enabled_ != _param.get_value<bool>();
+      mailbox_enabled_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::mailbox_name:
+      mailbox_options_changed_ |= mailbox_name_ != _param.get_value<std::string>();
+      mailbox_name_ = _param.get_value<std::string>();
+      return;
+    case DF_parameter::standby_role:
+      standby_options_changed_ |= standby_role_name_ != _param.get_value<std::string>();
+      standby_role_name_ = _param.get_value<std::string>();
+      return;
+    case DF_parameter::standby_channel:
+      standby_options_changed_ |= standby_channel_ != _param.get_value<std::string>();
+      standby_channel_ = _param.get_value<std::string>();
+      return;
+    case DF_parameter::standby_timeout:
+      standby_timeout_ = _param.get_value<double>();
+      return;
+    case DF_parameter::gain_schedule_file:
+      updateGainSchedule(_param.get_value<std::string>());
+      return;
+    case DF_parameter::gain_schedule_profile:
+      gain_profile_name_ = _param.get_value<std::string>();
+      selectGainProfile(gain_profile_name_);
+      return;
+    case DF_parameter::segments_enabled:
+      use_trajectory_segments_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::lookahead_cache_enabled:
+      use_lookahead_cache_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::lookahead_cache_sample_period:
+      lookahead_sample_period_ = _param.get_value<double>();
+      return;
+    case DF_parameter::lookahead_cache_horizon:
+      lookahead_horizon_ = _param.get_value<double>();
+      return;
+    case DF_parameter::state_prediction_enabled:
+      use_state_prediction_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::state_prediction_max_horizon:
+      max_prediction_horizon_ = _param.get_value<double>();
+      return;
+    case DF_parameter::latency_enabled:
+      measure_latency_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::perf_counters_enabled:
+      measure_perf_ = _param.get_value<bool>();
+      return;
+    case DF_parameter::odometry_topic:
+      // Read once by ownInitialize
+      return;
+    case DF_parameter::unknown:
+      return;
+    default:
+      setGainParameter(parameter, _param.get_value<double>(), staged_gains_);
+      break;
+  }
+  parameters_to_read_.fetch_and(~parameterBit(parameter));
   return;
 }
 
+/* Start, restart or stop the real-time thread after a batch of parameters. The thread is started
+ * from the parameter callback, which the single threaded executor never runs during a tick */
+void Plugin::updateRealtime() {
+  if (!realtime_options_changed_) {
+    return;
+  }
+  realtime_options_changed_ = false;
+
+  if (!realtime_enabled_) {
+    if (realtime_thread_.running()) {
+      realtime_thread_.stop();
+      RCLCPP_INFO(node_ptr_->get_logger(), "Real-time thread stopped");
+    }
+    if (reset_pending_.exchange(false)) {
+      resetControlState();
+    }
+    return;
+  }
+
+  if (realtime_options_.rate <= 0.0) {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "Real-time rate must be positive, thread not started");
+    realtime_thread_.stop();
+    return;
+  }
+
+  std::string error;
+  const bool configured = realtime_thread_.start(
+      realtime_options_, [this]() { prewarm(); }, [this](double dt) { realtimeTick(dt); }, error);
+  if (!configured) {
+    RCLCPP_WARN(node_ptr_->get_logger(), "Real-time thread running without part of its setup: %s",
+                error.c_str());
+  }
+  RCLCPP_INFO(node_ptr_->get_logger(), "Real-time thread at %.0f Hz, priority %d, cpu %d",
+              realtime_options_.rate, realtime_options_.priority, realtime_options_.cpu);
+}
+
+/* Open a new recording, or close the current one, after a batch of parameters. Every start
+ * creates a new file named after the local time */
+void Plugin::updateRecorder() {
+  if (!recorder_options_changed_) {
+    return;
+  }
+  recorder_options_changed_ = false;
+
+  stopRecorder();
+  if (!recorder_enabled_) {
+    return;
+  }
+
+  char name[64];
+  const std::time_t now = std::time(nullptr);
+  std::tm local_time;
+  localtime_r(&now, &local_time);
+  std::strftime(name, sizeof(name), "/df_flight_%Y%m%d_%H%M%S.dfrec", &local_time);
+  const std::string path = recorder_directory_ + name;
+
+  std::string error;
+  if (!flight_recorder_.start(path, 0.01, error)) {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "Flight recorder not started: %s", error.c_str());
+    return;
+  }
+  recorder_started_           = true;
+  reported_recorder_overruns_ = 0;
+  RCLCPP_INFO(node_ptr_->get_logger(), "Flight recorder writing to %s", path.c_str());
+}
+
+void Plugin::stopRecorder() {
+  if (!recorder_started_) {
+    return;
+  }
+  recorder_started_ = false;
+  if (!flight_recorder_.stop()) {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "Flight recorder: %s",
+                 flight_recorder_.getError().c_str());
+  }
+  RCLCPP_INFO(node_ptr_->get_logger(), "Flight recorder stopped, %lu records, %lu overruns",
+              flight_recorder_.getRecorded(), flight_recorder_.getOverruns());
+}
+
+/* Queue the internals of the tick just computed. Never blocks, a full queue is an overrun */
+void Plugin::recordFlight(const double &_dt, const double &_now) {
+  if (!flight_recorder_.recording()) {
+    return;
+  }
+  const Eigen::Vector3d integral =
+      std::visit([](const auto &law) { return law.getIntegral(); }, control_law_);
+
+  Flight_record record;
+  fillFlightRecord(_now, _dt, control_state_.position, control_state_.velocity,
+                   control_state_.attitude, control_state_.rotation, control_ref_, integral,
+                   multi_rate_.getDesiredForce(), multi_rate_.getDesiredAttitude(),
+                   control_command_, record);
+  if (!prewarming_) {
+    flight_recorder_.push(record);
+  }
+}
+
+/* Warn about records lost since the last report and close a recording whose writer failed. Runs
+ * from report(), never on the tick */
+void Plugin::reportRecorder() {
+  if (!recorder_started_) {
+    return;
+  }
+  const uint64_t overruns = flight_recorder_.getOverruns();
+  if (overruns != reported_recorder_overruns_) {
+    RCLCPP_WARN(node_ptr_->get_logger(), "Flight recorder dropped %lu records",
+                overruns - reported_recorder_overruns_);
+    reported_recorder_overruns_ = overruns;
+  }
+  if (!flight_recorder_.recording()) {
+    stopRecorder();
+  }
+}
+
+/* Open or close the command mailbox after a batch of parameters. The tick may be writing to it
+ * meanwhile, the writer handles that */
+void Plugin::updateMailbox() {
+  if (!mailbox_options_changed_) {
+    return;
+  }
+  mailbox_options_changed_ = false;
+
+  command_mailbox_.close();
+  if (!mailbox_enabled_) {
+    return;
+  }
+
+  // One mailbox per controller by default, named after its namespace
+  std::string name = mailbox_name_;
+  if (name.empty()) {
+    name = "/df_commands" + std::string(node_ptr_->get_namespace());
+    std::replace(name.begin() + 1, name.end(), '/', '_');
+    if (name.back() == '_') {
+      name.pop_back();
+    }
+  }
+
+  std::string error;
+  if (!command_mailbox_.open(name, error)) {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "Command mailbox not opened: %s", error.c_str());
+    return;
+  }
+  RCLCPP_INFO(node_ptr_->get_logger(), "Writing commands to the mailbox %s", name.c_str());
+}
+
+/* Run the lookahead cache thread while enabled. The tick resynchronizes the cache on its own */
+void Plugin::updateLookahead() {
+  if (!use_lookahead_cache_) {
+    if (lookahead_storage_) {
+      lookahead_storage_->stop();
+    }
+    return;
+  }
+  if (!lookahead_storage_) {
+    lookahead_storage_ = std::make_unique<LookaheadCache>();
+    lookahead_cache_.store(lookahead_storage_.get(), std::memory_order_release);
+  }
+  lookahead_storage_->start();
+}
+
+/* Open the snapshot channel of the role after a batch of parameters. The tick may be using the
+ * channel meanwhile, both ends handle that */
+void Plugin::updateStandby() {
+  if (!standby_options_changed_) {
+    return;
+  }
+  standby_options_changed_ = false;
+
+  snapshot_writer_.close();
+  snapshot_reader_.close();
+  standby_channel_name_.clear();
+  Standby_role role = Standby_role::none;
+  if (standby_role_name_ == "primary") {
+    role = Standby_role::primary;
+  } else if (standby_role_name_ == "secondary") {
+    role = Standby_role::secondary;
+  } else if (standby_role_name_ != "none") {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "Unknown standby role %s, standby disabled",
+                 standby_role_name_.c_str());
+  }
+  // A new role starts from scratch, a secondary that had taken over stands by again
+  standby_role_  = role;
+  standby_reset_ = true;
+  if (role == Standby_role::none) {
+    return;
+  }
+
+  // One channel per controller pair by default, named after the namespace they share
+  std::string name = standby_channel_;
+  if (name.empty()) {
+    name = "/df_standby" + std::string(node_ptr_->get_namespace());
+    std::replace(name.begin() + 1, name.end(), '/', '_');
+    if (name.back() == '_') {
+      name.pop_back();
+    }
+  }
+
+  std::string error;
+  if (role == Standby_role::primary) {
+    if (!snapshot_writer_.open(name, error)) {
+      RCLCPP_ERROR(node_ptr_->get_logger(), "Standby channel not opened: %s", error.c_str());
+      return;
+    }
+    RCLCPP_INFO(node_ptr_->get_logger(), "Publishing snapshots to the standby channel %s",
+                name.c_str());
+    return;
+  }
+  // The primary may not have created the channel yet, reportStandby keeps trying
+  standby_channel_name_ = name;
+  reportStandby();
+}
+
+/* Open the channel of a secondary started before its primary, and log a takeover. Runs from
+ * report(), never on the tick */
+void Plugin::reportStandby() {
+  if (!standby_channel_name_.empty() && !snapshot_reader_.isOpen()) {
+    std::string error;
+    if (snapshot_reader_.open(standby_channel_name_, error)) {
+      RCLCPP_INFO(node_ptr_->get_logger(), "Standing by on the channel %s",
+                  standby_channel_name_.c_str());
+    }
+  }
+  if (standby_took_over_.exchange(false)) {
+    RCLCPP_WARN(node_ptr_->get_logger(), "Primary controller stopped, this one took over");
+  }
+}
+
+/* Warn about the state messages dropped since the last report. Runs from report(), so a source
+ * in the wrong frame costs one line per second instead of one per message */
+void Plugin::reportStateFrames() {
+  const uint64_t pose_twist = rejected_pose_twist_.load(std::memory_order_relaxed);
+  if (pose_twist != reported_pose_twist_) {
+    RCLCPP_ERROR(node_ptr_->get_logger(),
+                 "Dropped %lu pose and twist pairs, expected the pose or the twist in %s",
+                 pose_twist - reported_pose_twist_, odom_frame_.name().c_str());
+    reported_pose_twist_ = pose_twist;
+  }
+  const uint64_t odometry = rejected_odometry_.load(std::memory_order_relaxed);
+  if (odometry != reported_odometry_) {
+    RCLCPP_ERROR(node_ptr_->get_logger(),
+                 "Dropped %lu odometry messages, expected the pose in %s and the twist in %s or %s",
+                 odometry - reported_odometry_, odom_frame_.name().c_str(),
+                 odom_frame_.name().c_str(), base_link_frame_.name().c_str());
+    reported_odometry_ = odometry;
+  }
+}
+
+Controller_snapshot Plugin::takeSnapshot() const {
+  Controller_snapshot snapshot;
+  snapshot.stamp     = control_stamp_;
+  snapshot.mode      = active_mode_in_.load(std::memory_order_relaxed);
+  snapshot.integral  = std::visit([](const auto &law) { return law.getIntegral(); }, control_law_);
+  snapshot.reference = control_ref_;
+  snapshot.command   = control_command_;
+  return snapshot;
+}
+
+bool Plugin::restoreSnapshot(const Controller_snapshot &_snapshot) {
+  if (_snapshot.mode != active_mode_in_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  std::visit([&_snapshot](auto &law) { law.setIntegral(_snapshot.integral); }, control_law_);
+  control_ref_     = _snapshot.reference;
+  control_command_ = _snapshot.command;
+  flatness_valid_  = false;
+  // The held position loop output was computed from the replaced integral
+  multi_rate_.invalidate();
+  return true;
+}
+
+/* Secondary side of the tick: restore every new snapshot of the primary, and take over once they
+ * stop for longer than the timeout. A secondary that never received one keeps standing by. Returns
+ * true while the primary is in charge */
+bool Plugin::followPrimary(const double &_now) {
+  // A prewarm tick leaves the reset to the first armed one
+  if (prewarming_ ? standby_reset_.load() : standby_reset_.exchange(false)) {
+    standby_sequence_ = 0;
+    standby_active_   = false;
+  }
+  if (standby_active_ || standby_role_.load(std::memory_order_relaxed) != Standby_role::secondary) {
+    return false;
+  }
+
+  Controller_snapshot snapshot;
+  uint64_t sequence;
+  if (snapshot_reader_.read(snapshot, sequence) && sequence != standby_sequence_) {
+    standby_sequence_      = sequence;
+    standby_last_snapshot_ = _now;
+    restoreSnapshot(snapshot);
+    return true;
+  }
+  if (standby_sequence_ == 0 ||
+      _now - standby_last_snapshot_ <= standby_timeout_.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  standby_active_ = true;
+  if (!prewarming_) {
+    standby_took_over_ = true;
+  }
+  return false;
+}
+
+bool Plugin::updateControlLaw() {
+  if (!selectDFControlLaw(law_scalar_type_, law_gain_structure_, law_antiwindup_,
+                          staged_law_)) {
+    RCLCPP_ERROR(node_ptr_->get_logger(),
+                 "Unknown control law: scalar_type %s, gain_structure %s, antiwindup %s",
+                 law_scalar_type_.c_str(), law_gain_structure_.c_str(), law_antiwindup_.c_str());
+    return false;
+  }
+  RCLCPP_INFO(node_ptr_->get_logger(), "Control law: %s, %s gains, %s antiwindup",
+              law_scalar_type_.c_str(), law_gain_structure_.c_str(), law_antiwindup_.c_str());
+  return true;
+}
+
+/* Load the schedule of _path, an empty path disables scheduling. It reaches computeOutput with
+ * the rest of the batch. A schedule that fails to load leaves the previous one in place */
+bool Plugin::updateGainSchedule(const std::string &_path) {
+  if (_path.empty()) {
+    staged_gain_schedule_.reset();
+    return true;
+  }
+
+  auto schedule = std::make_shared<GainSchedule>();
+  std::string error;
+  if (!schedule->loadFile(_path, error)) {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "Gain schedule not loaded: %s", error.c_str());
+    return false;
+  }
+  staged_gain_schedule_ = schedule;
+  gain_schedule_generation_++;
+  RCLCPP_INFO(node_ptr_->get_logger(), "Gain schedule %s with %zu profiles", _path.c_str(),
+              schedule->profileCount());
+  selectGainProfile(gain_profile_name_);
+  return true;
+}
+
+/* Switch the profile sampled by computeOutput, an empty name selects the first one. Takes effect
+ * on the next tick, the law and gain set are not rebuilt */
+bool Plugin::selectGainProfile(const std::string &_name) {
+  if (!staged_gain_schedule_) {
+    return false;
+  }
+  const std::size_t profile = _name.empty() ? 0 : staged_gain_schedule_->findProfile(_name);
+  if (profile >= staged_gain_schedule_->profileCount()) {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "Unknown gain profile %s", _name.c_str());
+    return false;
+  }
+  const uint32_t generation = gain_schedule_generation_;
+  gain_profile_.store(static_cast<uint32_t>(profile) | generation << 16, std::memory_order_relaxed);
+  return true;
+}
+
+/* Runs on the executor with the parameter callbacks, which own the staged schedule */
+void Plugin::profileCallback(const std_msgs::msg::String::SharedPtr _msg) {
+  if (selectGainProfile(_msg->data)) {
+    RCLCPP_INFO(node_ptr_->get_logger(), "Gain profile %s", _msg->data.c_str());
+  }
+}
+
+std::shared_ptr<const Control_law_update> makeControlLawUpdate(
+    const DF_controller_config &_config) {
+  auto update = std::make_shared<Control_law_update>();
+  if (!makeControlLaw(_config, update->law)) {
+    return nullptr;
+  }
+  update->gain_set       = makeGainSet(_config.gains, _config.alpha);
+  update->reset_integral = _config.reset_integral;
+  std::visit([&update](auto &law) { law.setGains(update->gain_set); }, update->law);
+  return update;
+}
+
+/* Build an immutable update from the staged parameters. A slot is only released by this side,
+ * so computeOutput never frees an update */
+void Plugin::publishControlLaw() {
+  auto update      = std::make_shared<Control_law_update>();
+  update->gain_set = makeGainSet(staged_gains_, staged_alpha_);
+  std::visit([&update](auto &law) { law.setGains(update->gain_set); }, staged_law_);
+  update->law                      = staged_law_;
+  update->gain_schedule            = staged_gain_schedule_;
+  update->gain_schedule_generation = gain_schedule_generation_;
+  update->reset_integral           = reset_integral_.load(std::memory_order_relaxed);
+  law_buffer_.write(update);
+}
+
+void Plugin::shareControlLaw(std::shared_ptr<const Control_law_update> _update) {
+  reset_integral_ = _update->reset_integral;
+  law_buffer_.write(_update);
+  parameters_to_read_.fetch_and(~required_parameters_mask);
+  flags_.parameters_read = parameters_to_read_ == 0;
+}
+
+/* Switch to the latest published law and gains, keeping the integral of the running law. Only
+ * called from the thread running computeOutput */
+void Plugin::adoptControlLaw() {
+  if (!law_buffer_.update()) {
+    return;
+  }
+  const Control_law_update &update = *law_buffer_.read();
+  const Eigen::Vector3d integral =
+      std::visit([](const auto &law) { return law.getIntegral(); }, control_law_);
+
+  control_law_ = update.law;
+  gain_set_    = update.gain_set;
+  std::visit([&integral](auto &law) { law.setIntegral(integral); }, control_law_);
+  multi_rate_.invalidate();
+}
+
+/* Replace the gains of the running law with the scheduled ones at the current speed. The schedule
+ * is read from the adopted update, which stays alive until the next adoption */
+void Plugin::scheduleGains() {
+  const std::shared_ptr<const Control_law_update> &update = law_buffer_.read();
+  const uint32_t profile = gain_profile_.load(std::memory_order_relaxed);
+  if (!update || !update->gain_schedule || (profile >> 16) != update->gain_schedule_generation) {
+    return;
+  }
+
+  update->gain_schedule->sample(profile & 0xFFFF, control_state_.velocity.norm(), gain_set_.gains);
+  gain_set_ = makeGainSet(gain_set_.gains, gain_set_.alpha);
+  std::visit([this](auto &law) { law.setGains(gain_set_); }, control_law_);
+}
+
 void Plugin::reset() {
+  // The real-time thread owns the control state while it runs, it resets it before its next tick
+  if (realtime_thread_.running()) {
+    reset_pending_ = true;
+    return;
+  }
+  resetControlState();
+}
+
+void Plugin::resetControlState() {
   resetReferences();
   resetState();
   resetCommands();
+  multi_rate_.invalidate();
+  standby_sequence_ = 0;
+  standby_active_   = false;
 }
 
-inline void Plugin::resetState() { uav_state_ = UAV_state(); }
+inline void Plugin::resetState() {
+  uav_state_     = UAV_state();
+  control_state_ = uav_state_;
+}
 
 void Plugin::resetReferences() {
+  flatness_valid_   = false;
+  lookahead_resync_ = true;
   control_ref_.position     = uav_state_.position;
   control_ref_.velocity     = Eigen::Vector3d::Zero();
   control_ref_.acceleration = Eigen::Vector3d::Zero();
 
-  control_ref_.yaw = as2::frame::getYawFromQuaternion(uav_state_.attitude_state);
+  control_ref_.yaw = std::atan2(uav_state_.rotation(1, 0), uav_state_.rotation(0, 0));
   return;
 }
 
 void Plugin::resetCommands() {
   control_command_.PQR    = Eigen::Vector3d::Zero();
   control_command_.thrust = 0.0;
-  accum_pos_error_        = Eigen::Vector3d::Zero();
+  std::visit([](auto &law) { law.resetIntegral(); }, control_law_);
   return;
 }
 
 void Plugin::updateState(const geometry_msgs::msg::PoseStamped &pose_msg,
                          const geometry_msgs::msg::TwistStamped &twist_msg) {
-  if (pose_msg.header.frame_id != odom_frame_id_ && twist_msg.header.frame_id != odom_frame_id_) {
-    RCLCPP_ERROR(node_ptr_->get_logger(), "Pose and Twist frame_id are not desired ones");
-    RCLCPP_ERROR(node_ptr_->get_logger(), "Recived: %s, %s", pose_msg.header.frame_id.c_str(),
-                 twist_msg.header.frame_id.c_str());
-    RCLCPP_ERROR(node_ptr_->get_logger(), "Desired: %s, %s", odom_frame_id_.c_str(),
-                 odom_frame_id_.c_str());
+  // The odometry subscription is the only writer of the state then
+  if (use_odometry_) {
     return;
   }
+  if (!odom_frame_.matches(pose_msg.header.frame_id) &&
+      !odom_frame_.matches(twist_msg.header.frame_id)) {
+    rejected_pose_twist_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const Eigen::Vector3d velocity(twist_msg.twist.linear.x, twist_msg.twist.linear.y,
+                                 twist_msg.twist.linear.z);
+  storeState(pose_msg.pose, velocity, false, pose_msg.header.stamp);
+}
 
-  uav_state_.position =
-      Eigen::Vector3d(pose_msg.pose.position.x, pose_msg.pose.position.y, pose_msg.pose.position.z);
-  uav_state_.velocity =
-      Eigen::Vector3d(twist_msg.twist.linear.x, twist_msg.twist.linear.y, twist_msg.twist.linear.z);
+void Plugin::updateOdometry(const nav_msgs::msg::Odometry &_odom_msg) {
+  // The twist of an odometry message is in its child frame, usually base_link
+  const bool body_velocity = base_link_frame_.matches(_odom_msg.child_frame_id);
+  if (!odom_frame_.matches(_odom_msg.header.frame_id) ||
+      (!body_velocity && !odom_frame_.matches(_odom_msg.child_frame_id))) {
+    rejected_odometry_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const Eigen::Vector3d velocity(_odom_msg.twist.twist.linear.x, _odom_msg.twist.twist.linear.y,
+                                 _odom_msg.twist.twist.linear.z);
+  storeState(_odom_msg.pose.pose, velocity, body_velocity, _odom_msg.header.stamp);
+}
 
-  uav_state_.attitude_state =
-      tf2::Quaternion(pose_msg.pose.orientation.x, pose_msg.pose.orientation.y,
-                      pose_msg.pose.orientation.z, pose_msg.pose.orientation.w);
+/* Publish a state for computeOutput, _velocity is rotated to the odom frame if _body_velocity */
+void Plugin::storeState(const geometry_msgs::msg::Pose &_pose,
+                        const Eigen::Vector3d &_velocity,
+                        bool _body_velocity,
+                        const builtin_interfaces::msg::Time &_stamp) {
+  UAV_state &state = state_buffer_.writeBuffer();
+  state.position   = Eigen::Vector3d(_pose.position.x, _pose.position.y, _pose.position.z);
 
-  if (hover_flag_) {
-    resetReferences();
-    flags_.ref_received = true;
-    hover_flag_         = false;
+  state.attitude = Eigen::Quaterniond(_pose.orientation.w, _pose.orientation.x,
+                                      _pose.orientation.y, _pose.orientation.z)
+                       .normalized();
+  state.rotation = state.attitude.toRotationMatrix();
+  state.velocity = _body_velocity ? Eigen::Vector3d(state.rotation * _velocity) : _velocity;
+
+  const rclcpp::Time stamp(_stamp, node_ptr_->get_clock()->get_clock_type());
+  state.stamp = stamp.seconds();
+  state_buffer_.publish();
+
+  // References are reset from this state by computeOutput, the reference buffer keeps one writer
+  if (hover_flag_.exchange(false)) {
+    reset_reference_pending_ = true;
+    flags_.ref_received      = true;
   }
 
   flags_.state_received = true;
@@ -170,25 +795,76 @@ void Plugin::updateState(const geometry_msgs::msg::PoseStamped &pose_msg,
 };
 
 void Plugin::updateReference(const as2_msgs::msg::TrajectoryPoint &traj_msg) {
-  if (control_mode_in_.control_mode != as2_msgs::msg::ControlMode::TRAJECTORY) {
+  // Epoch is read before the mode, so a reference accepted under a previous mode is discarded
+  const uint32_t mode_epoch = mode_epoch_.load();
+  if ((active_mode_in_.load() & 0xFF) != as2_msgs::msg::ControlMode::TRAJECTORY) {
     return;
   }
 
-  control_ref_.position = Eigen::Vector3d(traj_msg.position.x, traj_msg.position.y,
-                                          traj_msg.position.z);
+  Reference_update &update = reference_buffer_.writeBuffer();
+  update.mode_epoch        = mode_epoch;
 
-  control_ref_.velocity = Eigen::Vector3d(traj_msg.twist.x, traj_msg.twist.y,
-                                          traj_msg.twist.z);
+  update.reference.position = Eigen::Vector3d(traj_msg.position.x, traj_msg.position.y,
+                                              traj_msg.position.z);
 
-  control_ref_.acceleration = Eigen::Vector3d(traj_msg.acceleration.x, traj_msg.acceleration.y,
-                                              traj_msg.acceleration.z);
+  update.reference.velocity = Eigen::Vector3d(traj_msg.twist.x, traj_msg.twist.y,
+                                              traj_msg.twist.z);
 
-  control_ref_.yaw = traj_msg.yaw_angle;
+  update.reference.acceleration = Eigen::Vector3d(
+      traj_msg.acceleration.x, traj_msg.acceleration.y, traj_msg.acceleration.z);
+
+  update.reference.yaw = traj_msg.yaw_angle;
+
+  if (use_reference_buffer_) {
+    const rclcpp::Time stamp(traj_msg.header.stamp, node_ptr_->get_clock()->get_clock_type());
+    update.stamp = stamp.nanoseconds() ? stamp.seconds() : node_ptr_->now().seconds();
+    if (!reference_queue_.push(update)) {
+      auto &clk = *node_ptr_->get_clock();
+      RCLCPP_WARN_THROTTLE(node_ptr_->get_logger(), clk, 5000,
+                           "Reference queue full, dropping trajectory point");
+      return;
+    }
+  } else {
+    reference_buffer_.publish();
+  }
 
   flags_.ref_received = true;
   return;
 };
 
+/* Each message carries whole records, see segment_record_size for the layout. Start times are
+ * in the node clock */
+void Plugin::segmentsCallback(const std_msgs::msg::Float64MultiArray::SharedPtr _msg) {
+  const uint32_t mode_epoch = mode_epoch_.load();
+  if (!use_trajectory_segments_ ||
+      (active_mode_in_.load() & 0xFF) != as2_msgs::msg::ControlMode::TRAJECTORY) {
+    return;
+  }
+
+  auto &clk = *node_ptr_->get_clock();
+  if (_msg->data.size() % segment_record_size != 0) {
+    RCLCPP_WARN_THROTTLE(node_ptr_->get_logger(), clk, 5000,
+                         "Trajectory segments message of size %zu is not a multiple of %zu",
+                         _msg->data.size(), segment_record_size);
+    return;
+  }
+
+  Segment_update update;
+  update.mode_epoch = mode_epoch;
+  for (std::size_t i = 0; i < _msg->data.size(); i += segment_record_size) {
+    if (!parseTrajectorySegment(_msg->data.data() + i, update.segment)) {
+      RCLCPP_WARN_THROTTLE(node_ptr_->get_logger(), clk, 5000, "Invalid trajectory segment");
+      continue;
+    }
+    if (!segment_queue_.push(update)) {
+      RCLCPP_WARN_THROTTLE(node_ptr_->get_logger(), clk, 5000,
+                           "Segment queue full, dropping trajectory segment");
+      return;
+    }
+    flags_.ref_received = true;
+  }
+}
+
 bool Plugin::setMode(const as2_msgs::msg::ControlMode &in_mode,
                      const as2_msgs::msg::ControlMode &out_mode) {
   if (!flags_.parameters_read) {
@@ -196,158 +872,570 @@ bool Plugin::setMode(const as2_msgs::msg::ControlMode &in_mode,
     return false;
   }
 
-  if (in_mode.control_mode == as2_msgs::msg::ControlMode::HOVER) {
+  const bool hover = in_mode.control_mode == as2_msgs::msg::ControlMode::HOVER;
+  if (hover) {
     control_mode_in_.control_mode    = in_mode.control_mode;
     control_mode_in_.yaw_mode        = as2_msgs::msg::ControlMode::YAW_ANGLE;
     control_mode_in_.reference_frame = as2_msgs::msg::ControlMode::LOCAL_ENU_FRAME;
-    hover_flag_                      = true;
   } else {
     control_mode_in_ = in_mode;
   }
 
+  // Flags are cleared before the new mode is visible to the callbacks
   flags_.ref_received   = false;
   flags_.state_received = false;
 
+  active_mode_in_ = static_cast<uint16_t>(control_mode_in_.control_mode |
+                                          (control_mode_in_.yaw_mode << 8));
+  mode_epoch_++;
+  hover_flag_ = hover;
+
   control_mode_out_ = out_mode;
   return true;
 };
 
+/* Take the latest state and reference published by the callbacks. Only called from the thread
+ * running computeOutput */
+void Plugin::fetchInputs(const double &_now) {
+  // A prewarm tick leaves the reset to the first armed one
+  const bool reset_reference =
+      prewarming_ ? reset_reference_pending_.load() : reset_reference_pending_.exchange(false);
+  if (state_buffer_.update()) {
+    uav_state_ = state_buffer_.read();
+  }
+
+  const uint32_t mode_epoch = mode_epoch_.load();
+  multi_rate_.setRate(outer_loop_rate_.load(std::memory_order_relaxed));
+  if (reset_reference || mode_epoch != control_mode_epoch_) {
+    // A carried integrator does not survive a new mode or a reference reset
+    control_mode_epoch_ = mode_epoch;
+    resetCommands();
+    multi_rate_.invalidate();
+  }
+
+  if (reference_buffer_.update()) {
+    const Reference_update &update = reference_buffer_.read();
+    if (!reset_reference && update.mode_epoch == mode_epoch) {
+      control_ref_ = update.reference;
+    }
+  }
+
+  Reference_update update;
+  while (reference_queue_.pop(update)) {
+    if (update.mode_epoch == mode_epoch) {
+      reference_trajectory_.push({update.stamp, update.reference});
+    }
+  }
+
+  LookaheadCache *lookahead =
+      use_lookahead_cache_.load(std::memory_order_relaxed) ? lookahead_cache_.load() : nullptr;
+  lookahead_resync_ |= lookahead == nullptr;
+
+  Segment_update segment_update;
+  while (segment_queue_.pop(segment_update)) {
+    if (segment_update.mode_epoch == mode_epoch) {
+      trajectory_segments_.push(segment_update.segment);
+      if (!lookahead_resync_) {
+        lookahead_resync_ = !lookahead->pushSegment(segment_update.segment);
+      }
+    }
+  }
+
+  flatness_valid_ = false;
+  if (reset_reference) {
+    reference_trajectory_.clear();
+    trajectory_segments_.clear();
+    resetReferences();
+  } else if (use_trajectory_segments_ && !trajectory_segments_.empty()) {
+    const double t  = _now + reference_lookahead_;
+    flatness_valid_ = lookahead != nullptr && sampleLookahead(*lookahead, t);
+    if (!flatness_valid_) {
+      trajectory_segments_.sample(t, control_ref_);
+    }
+    trajectory_segments_.discardBefore(_now);
+  } else if (use_reference_buffer_ && !reference_trajectory_.empty()) {
+    reference_trajectory_.sample(_now + reference_lookahead_, control_ref_);
+    reference_trajectory_.discardBefore(_now);
+  }
+}
+
+/* Reference terms at _t from the lookahead cache. A cache out of sync, or with other options, is
+ * restarted from the stored segments and misses until its thread caught up */
+bool Plugin::sampleLookahead(LookaheadCache &_cache, const double &_t) {
+  Lookahead_options options;
+  options.sample_period = lookahead_sample_period_.load(std::memory_order_relaxed);
+  options.horizon       = lookahead_horizon_.load(std::memory_order_relaxed);
+  if (lookahead_resync_ || options.sample_period != _cache.getOptions().sample_period ||
+      options.horizon != _cache.getOptions().horizon) {
+    lookahead_resync_ = !_cache.reset(_t, options);
+    for (std::size_t i = 0; i < trajectory_segments_.size() && !lookahead_resync_; i++) {
+      lookahead_resync_ = !_cache.pushSegment(trajectory_segments_.segment(i));
+    }
+    return false;
+  }
+  if (!_cache.sample(_t, flatness_)) {
+    return false;
+  }
+  control_ref_ = flatness_.reference;
+  return true;
+}
+
+/* Propagate uav_state_ from its stamp to _now with the last command, which is the acceleration
+ * and body rates the vehicle has been tracking since the measurement */
+void Plugin::predictState(const double &_now) {
+  control_state_ = uav_state_;
+
+  double horizon = 0.0;
+  if (use_state_prediction_ && uav_state_.stamp > 0.0) {
+    horizon = std::clamp(_now - uav_state_.stamp, 0.0, max_prediction_horizon_.load());
+  }
+  prediction_horizon_.store(horizon, std::memory_order_relaxed);
+  if (horizon <= 0.0) {
+    return;
+  }
+
+  const Eigen::Vector3d acceleration =
+      commandedAcceleration(control_command_.thrust, gain_set_.gains.mass, uav_state_.attitude);
+
+  propagateState(horizon, acceleration, control_command_.PQR, control_state_.position,
+                 control_state_.velocity, control_state_.attitude);
+  control_state_.rotation = control_state_.attitude.toRotationMatrix();
+}
+
+void Plugin::report() {
+  reportHealth();
+  publishPredictionHorizon();
+  if (report_count_++ % slow_report_divider != 0) {
+    return;
+  }
+  publishLatency();
+  reportRecorder();
+  reportStandby();
+  reportStateFrames();
+}
+
+void Plugin::useExternalReports() {
+  external_reports_ = true;
+  if (report_timer_) {
+    report_timer_->cancel();
+    report_timer_.reset();
+  }
+}
+
+void Plugin::publishPredictionHorizon() {
+  if (!use_state_prediction_) {
+    return;
+  }
+  std_msgs::msg::Float64 msg;
+  msg.data = prediction_horizon_.load(std::memory_order_relaxed);
+  prediction_horizon_pub_->publish(msg);
+}
+
+/* Log and publish the health events raised since the last call, within the rate limit of each
+ * event. Events held back by the limit are reported once it expires. Runs from report(), never on
+ * the tick */
+void Plugin::reportHealth() {
+  diagnostic_msgs::msg::DiagnosticArray msg;
+  msg.header.stamp = node_ptr_->now();
+  const double now = rclcpp::Time(msg.header.stamp).seconds();
+  Health_record record;
+  uint64_t occurrences = 0;
+  for (HealthEvents *events : {&tick_events_, &output_events_}) {
+    while (events->pop(record)) {
+      if (health_throttle_.admit(record, now, occurrences)) {
+        appendHealthStatus(record, occurrences, msg);
+      }
+    }
+  }
+  while (health_throttle_.takeDue(now, record, occurrences)) {
+    appendHealthStatus(record, occurrences, msg);
+  }
+  if (!msg.status.empty()) {
+    health_pub_->publish(msg);
+  }
+}
+
+/* Log _record and add its status to _msg */
+void Plugin::appendHealthStatus(const Health_record &_record,
+                                uint64_t _occurrences,
+                                diagnostic_msgs::msg::DiagnosticArray &_msg) {
+  static_assert(static_cast<uint8_t>(Health_level::warn) ==
+                        diagnostic_msgs::msg::DiagnosticStatus::WARN &&
+                    static_cast<uint8_t>(Health_level::error) ==
+                        diagnostic_msgs::msg::DiagnosticStatus::ERROR,
+                "Health levels must match the diagnostic levels");
+
+  const Health_event_info &info = health_event_info[static_cast<std::size_t>(_record.event)];
+  const std::string message     = describeHealthEvent(_record);
+  if (info.level == Health_level::error) {
+    RCLCPP_ERROR(node_ptr_->get_logger(), "%s (x%lu)", message.c_str(), _occurrences);
+  } else {
+    RCLCPP_WARN(node_ptr_->get_logger(), "%s (x%lu)", message.c_str(), _occurrences);
+  }
+
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.level       = static_cast<uint8_t>(info.level);
+  status.name        = std::string("controller/health/") + info.name;
+  status.hardware_id = node_ptr_->get_fully_qualified_name();
+  status.message     = message;
+  diagnostic_msgs::msg::KeyValue value;
+  value.key   = "occurrences";
+  value.value = std::to_string(_occurrences);
+  status.values.push_back(value);
+  value.key   = "total";
+  value.value = std::to_string(_record.count);
+  status.values.push_back(value);
+  _msg.status.push_back(status);
+}
+
 bool Plugin::computeOutput(double dt,
                            geometry_msgs::msg::PoseStamped &pose,
                            geometry_msgs::msg::TwistStamped &twist,
                            as2_msgs::msg::Thrust &thrust) {
-  auto &clk = *node_ptr_->get_clock();
-  if (!flags_.state_received) {
-    RCLCPP_WARN_THROTTLE(node_ptr_->get_logger(), clk, 5000, "State not received yet");
+  if (realtime_thread_.running()) {
+    if (realtime_output_.update()) {
+      realtime_command_ = realtime_output_.read();
+    }
+    if (!realtime_command_.valid) {
+      return false;
+    }
+    // A stalled real-time thread must not keep its last command alive
+    const double age = (node_ptr_->now() - realtime_command_.stamp).seconds();
+    if (age > 10.0 / realtime_options_.rate) {
+      output_events_.raise(Health_event::realtime_command_stale, static_cast<uint64_t>(age * 1e6));
+      return false;
+    }
+    return getOutput(realtime_command_.stamp, realtime_command_.command, twist, thrust);
+  }
+
+  const uint64_t tick_start = beginLatency();
+  rclcpp::Time stamp;
+  if (!computeCommand(dt, stamp)) {
     return false;
   }
 
-  if (!flags_.ref_received) {
-    RCLCPP_WARN_THROTTLE(node_ptr_->get_logger(), clk, 5000,
-                         "State changed, but ref not recived yet");
+  const bool output = getOutput(stamp, control_command_, twist, thrust);
+  recordLatency(Latency_stage::get_output);
+  recordTotalLatency(tick_start);
+  return output;
+}
+
+/* Tick of the real-time thread, the output is published for computeOutput */
+void Plugin::realtimeTick(double _dt) {
+  if (reset_pending_.exchange(false)) {
+    resetControlState();
+  }
+
+  const uint64_t tick_start = beginLatency();
+  Realtime_output &output   = realtime_output_.writeBuffer();
+  output.valid              = computeCommand(_dt, output.stamp);
+  output.command            = control_command_;
+  realtime_output_.publish();
+  recordLatency(Latency_stage::get_output);
+  recordTotalLatency(tick_start);
+}
+
+/* Everything computeOutput does before filling the messages. Runs on the thread that owns the
+ * tick state, the ROS timer or the real-time thread */
+bool Plugin::computeCommand(const double &_dt, rclcpp::Time &_stamp) {
+  // Nothing on the tick formats or logs, reportHealth does it from the events. A prewarm tick runs
+  // every stage whatever the flags
+  if (!flags_.state_received && !prewarming_) {
+    tick_events_.raise(Health_event::state_not_received);
     return false;
   }
 
-  if (!flags_.parameters_read) {
-    RCLCPP_WARN_THROTTLE(node_ptr_->get_logger(), clk, 5000, "Parameters not read yet");
-    for (auto &param : parameters_to_read_) {
-      RCLCPP_WARN(node_ptr_->get_logger(), "Parameter %s not read yet", param.c_str());
-    }
+  if (!flags_.ref_received && !prewarming_) {
+    tick_events_.raise(Health_event::reference_not_received);
     return false;
   }
 
-  resetCommands();
+  if (!flags_.parameters_read && !prewarming_) {
+    tick_events_.raise(Health_event::parameters_missing, parameters_to_read_.load());
+    return false;
+  }
+  recordLatency(Latency_stage::flag_checks);
+
+  adoptControlLaw();
+
+  // Single clock read per tick, shared by the inputs and the output stamps
+  _stamp             = node_ptr_->now();
+  const double now   = _stamp.seconds();
+  const bool standby = followPrimary(now);
+  fetchInputs(now);
+  predictState(now);
+  scheduleGains();
+  if (reset_integral_.load(std::memory_order_relaxed)) {
+    resetCommands();
+  }
+  recordLatency(Latency_stage::inputs);
 
-  switch (control_mode_in_.yaw_mode) {
+  const uint16_t mode_in = prewarming_ ? prewarm_mode : active_mode_in_.load();
+  switch (mode_in >> 8) {
     case as2_msgs::msg::ControlMode::YAW_ANGLE: {
       break;
     }
     default:
-      auto &clk = *node_ptr_->get_clock();
-      RCLCPP_ERROR_THROTTLE(node_ptr_->get_logger(), clk, 5000, "Unknown yaw mode");
+      tick_events_.raise(Health_event::unknown_yaw_mode, mode_in >> 8);
       return false;
       break;
   }
 
-  switch (control_mode_in_.control_mode) {
+  switch (mode_in & 0xFF) {
     case as2_msgs::msg::ControlMode::HOVER:
     case as2_msgs::msg::ControlMode::TRAJECTORY:
-      control_command_ = computeTrajectoryControl(dt, uav_state_.position, uav_state_.velocity,
-                                                  uav_state_.attitude_state, control_ref_.position,
-                                                  control_ref_.velocity, control_ref_.acceleration,
-                                                  control_ref_.yaw);
+      control_command_ = computeTrajectoryControl(
+          _dt, control_state_.position, control_state_.velocity, control_state_.rotation,
+          control_ref_.position, control_ref_.velocity, control_ref_.acceleration,
+          control_ref_.yaw);
       break;
     default:
-      auto &clk = *node_ptr_->get_clock();
-      RCLCPP_ERROR_THROTTLE(node_ptr_->get_logger(), clk, 5000, "Unknown control mode");
+      tick_events_.raise(Health_event::unknown_control_mode, mode_in & 0xFF);
       return false;
       break;
   }
-
-  return getOutput(twist, thrust);
+  control_stamp_ = now;
+  recordFlight(_dt, now);
+  if (standby || prewarming_) {
+    // Computed to keep the tick warm, the primary's command is the one flying. The mailbox and
+    // the snapshot channel touch their pages when they are opened
+    return false;
+  }
+  if (snapshot_writer_.isOpen()) {
+    // An integral cleared on every tick is not handed over
+    Controller_snapshot snapshot = takeSnapshot();
+    if (reset_integral_.load(std::memory_order_relaxed)) {
+      snapshot.integral.setZero();
+    }
+    snapshot_writer_.publish(snapshot);
+  }
+  command_mailbox_.write(control_command_, _stamp.nanoseconds());
+  return true;
 }
 
-Eigen::Vector3d Plugin::getForce(const double &_dt,
-                                 const Eigen::Vector3d &_pos_state,
-                                 const Eigen::Vector3d &_vel_state,
-                                 const Eigen::Vector3d &_pos_reference,
-                                 const Eigen::Vector3d &_vel_reference,
-                                 const Eigen::Vector3d &_acc_reference) {
-  // Compute the error force contribution
-
-  const Eigen::Vector3d position_error = _pos_reference - _pos_state;
-  const Eigen::Vector3d velocity_error = _vel_reference - _vel_state;
+void Plugin::prewarm(std::size_t _iterations) {
+  // Scratch copy of what the ticks accumulate, the rest is recomputed from the inputs every tick
+  const Eigen::Vector3d integral =
+      std::visit([](const auto &law) { return law.getIntegral(); }, control_law_);
+  const UAV_state state           = control_state_;
+  const Acro_command command      = control_command_;
+  const double stamp              = control_stamp_;
+  const uint32_t mode_epoch       = control_mode_epoch_;
+  const uint64_t standby_sequence = standby_sequence_;
+  const double standby_last       = standby_last_snapshot_;
+  const bool standby_active       = standby_active_;
+  const double prediction_horizon = prediction_horizon_.load(std::memory_order_relaxed);
+  measuring_latency_              = false;
+  measuring_perf_                 = false;
+  prewarming_                     = true;
 
-  // TODO: check if apply _dt to each constant or apply it to the whole vector each iteration
-  accum_pos_error_ += position_error * _dt;
-
-  for (uint8_t j = 0; j < 3; j++) {
-    double antiwindup_value = antiwindup_cte_ / Ki_.diagonal()[j];
-    accum_pos_error_[j]     = std::clamp(accum_pos_error_[j], -antiwindup_value, antiwindup_value);
+  rclcpp::Time output_stamp;
+  geometry_msgs::msg::TwistStamped twist;
+  as2_msgs::msg::Thrust thrust;
+  for (std::size_t i = 0; i < _iterations; i++) {
+    computeCommand(0.01, output_stamp);
+    getOutput(output_stamp, control_command_, twist, thrust);
   }
 
-  const Eigen::Vector3d desired_force = Kp_ * position_error + Kd_ * velocity_error +
-                                        Ki_ * accum_pos_error_ - mass_ * gravitational_accel_ +
-                                        mass_ * _acc_reference;
-
-  return std::move(desired_force);  // use std::move to avoid copy (force RVO)
+  prewarming_            = false;
+  control_state_         = state;
+  control_command_       = command;
+  control_stamp_         = stamp;
+  control_mode_epoch_    = mode_epoch;
+  standby_sequence_      = standby_sequence;
+  standby_last_snapshot_ = standby_last;
+  standby_active_        = standby_active;
+  std::visit([&integral](auto &law) { law.setIntegral(integral); }, control_law_);
+  // The position loop output held by the prewarm ticks was computed from the scratch integral
+  multi_rate_.invalidate();
+  prediction_horizon_.store(prediction_horizon, std::memory_order_relaxed);
 }
 
 Acro_command Plugin::computeTrajectoryControl(const double &_dt,
                                               const Eigen::Vector3d &_pos_state,
                                               const Eigen::Vector3d &_vel_state,
-                                              const tf2::Quaternion &_attitude_state,
+                                              const Eigen::Matrix3d &_rot_matrix,
                                               const Eigen::Vector3d &_pos_reference,
                                               const Eigen::Vector3d &_vel_reference,
                                               const Eigen::Vector3d &_acc_reference,
                                               const double &_yaw_angle_reference) {
-  Eigen::Vector3d desired_force =
-      getForce(_dt, _pos_state, _vel_state, _pos_reference, _vel_reference, _acc_reference);
+  // Same steps as computeMultiRateControl, split to time each stage. Between position loop runs
+  // the get_force stage is empty and the attitude stage is the attitude control only
+  return std::visit(
+      [&](auto &law) {
+        double outer_dt = _dt;
+        if (!multi_rate_.outerLoopDue(_dt, outer_dt)) {
+          recordLatency(Latency_stage::get_force);
+        } else if (flatness_valid_) {
+          // Reference terms from the lookahead cache, only the feedback is computed here
+          const Eigen::Vector3d desired_force =
+              law.getForceFeedforward(outer_dt, _pos_state, _vel_state, _pos_reference,
+                                      _vel_reference, flatness_.specific_force);
+          recordLatency(Latency_stage::get_force);
+          multi_rate_.storeOuterLoop(desired_force, law.computeDesiredAttitudeFromHeading(
+                                                        desired_force, flatness_.heading));
+        } else {
+          const Eigen::Vector3d desired_force = law.getForce(
+              outer_dt, _pos_state, _vel_state, _pos_reference, _vel_reference, _acc_reference);
+          recordLatency(Latency_stage::get_force);
+          multi_rate_.storeOuterLoop(
+              desired_force, law.computeDesiredAttitude(desired_force, _yaw_angle_reference));
+        }
+
+        const Acro_command command = law.computeAttitudeControl(
+            multi_rate_.getDesiredForce(), multi_rate_.getDesiredAttitude(), _rot_matrix);
+        recordLatency(Latency_stage::attitude);
+        return command;
+      },
+      control_law_);
+}
+
+/* Start of a tick, returns its start time for recordTotalLatency */
+inline uint64_t Plugin::beginLatency() {
+  measuring_latency_ = measure_latency_.load(std::memory_order_relaxed);
+  if (measuring_latency_) {
+    latency_stage_start_ = latencyClockNs();
+  }
+  measuring_perf_ = updatePerfCounters() && perf_group_.read(perf_stage_start_);
+  perf_tick_start_ = perf_stage_start_;
+  return latency_stage_start_;
+}
+
+inline void Plugin::recordTotalLatency(uint64_t _tick_start) {
+  constexpr std::size_t total = static_cast<std::size_t>(Latency_stage::total);
+  if (measuring_latency_) {
+    latency_histograms_[total].record(latency_stage_start_ - _tick_start);
+  }
+  if (measuring_perf_) {
+    perf_counters_[total].record(perf_tick_start_, perf_stage_start_);
+  }
+}
+
+/* Close the current stage of the tick, no-op unless latency or counter measurement is enabled */
+inline void Plugin::recordLatency(Latency_stage _stage) {
+  if (measuring_latency_) {
+    const uint64_t now = latencyClockNs();
+    latency_histograms_[static_cast<std::size_t>(_stage)].record(now - latency_stage_start_);
+    latency_stage_start_ = now;
+  }
+  if (measuring_perf_ && perf_group_.read(perf_now_)) {
+    perf_counters_[static_cast<std::size_t>(_stage)].record(perf_stage_start_, perf_now_);
+    perf_stage_start_ = perf_now_;
+  }
+}
 
-  // Compute the desired attitude
-  const tf2::Matrix3x3 rot_matrix_tf2(_attitude_state);
+/* Open the counters for the thread running the tick, or close them once disabled. A thread that
+ * can not open them disables the measurement, so the open is not retried every tick */
+bool Plugin::updatePerfCounters() {
+  if (!measure_perf_.load(std::memory_order_relaxed)) {
+    if (perf_group_.isOpen()) {
+      perf_group_.close();
+    }
+    return false;
+  }
+  if (perf_group_.isOpen() && perf_thread_ == std::this_thread::get_id()) {
+    return true;
+  }
+
+  const int error = perf_group_.open();
+  if (error != 0) {
+    measure_perf_ = false;
+    tick_events_.raise(Health_event::perf_counters_disabled, static_cast<uint64_t>(error));
+    return false;
+  }
+  perf_thread_         = std::this_thread::get_id();
+  uint64_t unavailable = 0;
+  for (std::size_t i = 0; i < perf_event_count; i++) {
+    if (!perf_group_.isAvailable(static_cast<Perf_event>(i))) {
+      unavailable |= uint64_t(1) << i;
+    }
+  }
+  if (unavailable) {
+    tick_events_.raise(Health_event::perf_counter_unavailable, unavailable);
+  }
+  return true;
+}
 
-  Eigen::Matrix3d rot_matrix;
-  rot_matrix << rot_matrix_tf2[0][0], rot_matrix_tf2[0][1], rot_matrix_tf2[0][2],
-      rot_matrix_tf2[1][0], rot_matrix_tf2[1][1], rot_matrix_tf2[1][2], rot_matrix_tf2[2][0],
-      rot_matrix_tf2[2][1], rot_matrix_tf2[2][2];
+/* Per tick means of every counter and stage since the counters were enabled */
+void Plugin::dumpPerfCounters(const std::shared_ptr<std_srvs::srv::Trigger::Request> /*_request*/,
+                              std::shared_ptr<std_srvs::srv::Trigger::Response> _response) {
+  PerfStageCounters::Snapshot snapshot;
+  char line[160];
+  std::snprintf(line, sizeof(line), "%-12s %10s %12s %12s %6s %12s %13s\n", "stage", "samples",
+                "cycles", "instructions", "ipc", "cache_misses", "branch_misses");
+  std::string table = line;
+  for (std::size_t i = 0; i < latency_stage_count; i++) {
+    perf_counters_[i].snapshot(snapshot);
+    std::snprintf(line, sizeof(line), "%-12s %10lu %12.1f %12.1f %6.2f %12.2f %13.2f\n",
+                  latency_stage_names[i], snapshot.samples, snapshot.mean(Perf_event::cycles),
+                  snapshot.mean(Perf_event::instructions), snapshot.ipc(),
+                  snapshot.mean(Perf_event::cache_misses),
+                  snapshot.mean(Perf_event::branch_misses));
+    table += line;
+    _response->success |= snapshot.samples > 0;
+  }
+  _response->message = table;
+  RCLCPP_INFO(node_ptr_->get_logger(), "Hardware counters per tick:\n%s", table.c_str());
+}
 
-  const Eigen::Vector3d xc_des(cos(_yaw_angle_reference), sin(_yaw_angle_reference), 0);
-  const Eigen::Vector3d zb_des = desired_force.normalized();
-  const Eigen::Vector3d yb_des = zb_des.cross(xc_des).normalized();
-  const Eigen::Vector3d xb_des = yb_des.cross(zb_des).normalized();
+/* p50, p99 and max of every stage over the last period. Runs from report(), never on the tick */
+void Plugin::publishLatency() {
+  if (!measure_latency_) {
+    return;
+  }
 
-  // Compute the rotation matrix desidered
-  Eigen::Matrix3d R_des;
-  R_des.col(0) = xb_des;
-  R_des.col(1) = yb_des;
-  R_des.col(2) = zb_des;
+  diagnostic_msgs::msg::DiagnosticArray msg;
+  msg.header.stamp = node_ptr_->now();
+  for (std::size_t i = 0; i < latency_stage_count; i++) {
+    latency_histograms_[i].snapshot(latency_current_);
+    LatencyHistogram::difference(latency_current_, latency_published_[i], latency_interval_);
+    latency_published_[i] = latency_current_;
 
-  // Compute the rotation matrix error
-  const Eigen::Matrix3d Mat_e_rot =
-      (R_des.transpose() * rot_matrix - rot_matrix.transpose() * R_des);
+    const double p50_us = latency_interval_.percentile(0.5) * 1e-3;
+    const double p99_us = latency_interval_.percentile(0.99) * 1e-3;
+    const double max_us = latency_interval_.maxBucket() * 1e-3;
 
-  const Eigen::Vector3d V_e_rot(Mat_e_rot(2, 1), Mat_e_rot(0, 2), Mat_e_rot(1, 0));
-  const Eigen::Vector3d E_rot = (1.0f / 2.0f) * V_e_rot;
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.level       = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.name        = std::string("controller/latency/") + latency_stage_names[i];
+    status.hardware_id = node_ptr_->get_fully_qualified_name();
 
-  Acro_command acro_command;
-  acro_command.thrust = (float)desired_force.dot(rot_matrix.col(2).normalized());
-  acro_command.PQR    = -Kp_ang_mat_ * E_rot;
+    status.message = "p50 " + std::to_string(p50_us) + " us, p99 " + std::to_string(p99_us) + " us";
 
-  return std::move(acro_command);  // use std::move to avoid copy (force RVO)
+    auto add_value = [&status](const std::string &_key, const std::string &_value) {
+      diagnostic_msgs::msg::KeyValue value;
+      value.key   = _key;
+      value.value = _value;
+      status.values.push_back(value);
+    };
+    add_value("samples", std::to_string(latency_interval_.count));
+    add_value("p50_us", std::to_string(p50_us));
+    add_value("p99_us", std::to_string(p99_us));
+    add_value("max_us", std::to_string(max_us));
+    add_value("max_since_start_us", std::to_string(latency_interval_.max_ns * 1e-3));
+    msg.status.push_back(status);
+  }
+  latency_pub_->publish(msg);
 }
 
-bool Plugin::getOutput(geometry_msgs::msg::TwistStamped &twist_msg,
+bool Plugin::getOutput(const rclcpp::Time &_stamp,
+                       const Acro_command &_command,
+                       geometry_msgs::msg::TwistStamped &twist_msg,
                        as2_msgs::msg::Thrust &thrust_msg) {
-  twist_msg.header.stamp    = node_ptr_->now();
-  twist_msg.header.frame_id = base_link_frame_id_;
-  twist_msg.twist.angular.x = control_command_.PQR.x();
-  twist_msg.twist.angular.y = control_command_.PQR.y();
-  twist_msg.twist.angular.z = control_command_.PQR.z();
-
-  thrust_msg.header.stamp    = node_ptr_->now();
-  thrust_msg.header.frame_id = base_link_frame_id_;
-  thrust_msg.thrust          = control_command_.thrust;
+  // The output messages outlive the tick, so the frame ids are only copied the first time
+  if (twist_msg.header.frame_id != base_link_frame_id_) {
+    twist_msg.header.frame_id = base_link_frame_id_;
+  }
+  twist_msg.header.stamp    = _stamp;
+  twist_msg.twist.angular.x = _command.PQR.x();
+  twist_msg.twist.angular.y = _command.PQR.y();
+  twist_msg.twist.angular.z = _command.PQR.z();
+
+  if (thrust_msg.header.frame_id != base_link_frame_id_) {
+    thrust_msg.header.frame_id = base_link_frame_id_;
+  }
+  thrust_msg.header.stamp = _stamp;
+  thrust_msg.thrust       = _command.thrust;
   return true;
 };
 
@@ -0,0 +1,168 @@
+/*!*******************************************************************************************
+ *  \file       closed_loop_simulation.cpp
+ *  \brief      Closed loop simulation of the control law with a quadrotor plant.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "closed_loop_simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "multi_rate_control.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+bool parseReferenceTrajectory(const std::string &_name, Reference_trajectory &_trajectory) {
+  if (_name == "step") {
+    _trajectory = Reference_trajectory::step;
+  } else if (_name == "circle") {
+    _trajectory = Reference_trajectory::circle;
+  } else if (_name == "lemniscate") {
+    _trajectory = Reference_trajectory::lemniscate;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void sampleReferenceTrajectory(Reference_trajectory _trajectory,
+                               const double &_t,
+                               UAV_reference &_reference) {
+  _reference = UAV_reference();
+  switch (_trajectory) {
+    case Reference_trajectory::step: {
+      const bool stepped  = _t >= 1.0;
+      _reference.position = stepped ? Eigen::Vector3d(1.0, 1.0, 1.5) : Eigen::Vector3d(0, 0, 1.0);
+      _reference.yaw      = stepped ? 0.5 : 0.0;
+      break;
+    }
+    case Reference_trajectory::circle: {
+      const double radius = 2.0;
+      const double w      = 1.0;
+      const double c      = std::cos(w * _t);
+      const double s      = std::sin(w * _t);
+
+      _reference.position     = Eigen::Vector3d(radius * c, radius * s, 1.5);
+      _reference.velocity     = Eigen::Vector3d(-radius * w * s, radius * w * c, 0.0);
+      _reference.acceleration = Eigen::Vector3d(-radius * w * w * c, -radius * w * w * s, 0.0);
+      break;
+    }
+    case Reference_trajectory::lemniscate: {
+      // x = a sin(wt), y = a/2 sin(2wt)
+      const double a  = 2.0;
+      const double w  = 0.8;
+      const double s1 = std::sin(w * _t);
+      const double c1 = std::cos(w * _t);
+      const double s2 = std::sin(2.0 * w * _t);
+      const double c2 = std::cos(2.0 * w * _t);
+
+      _reference.position     = Eigen::Vector3d(a * s1, 0.5 * a * s2, 1.5);
+      _reference.velocity     = Eigen::Vector3d(a * w * c1, a * w * c2, 0.0);
+      _reference.acceleration = Eigen::Vector3d(-a * w * w * s1, -2.0 * a * w * w * s2, 0.0);
+      break;
+    }
+  }
+}
+
+template <typename Law>
+static Tracking_metrics simulate(Law &_law, const Simulation_options &_options) {
+  Plant_params plant_params = _options.plant;
+  plant_params.mass         = _law.getGains().mass * _options.mass_scale;
+  QuadrotorPlant plant(plant_params);
+
+  UAV_reference reference;
+  sampleReferenceTrajectory(_options.trajectory, 0.0, reference);
+  plant.resetHover(reference.position, reference.yaw);
+  Plant_state initial_state = plant.getState();
+  initial_state.velocity    = reference.velocity;
+  plant.setState(initial_state);
+
+  MultiRateControl multi_rate;
+  multi_rate.setRate(_options.outer_loop_rate);
+
+  Tracking_metrics metrics;
+  double sum_sq_position_error = 0.0;
+  double sum_sq_velocity_error = 0.0;
+  double sum_sq_yaw_error      = 0.0;
+
+  const uint64_t ticks =
+      static_cast<uint64_t>(std::llround(_options.duration / _options.control_dt));
+  const double substep_dt = _options.control_dt / _options.plant_substeps;
+  for (uint64_t tick = 0; tick < ticks; tick++) {
+    sampleReferenceTrajectory(_options.trajectory, tick * _options.control_dt, reference);
+    const Plant_state &state = plant.getState();
+
+    const Eigen::Matrix3d rot_matrix = state.attitude.toRotationMatrix();
+    const double position_error      = (reference.position - state.position).norm();
+    const double velocity_error      = (reference.velocity - state.velocity).norm();
+    const double yaw                 = std::atan2(rot_matrix(1, 0), rot_matrix(0, 0));
+    const double yaw_error           = std::remainder(reference.yaw - yaw, 2.0 * M_PI);
+    const double tilt                = std::acos(std::clamp(rot_matrix(2, 2), -1.0, 1.0));
+    sum_sq_position_error += position_error * position_error;
+    sum_sq_velocity_error += velocity_error * velocity_error;
+    sum_sq_yaw_error += yaw_error * yaw_error;
+    metrics.max_position_error = std::max(metrics.max_position_error, position_error);
+    metrics.max_tilt           = std::max(metrics.max_tilt, tilt);
+    metrics.ticks++;
+
+    if (!std::isfinite(position_error) || position_error > 100.0) {
+      metrics.diverged = true;
+      break;
+    }
+
+    if (_options.reset_integral_each_tick) {
+      _law.resetIntegral();
+    }
+    const Acro_command command = computeMultiRateControl(
+        _law, multi_rate, _options.control_dt, state.position, state.velocity, rot_matrix,
+        reference.position, reference.velocity, reference.acceleration, reference.yaw);
+    for (int i = 0; i < _options.plant_substeps; i++) {
+      plant.step(command, substep_dt);
+    }
+  }
+
+  if (metrics.ticks) {
+    metrics.rms_position_error = std::sqrt(sum_sq_position_error / metrics.ticks);
+    metrics.rms_velocity_error = std::sqrt(sum_sq_velocity_error / metrics.ticks);
+    metrics.rms_yaw_error      = std::sqrt(sum_sq_yaw_error / metrics.ticks);
+  }
+  return metrics;
+}
+
+Tracking_metrics simulateClosedLoop(DFControlLawVariant &_law, const Simulation_options &_options) {
+  return std::visit([&_options](auto &law) { return simulate(law, _options); }, _law);
+}
+
+};  // namespace controller_plugin_differential_flatness
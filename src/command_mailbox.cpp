@@ -0,0 +1,81 @@
+/*!*******************************************************************************************
+ *  \file       command_mailbox.cpp
+ *  \brief      Lock-free shared memory mailbox with the last command, for a co-located bridge.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "command_mailbox.hpp"
+
+#include <array>
+
+namespace controller_plugin_differential_flatness {
+
+// "DFCMD\0\0\0" read as a little endian uint64
+static constexpr uint64_t command_mailbox_magic   = 0x000000444d434644ull;
+static constexpr uint32_t command_mailbox_version = 1;
+
+bool CommandMailboxWriter::open(const std::string &_name, std::string &_error) {
+  return slot_.open(_name, command_mailbox_magic, command_mailbox_version, _error);
+}
+
+bool CommandMailboxWriter::write(const Acro_command &_command, int64_t _stamp_ns) {
+  std::array<uint64_t, command_mailbox_words> words;
+  words[0] = static_cast<uint64_t>(_stamp_ns);
+  words[1] = doubleBits(_command.thrust);
+  for (int i = 0; i < 3; i++) {
+    words[2 + i] = doubleBits(_command.PQR[i]);
+  }
+  return slot_.write(words);
+}
+
+bool CommandMailboxReader::open(const std::string &_name, std::string &_error) {
+  return slot_.open(_name, command_mailbox_magic, command_mailbox_version, _error);
+}
+
+bool CommandMailboxReader::read(Mailbox_command &_command, int _max_retries) const {
+  std::array<uint64_t, command_mailbox_words> words;
+  uint64_t sequence = 0;
+  if (!slot_.read(words, sequence, _max_retries)) {
+    return false;
+  }
+  _command.sequence       = sequence;
+  _command.stamp_ns       = static_cast<int64_t>(words[0]);
+  _command.command.thrust = bitsDouble(words[1]);
+  for (int i = 0; i < 3; i++) {
+    _command.command.PQR[i] = bitsDouble(words[2 + i]);
+  }
+  return true;
+}
+
+};  // namespace controller_plugin_differential_flatness
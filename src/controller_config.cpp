@@ -0,0 +1,216 @@
+/*!*******************************************************************************************
+ *  \file       controller_config.cpp
+ *  \brief      Plugin parameters applied without ROS, for the offline tools.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "controller_config.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <yaml-cpp/yaml.h>
+
+namespace controller_plugin_differential_flatness {
+
+bool setGainParameter(DF_parameter _parameter, const double &_value, DF_gains &_gains) {
+  switch (_parameter) {
+    case DF_parameter::mass:
+      _gains.mass = _value;
+      break;
+    case DF_parameter::antiwindup_cte:
+      _gains.antiwindup_cte = _value;
+      break;
+    case DF_parameter::kp_x:
+      _gains.Kp(0, 0) = _value;
+      break;
+    case DF_parameter::kp_y:
+      _gains.Kp(1, 1) = _value;
+      break;
+    case DF_parameter::kp_z:
+      _gains.Kp(2, 2) = _value;
+      break;
+    case DF_parameter::ki_x:
+      _gains.Ki(0, 0) = _value;
+      break;
+    case DF_parameter::ki_y:
+      _gains.Ki(1, 1) = _value;
+      break;
+    case DF_parameter::ki_z:
+      _gains.Ki(2, 2) = _value;
+      break;
+    case DF_parameter::kd_x:
+      _gains.Kd(0, 0) = _value;
+      break;
+    case DF_parameter::kd_y:
+      _gains.Kd(1, 1) = _value;
+      break;
+    case DF_parameter::kd_z:
+      _gains.Kd(2, 2) = _value;
+      break;
+    case DF_parameter::roll_kp:
+      _gains.Kp_ang(0, 0) = _value;
+      break;
+    case DF_parameter::pitch_kp:
+      _gains.Kp_ang(1, 1) = _value;
+      break;
+    case DF_parameter::yaw_kp:
+      _gains.Kp_ang(2, 2) = _value;
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+bool setConfigParameter(std::string_view _name,
+                        const std::string &_value,
+                        DF_controller_config &_config,
+                        uint32_t &_parameters_to_read) {
+  const DF_parameter parameter = findParameter(_name);
+  switch (parameter) {
+    case DF_parameter::unknown:
+      return false;
+    case DF_parameter::law_scalar_type:
+      _config.scalar_type = _value;
+      return true;
+    case DF_parameter::law_gain_structure:
+      _config.gain_structure = _value;
+      return true;
+    case DF_parameter::law_antiwindup:
+      _config.antiwindup = _value;
+      return true;
+    case DF_parameter::reset_integral:
+      if (_value != "true" && _value != "false") {
+        return false;
+      }
+      _config.reset_integral = _value == "true";
+      return true;
+    default:
+      break;
+  }
+  if (static_cast<std::size_t>(parameter) >= required_parameter_count) {
+    // Plugin only, e.g. reference_buffer.* or latency.*
+    return true;
+  }
+
+  char *end          = nullptr;
+  const double value = std::strtod(_value.c_str(), &end);
+  if (end == _value.c_str()) {
+    return false;
+  }
+  if (parameter == DF_parameter::alpha) {
+    _config.alpha = value;
+  } else {
+    setGainParameter(parameter, value, _config.gains);
+  }
+  _parameters_to_read &= ~parameterBit(parameter);
+  return true;
+}
+
+/* Set every value under _node, named by the keys leading to it joined with '.' */
+static bool readParameters(const YAML::Node &_node,
+                           const std::string &_name,
+                           DF_controller_config &_config,
+                           uint32_t &_parameters_to_read,
+                           std::string &_error) {
+  if (!_node.IsMap()) {
+    if (!_node.IsScalar() ||
+        !setConfigParameter(_name, _node.Scalar(), _config, _parameters_to_read)) {
+      _error = "bad parameter " + _name;
+      return false;
+    }
+    return true;
+  }
+  for (const auto &entry : _node) {
+    const std::string key = entry.first.as<std::string>();
+    if (!readParameters(entry.second, _name.empty() ? key : _name + "." + key, _config,
+                        _parameters_to_read, _error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool loadControllerConfig(const std::string &_path,
+                          DF_controller_config &_config,
+                          std::string &_error) {
+  std::ifstream file(_path);
+  if (!file) {
+    _error = "can not open " + _path;
+    return false;
+  }
+  std::stringstream yaml;
+  yaml << file.rdbuf();
+
+  uint32_t parameters_to_read = required_parameters_mask;
+  try {
+    const YAML::Node root = YAML::Load(yaml.str());
+    bool found            = false;
+    for (const auto &node : root) {
+      if (!node.second.IsMap() || !node.second["ros__parameters"]) {
+        continue;
+      }
+      found = true;
+      if (!readParameters(node.second["ros__parameters"], "", _config, parameters_to_read,
+                          _error)) {
+        return false;
+      }
+    }
+    if (!found) {
+      _error = "no ros__parameters in " + _path;
+      return false;
+    }
+  } catch (const YAML::Exception &e) {
+    _error = e.what();
+    return false;
+  }
+
+  for (std::size_t i = 0; i < required_parameter_count; i++) {
+    if (parameters_to_read & parameterBit(static_cast<DF_parameter>(i))) {
+      _error = "parameter " + std::string(parameter_names[i]) + " missing";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool makeControlLaw(const DF_controller_config &_config, DFControlLawVariant &_law) {
+  _law = DFControlLaw(_config.gains);
+  return selectDFControlLaw(_config.scalar_type, _config.gain_structure, _config.antiwindup,
+                            _law);
+}
+
+};  // namespace controller_plugin_differential_flatness
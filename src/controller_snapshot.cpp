@@ -0,0 +1,109 @@
+/*!*******************************************************************************************
+ *  \file       controller_snapshot.cpp
+ *  \brief      Versioned snapshot of the controller state and its shared memory channel.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "controller_snapshot.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+// "DFSNAP\0\0" read as a little endian uint64
+static constexpr uint64_t snapshot_channel_magic = 0x0000504153464444ull;
+
+void packSnapshot(const Controller_snapshot &_snapshot, Snapshot_words &_words) {
+  std::size_t i          = 0;
+  const auto pack_vector = [&](const Eigen::Vector3d &_vector) {
+    for (int j = 0; j < 3; j++) {
+      _words[i++] = doubleBits(_vector[j]);
+    }
+  };
+  _words[i++] = static_cast<uint64_t>(controller_snapshot_version) << 32 |
+                static_cast<uint64_t>(controller_snapshot_words);
+  _words[i++] = doubleBits(_snapshot.stamp);
+  _words[i++] = _snapshot.mode;
+  pack_vector(_snapshot.integral);
+  pack_vector(_snapshot.reference.position);
+  pack_vector(_snapshot.reference.velocity);
+  pack_vector(_snapshot.reference.acceleration);
+  _words[i++] = doubleBits(_snapshot.reference.yaw);
+  pack_vector(_snapshot.command.PQR);
+  _words[i++] = doubleBits(_snapshot.command.thrust);
+}
+
+bool unpackSnapshot(const Snapshot_words &_words, Controller_snapshot &_snapshot) {
+  if (_words[0] != (static_cast<uint64_t>(controller_snapshot_version) << 32 |
+                    static_cast<uint64_t>(controller_snapshot_words))) {
+    return false;
+  }
+  std::size_t i            = 1;
+  const auto unpack_vector = [&](Eigen::Vector3d &_vector) {
+    for (int j = 0; j < 3; j++) {
+      _vector[j] = bitsDouble(_words[i++]);
+    }
+  };
+  _snapshot.stamp = bitsDouble(_words[i++]);
+  _snapshot.mode  = static_cast<uint16_t>(_words[i++]);
+  unpack_vector(_snapshot.integral);
+  unpack_vector(_snapshot.reference.position);
+  unpack_vector(_snapshot.reference.velocity);
+  unpack_vector(_snapshot.reference.acceleration);
+  _snapshot.reference.yaw = bitsDouble(_words[i++]);
+  unpack_vector(_snapshot.command.PQR);
+  _snapshot.command.thrust = bitsDouble(_words[i++]);
+  return true;
+}
+
+bool SnapshotChannelWriter::open(const std::string &_name, std::string &_error) {
+  return slot_.open(_name, snapshot_channel_magic, controller_snapshot_version, _error);
+}
+
+bool SnapshotChannelWriter::publish(const Controller_snapshot &_snapshot) {
+  Snapshot_words words;
+  packSnapshot(_snapshot, words);
+  return slot_.write(words);
+}
+
+bool SnapshotChannelReader::open(const std::string &_name, std::string &_error) {
+  return slot_.open(_name, snapshot_channel_magic, controller_snapshot_version, _error);
+}
+
+bool SnapshotChannelReader::read(Controller_snapshot &_snapshot,
+                                 uint64_t &_sequence,
+                                 int _max_retries) {
+  Snapshot_words words;
+  return slot_.read(words, _sequence, _max_retries) && unpackSnapshot(words, _snapshot);
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,231 @@
+/*!*******************************************************************************************
+ *  \file       flight_log.cpp
+ *  \brief      Recorded flights for offline replay of the control law.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "flight_log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace controller_plugin_differential_flatness {
+
+static constexpr char flight_log_magic[8] = {'D', 'F', 'L', 'O', 'G', 0, 0, 0};
+static constexpr uint32_t flight_log_version = 1;
+
+static constexpr const char *flight_log_csv_header =
+    "dt,x,y,z,vx,vy,vz,qw,qx,qy,qz,ref_x,ref_y,ref_z,ref_vx,ref_vy,ref_vz,ref_ax,ref_ay,ref_az,"
+    "ref_yaw,p,q,r,thrust";
+
+using Flight_fields = std::array<double, flight_sample_fields>;
+
+static void toFields(const Flight_sample &_sample, Flight_fields &_fields) {
+  const UAV_reference &ref = _sample.reference;
+  _fields = {_sample.dt,
+             _sample.position.x(),
+             _sample.position.y(),
+             _sample.position.z(),
+             _sample.velocity.x(),
+             _sample.velocity.y(),
+             _sample.velocity.z(),
+             _sample.attitude.w(),
+             _sample.attitude.x(),
+             _sample.attitude.y(),
+             _sample.attitude.z(),
+             ref.position.x(),
+             ref.position.y(),
+             ref.position.z(),
+             ref.velocity.x(),
+             ref.velocity.y(),
+             ref.velocity.z(),
+             ref.acceleration.x(),
+             ref.acceleration.y(),
+             ref.acceleration.z(),
+             ref.yaw,
+             _sample.command.PQR.x(),
+             _sample.command.PQR.y(),
+             _sample.command.PQR.z(),
+             _sample.command.thrust};
+}
+
+static void fromFields(const Flight_fields &_fields, Flight_sample &_sample) {
+  _sample.dt                     = _fields[0];
+  _sample.position               = Eigen::Vector3d(_fields[1], _fields[2], _fields[3]);
+  _sample.velocity               = Eigen::Vector3d(_fields[4], _fields[5], _fields[6]);
+  _sample.attitude               = Eigen::Quaterniond(_fields[7], _fields[8], _fields[9],
+                                                      _fields[10]);
+  _sample.reference.position     = Eigen::Vector3d(_fields[11], _fields[12], _fields[13]);
+  _sample.reference.velocity     = Eigen::Vector3d(_fields[14], _fields[15], _fields[16]);
+  _sample.reference.acceleration = Eigen::Vector3d(_fields[17], _fields[18], _fields[19]);
+  _sample.reference.yaw          = _fields[20];
+  _sample.command.PQR            = Eigen::Vector3d(_fields[21], _fields[22], _fields[23]);
+  _sample.command.thrust         = _fields[24];
+}
+
+static std::string flightName(const std::string &_path) {
+  const std::size_t begin = _path.find_last_of('/') + 1;
+  const std::size_t end   = _path.find_last_of('.');
+  if (end == std::string::npos || end < begin) {
+    return _path.substr(begin);
+  }
+  return _path.substr(begin, end - begin);
+}
+
+static bool loadBinary(std::ifstream &_file, Flight_log &_log, std::string &_error) {
+  char magic[8];
+  uint32_t version = 0;
+  uint32_t fields  = 0;
+  uint64_t count   = 0;
+  _file.read(magic, sizeof(magic));
+  _file.read(reinterpret_cast<char *>(&version), sizeof(version));
+  _file.read(reinterpret_cast<char *>(&fields), sizeof(fields));
+  _file.read(reinterpret_cast<char *>(&count), sizeof(count));
+  if (!_file || std::memcmp(magic, flight_log_magic, sizeof(magic)) != 0) {
+    _error = "not a flight log";
+    return false;
+  }
+  if (version != flight_log_version || fields != flight_sample_fields) {
+    _error = "unsupported flight log version " + std::to_string(version);
+    return false;
+  }
+
+  // Read in blocks, a flight can hold millions of samples
+  constexpr std::size_t block_samples = 4096;
+  std::vector<Flight_fields> block(block_samples);
+  _log.samples.resize(count);
+  for (uint64_t first = 0; first < count; first += block_samples) {
+    const std::size_t n =
+        static_cast<std::size_t>(std::min<uint64_t>(block_samples, count - first));
+    _file.read(reinterpret_cast<char *>(block.data()), n * sizeof(Flight_fields));
+    if (!_file) {
+      _error = "truncated flight log";
+      return false;
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      fromFields(block[i], _log.samples[first + i]);
+    }
+  }
+  return true;
+}
+
+static bool loadCSV(std::ifstream &_file, Flight_log &_log, std::string &_error) {
+  std::string line;
+  if (!std::getline(_file, line)) {
+    _error = "empty file";
+    return false;
+  }
+
+  Flight_fields fields;
+  Flight_sample sample;
+  std::size_t line_number = 1;
+  while (std::getline(_file, line)) {
+    line_number++;
+    if (line.empty()) {
+      continue;
+    }
+    const char *cursor = line.c_str();
+    for (std::size_t i = 0; i < flight_sample_fields; i++) {
+      char *end = nullptr;
+      fields[i] = std::strtod(cursor, &end);
+      if (end == cursor || (*end != ',' && *end != '\0' && *end != '\r')) {
+        _error = "bad value in line " + std::to_string(line_number);
+        return false;
+      }
+      cursor = *end == ',' ? end + 1 : end;
+    }
+    fromFields(fields, sample);
+    _log.samples.push_back(sample);
+  }
+  return true;
+}
+
+bool loadFlightLog(const std::string &_path, Flight_log &_log, std::string &_error) {
+  std::ifstream file(_path, std::ios::binary);
+  if (!file) {
+    _error = "can not open " + _path;
+    return false;
+  }
+  _log.name = flightName(_path);
+  _log.samples.clear();
+
+  const bool csv = _path.size() >= 4 && _path.compare(_path.size() - 4, 4, ".csv") == 0;
+  return csv ? loadCSV(file, _log, _error) : loadBinary(file, _log, _error);
+}
+
+bool saveFlightLogBinary(const std::string &_path, const Flight_log &_log) {
+  std::ofstream file(_path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  const uint32_t version = flight_log_version;
+  const uint32_t fields  = flight_sample_fields;
+  const uint64_t count   = _log.samples.size();
+  file.write(flight_log_magic, sizeof(flight_log_magic));
+  file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+  file.write(reinterpret_cast<const char *>(&fields), sizeof(fields));
+  file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+
+  Flight_fields values;
+  for (const Flight_sample &sample : _log.samples) {
+    toFields(sample, values);
+    file.write(reinterpret_cast<const char *>(values.data()), sizeof(values));
+  }
+  return static_cast<bool>(file);
+}
+
+bool saveFlightLogCSV(const std::string &_path, const Flight_log &_log) {
+  std::ofstream file(_path);
+  if (!file) {
+    return false;
+  }
+  file << flight_log_csv_header << "\n";
+  file.precision(17);
+
+  Flight_fields values;
+  for (const Flight_sample &sample : _log.samples) {
+    toFields(sample, values);
+    for (std::size_t i = 0; i < flight_sample_fields; i++) {
+      file << values[i] << (i + 1 < flight_sample_fields ? "," : "\n");
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,308 @@
+/*!*******************************************************************************************
+ *  \file       flight_recorder.cpp
+ *  \brief      Lock-free recorder of the control law internals to a memory-mapped file.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "flight_recorder.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace controller_plugin_differential_flatness {
+
+static constexpr char flight_recording_magic[8] = {'D', 'F', 'R', 'E', 'C', 0, 0, 0};
+static constexpr uint32_t flight_recording_version = 1;
+
+// magic, version, record size, record count
+static constexpr std::size_t recording_header_size  = 24;
+static constexpr std::size_t recording_count_offset = 16;
+
+// The file grows by this many records at a time, about 1.6 MB
+static constexpr uint64_t recording_grow_records = 4096;
+
+static inline void copyVector(const Eigen::Vector3d &_vector, double *_out) {
+  _out[0] = _vector.x();
+  _out[1] = _vector.y();
+  _out[2] = _vector.z();
+}
+
+void fillFlightRecord(const double &_stamp,
+                      const double &_dt,
+                      const Eigen::Vector3d &_position,
+                      const Eigen::Vector3d &_velocity,
+                      const Eigen::Quaterniond &_attitude,
+                      const Eigen::Matrix3d &_rot_matrix,
+                      const UAV_reference &_reference,
+                      const Eigen::Vector3d &_accum_pos_error,
+                      const Eigen::Vector3d &_desired_force,
+                      const Eigen::Matrix3d &_R_des,
+                      const Acro_command &_command,
+                      Flight_record &_record) {
+  _record.stamp = _stamp;
+  _record.dt    = _dt;
+  copyVector(_position, _record.position);
+  copyVector(_velocity, _record.velocity);
+  _record.attitude[0] = _attitude.w();
+  _record.attitude[1] = _attitude.x();
+  _record.attitude[2] = _attitude.y();
+  _record.attitude[3] = _attitude.z();
+
+  copyVector(_reference.position, _record.ref_position);
+  copyVector(_reference.velocity, _record.ref_velocity);
+  copyVector(_reference.acceleration, _record.ref_acceleration);
+  _record.ref_yaw = _reference.yaw;
+
+  copyVector(_reference.position - _position, _record.position_error);
+  copyVector(_reference.velocity - _velocity, _record.velocity_error);
+  copyVector(_accum_pos_error, _record.accum_pos_error);
+  copyVector(_desired_force, _record.desired_force);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      _record.R_des[3 * i + j] = _R_des(i, j);
+    }
+  }
+  copyVector(computeAttitudeError<double>(_R_des, _rot_matrix), _record.E_rot);
+
+  copyVector(_command.PQR, _record.PQR);
+  _record.thrust = _command.thrust;
+}
+
+Flight_sample toFlightSample(const Flight_record &_record) {
+  Flight_sample sample;
+  sample.dt       = _record.dt;
+  sample.position = Eigen::Vector3d(_record.position);
+  sample.velocity = Eigen::Vector3d(_record.velocity);
+  sample.attitude = Eigen::Quaterniond(_record.attitude[0], _record.attitude[1],
+                                       _record.attitude[2], _record.attitude[3]);
+  sample.reference.position     = Eigen::Vector3d(_record.ref_position);
+  sample.reference.velocity     = Eigen::Vector3d(_record.ref_velocity);
+  sample.reference.acceleration = Eigen::Vector3d(_record.ref_acceleration);
+  sample.reference.yaw          = _record.ref_yaw;
+  sample.command.PQR            = Eigen::Vector3d(_record.PQR);
+  sample.command.thrust         = _record.thrust;
+  return sample;
+}
+
+bool loadFlightRecording(const std::string &_path,
+                         std::vector<Flight_record> &_records,
+                         std::string &_error) {
+  std::ifstream file(_path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    _error = "can not open " + _path;
+    return false;
+  }
+  const uint64_t file_size = static_cast<uint64_t>(file.tellg());
+  file.seekg(0);
+
+  char magic[8];
+  uint32_t version     = 0;
+  uint32_t record_size = 0;
+  uint64_t count       = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(&version), sizeof(version));
+  file.read(reinterpret_cast<char *>(&record_size), sizeof(record_size));
+  file.read(reinterpret_cast<char *>(&count), sizeof(count));
+  if (!file || std::memcmp(magic, flight_recording_magic, sizeof(magic)) != 0) {
+    _error = "not a flight recording";
+    return false;
+  }
+  if (version != flight_recording_version || record_size != sizeof(Flight_record)) {
+    _error = "unsupported flight recording version " + std::to_string(version);
+    return false;
+  }
+  if (file_size < recording_header_size + count * sizeof(Flight_record)) {
+    _error = "truncated flight recording";
+    return false;
+  }
+
+  _records.resize(count);
+  file.read(reinterpret_cast<char *>(_records.data()), count * sizeof(Flight_record));
+  if (!file) {
+    _error = "truncated flight recording";
+    return false;
+  }
+  return true;
+}
+
+bool FlightRecorder::start(const std::string &_path, double _drain_period, std::string &_error) {
+  stop();
+
+  if (!queue_storage_) {
+    queue_storage_ = std::make_unique<Queue>();
+    queue_.store(queue_storage_.get(), std::memory_order_release);
+  }
+  // Only consumer while stopped, whatever was pushed since belongs to no file
+  Flight_record discarded;
+  while (queue_storage_->pop(discarded)) {
+  }
+
+  error_.clear();
+  path_         = _path;
+  file_records_ = 0;
+  fd_           = ::open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    _error = _path + ": " + std::strerror(errno);
+    return false;
+  }
+  if (!reserve(recording_grow_records)) {
+    _error = error_;
+    closeFile();
+    return false;
+  }
+  const uint32_t record_size = sizeof(Flight_record);
+  std::memcpy(map_, flight_recording_magic, sizeof(flight_recording_magic));
+  std::memcpy(map_ + 8, &flight_recording_version, sizeof(flight_recording_version));
+  std::memcpy(map_ + 12, &record_size, sizeof(record_size));
+  std::memcpy(map_ + recording_count_offset, &file_records_, sizeof(file_records_));
+
+  stop_requested_ = false;
+  recorded_.store(0, std::memory_order_relaxed);
+  overruns_.store(0, std::memory_order_relaxed);
+  recording_.store(true, std::memory_order_release);
+  thread_ = std::thread(&FlightRecorder::run, this, _drain_period);
+  return true;
+}
+
+bool FlightRecorder::stop() {
+  if (!thread_.joinable()) {
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+
+  // The writer is gone, this thread is the consumer for the last drain
+  recording_.store(false, std::memory_order_release);
+  bool success = error_.empty() && drain();
+  success &= closeFile();
+  return success;
+}
+
+void FlightRecorder::run(double _drain_period) {
+  const auto period = std::chrono::duration<double>(_drain_period);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_requested_) {
+    wake_.wait_for(lock, period, [this]() { return stop_requested_; });
+    lock.unlock();
+    const bool success = drain();
+    lock.lock();
+    if (!success) {
+      recording_.store(false, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+/* Pop the queued records straight into the mapping and publish the new count in the header */
+bool FlightRecorder::drain() {
+  const std::size_t available = queue_storage_->size();
+  if (available == 0) {
+    return true;
+  }
+  if (!reserve(file_records_ + available)) {
+    return false;
+  }
+
+  Flight_record *records = reinterpret_cast<Flight_record *>(map_ + recording_header_size);
+  std::size_t count      = 0;
+  while (count < available && queue_storage_->pop(records[file_records_ + count])) {
+    count++;
+  }
+  file_records_ += count;
+  std::memcpy(map_ + recording_count_offset, &file_records_, sizeof(file_records_));
+  recorded_.fetch_add(count, std::memory_order_relaxed);
+  return true;
+}
+
+/* Grow the file and the mapping to hold at least _records */
+bool FlightRecorder::reserve(uint64_t _records) {
+  const std::size_t required = recording_header_size + _records * sizeof(Flight_record);
+  if (required <= mapped_size_) {
+    return true;
+  }
+  const std::size_t size =
+      std::max(required, mapped_size_ + recording_grow_records * sizeof(Flight_record));
+
+  if (map_ != nullptr) {
+    munmap(map_, mapped_size_);
+    map_         = nullptr;
+    mapped_size_ = 0;
+  }
+  if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+    error_ = path_ + ": ftruncate: " + std::strerror(errno);
+    return false;
+  }
+  void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) {
+    error_ = path_ + ": mmap: " + std::strerror(errno);
+    return false;
+  }
+  map_         = static_cast<unsigned char *>(map);
+  mapped_size_ = size;
+  return true;
+}
+
+/* Unmap and cut the preallocated tail, so the file ends after the last record */
+bool FlightRecorder::closeFile() {
+  if (fd_ < 0) {
+    return true;
+  }
+  bool success = true;
+  if (map_ != nullptr) {
+    munmap(map_, mapped_size_);
+    map_         = nullptr;
+    mapped_size_ = 0;
+    const std::size_t size = recording_header_size + file_records_ * sizeof(Flight_record);
+    if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+      error_  = path_ + ": ftruncate: " + std::strerror(errno);
+      success = false;
+    }
+  }
+  ::close(fd_);
+  fd_ = -1;
+  return success;
+}
+
+};  // namespace controller_plugin_differential_flatness
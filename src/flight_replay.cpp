@@ -0,0 +1,95 @@
+/*!*******************************************************************************************
+ *  \file       flight_replay.cpp
+ *  \brief      Offline replay of recorded flights through the control law.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "flight_replay.hpp"
+
+#include <algorithm>
+
+namespace controller_plugin_differential_flatness {
+
+void Replay_statistics::merge(const Replay_statistics &_other) {
+  ticks += _other.ticks;
+  sum_sq_pqr_error += _other.sum_sq_pqr_error;
+  sum_sq_thrust_error += _other.sum_sq_thrust_error;
+  max_pqr_error    = std::max(max_pqr_error, _other.max_pqr_error);
+  max_thrust_error = std::max(max_thrust_error, _other.max_thrust_error);
+}
+
+template <typename Law>
+static Replay_statistics replay(const Flight_log &_log,
+                                Law &_law,
+                                const Replay_options &_options,
+                                std::vector<Acro_command> *_commands) {
+  Replay_statistics statistics;
+  if (_commands) {
+    _commands->resize(_log.samples.size());
+  }
+
+  for (std::size_t i = 0; i < _log.samples.size(); i++) {
+    const Flight_sample &sample = _log.samples[i];
+    const UAV_reference &ref    = sample.reference;
+    if (_options.reset_integral_each_tick) {
+      _law.resetIntegral();
+    }
+
+    const Acro_command command = _law.computeTrajectoryControl(
+        sample.dt, sample.position, sample.velocity, sample.attitude.toRotationMatrix(),
+        ref.position, ref.velocity, ref.acceleration, ref.yaw);
+    if (_commands) {
+      (*_commands)[i] = command;
+    }
+
+    const double pqr_error    = (command.PQR - sample.command.PQR).norm();
+    const double thrust_error = std::abs(command.thrust - sample.command.thrust);
+    statistics.sum_sq_pqr_error += pqr_error * pqr_error;
+    statistics.sum_sq_thrust_error += thrust_error * thrust_error;
+    statistics.max_pqr_error    = std::max(statistics.max_pqr_error, pqr_error);
+    statistics.max_thrust_error = std::max(statistics.max_thrust_error, thrust_error);
+  }
+  statistics.ticks = _log.samples.size();
+  return statistics;
+}
+
+Replay_statistics replayFlight(const Flight_log &_log,
+                               DFControlLawVariant &_law,
+                               const Replay_options &_options,
+                               std::vector<Acro_command> *_commands) {
+  // Visit once per flight, the loop runs on the concrete law
+  return std::visit([&](auto &law) { return replay(_log, law, _options, _commands); }, _law);
+}
+
+};  // namespace controller_plugin_differential_flatness
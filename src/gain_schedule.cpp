@@ -0,0 +1,169 @@
+/*!*******************************************************************************************
+ *  \file       gain_schedule.cpp
+ *  \brief      Gain scheduling tables interpolated on the control tick.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "gain_schedule.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include <yaml-cpp/yaml.h>
+
+namespace controller_plugin_differential_flatness {
+
+static bool readAxes(const YAML::Node &_point,
+                     const char *_key,
+                     Scheduled_gains &_gains,
+                     int _offset,
+                     std::string &_error) {
+  const YAML::Node axes = _point[_key];
+  if (!axes || !axes.IsSequence() || axes.size() != 3) {
+    _error = std::string("'") + _key + "' must be a list of 3 values";
+    return false;
+  }
+  for (int i = 0; i < 3; i++) {
+    _gains(_offset + i) = axes[i].as<double>();
+  }
+  return true;
+}
+
+bool GainSchedule::loadFile(const std::string &_path, std::string &_error) {
+  std::ifstream file(_path);
+  if (!file) {
+    _error = "Can not open " + _path;
+    return false;
+  }
+  std::stringstream yaml;
+  yaml << file.rdbuf();
+  return loadString(yaml.str(), _error);
+}
+
+bool GainSchedule::loadString(const std::string &_yaml, std::string &_error) {
+  std::vector<Profile> profiles;
+  std::vector<double> speeds;
+  std::vector<Scheduled_gains> gains;
+
+  try {
+    const YAML::Node root          = YAML::Load(_yaml);
+    const YAML::Node profiles_node = root["profiles"];
+    if (!profiles_node || !profiles_node.IsSequence() || profiles_node.size() == 0) {
+      _error = "'profiles' must be a non empty list";
+      return false;
+    }
+
+    for (const YAML::Node &profile_node : profiles_node) {
+      Profile profile;
+      profile.name           = profile_node["name"].as<std::string>();
+      profile.mass           = profile_node["mass"].as<double>();
+      profile.antiwindup_cte = profile_node["antiwindup_cte"].as<double>();
+      profile.first          = speeds.size();
+
+      const YAML::Node points = profile_node["points"];
+      if (!points || !points.IsSequence() || points.size() == 0) {
+        _error = "Profile " + profile.name + ": 'points' must be a non empty list";
+        return false;
+      }
+      for (const YAML::Node &point : points) {
+        const double speed = point["speed"].as<double>();
+        if (profile.count > 0 && speed <= speeds.back()) {
+          _error = "Profile " + profile.name + ": speeds must be strictly increasing";
+          return false;
+        }
+        Scheduled_gains point_gains;
+        if (!readAxes(point, "kp", point_gains, 0, _error) ||
+            !readAxes(point, "ki", point_gains, 3, _error) ||
+            !readAxes(point, "kd", point_gains, 6, _error) ||
+            !readAxes(point, "kp_ang", point_gains, 9, _error)) {
+          _error = "Profile " + profile.name + ": " + _error;
+          return false;
+        }
+        speeds.push_back(speed);
+        gains.push_back(point_gains);
+        profile.count++;
+      }
+      profiles.push_back(profile);
+    }
+  } catch (const YAML::Exception &e) {
+    _error = e.what();
+    return false;
+  }
+
+  profiles_ = std::move(profiles);
+  speeds_   = std::move(speeds);
+  gains_    = std::move(gains);
+  return true;
+}
+
+std::size_t GainSchedule::findProfile(const std::string &_name) const {
+  for (std::size_t i = 0; i < profiles_.size(); i++) {
+    if (profiles_[i].name == _name) {
+      return i;
+    }
+  }
+  return profiles_.size();
+}
+
+void GainSchedule::sample(std::size_t _profile, const double &_speed, DF_gains &_gains) const {
+  const Profile &profile = profiles_[_profile];
+  const double *speeds   = speeds_.data() + profile.first;
+  const std::size_t last = profile.first + profile.count - 1;
+
+  Scheduled_gains gains;
+  if (_speed <= speeds[0]) {
+    gains = gains_[profile.first];
+  } else if (_speed >= speeds[profile.count - 1]) {
+    gains = gains_[last];
+  } else {
+    // Tables are a handful of points, a linear scan beats a binary search
+    std::size_t i = 1;
+    while (speeds[i] < _speed) {
+      i++;
+    }
+    const double s = (_speed - speeds[i - 1]) / (speeds[i] - speeds[i - 1]);
+    const Scheduled_gains &low  = gains_[profile.first + i - 1];
+    const Scheduled_gains &high = gains_[profile.first + i];
+    gains                       = low + s * (high - low);
+  }
+
+  _gains.Kp             = gains.segment<3>(0).asDiagonal();
+  _gains.Ki             = gains.segment<3>(3).asDiagonal();
+  _gains.Kd             = gains.segment<3>(6).asDiagonal();
+  _gains.Kp_ang         = gains.segment<3>(9).asDiagonal();
+  _gains.mass           = profile.mass;
+  _gains.antiwindup_cte = profile.antiwindup_cte;
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,145 @@
+/*!*******************************************************************************************
+ *  \file       health_events.cpp
+ *  \brief      Health events raised by the control tick and reported off the tick.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "health_events.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include "parameter_table.hpp"
+#include "perf_counters.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+bool HealthEvents::pop(Health_record &_record) {
+  Health_event event;
+  if (!queue_.pop(event)) {
+    return false;
+  }
+  // Cleared before the detail is read, a raise in between queues the event again
+  const std::size_t i = static_cast<std::size_t>(event);
+  queued_[i].store(false, std::memory_order_release);
+  _record.event  = event;
+  _record.detail = details_[i].load(std::memory_order_relaxed);
+  _record.count  = counts_[i].load(std::memory_order_relaxed);
+  return true;
+}
+
+HealthEventThrottle::HealthEventThrottle() {
+  last_report_.fill(-std::numeric_limits<double>::infinity());
+}
+
+bool HealthEventThrottle::admit(const Health_record &_record,
+                                const double &_now,
+                                uint64_t &_occurrences) {
+  const std::size_t i           = static_cast<std::size_t>(_record.event);
+  const Health_event_info &info = health_event_info[i];
+  const bool changed            = info.report_changes && _record.detail != reported_details_[i];
+  if (!changed && _now - last_report_[i] < info.report_period) {
+    pending_[i] = _record;
+    return false;
+  }
+  pending_[i]          = Health_record();
+  _occurrences         = _record.count - reported_counts_[i];
+  last_report_[i]      = _now;
+  reported_counts_[i]  = _record.count;
+  reported_details_[i] = _record.detail;
+  return true;
+}
+
+bool HealthEventThrottle::takeDue(const double &_now,
+                                  Health_record &_record,
+                                  uint64_t &_occurrences) {
+  for (std::size_t i = 0; i < health_event_count; i++) {
+    if (pending_[i].event != Health_event::count &&
+        _now - last_report_[i] >= health_event_info[i].report_period) {
+      _record = pending_[i];
+      return admit(_record, _now, _occurrences);
+    }
+  }
+  return false;
+}
+
+std::string describeHealthEvent(const Health_record &_record) {
+  switch (_record.event) {
+    case Health_event::state_not_received:
+      return "State not received yet";
+    case Health_event::reference_not_received:
+      return "State changed, but ref not received yet";
+    case Health_event::parameters_missing: {
+      std::string message = "Parameters not read yet:";
+      for (std::size_t i = 0; i < required_parameter_count; i++) {
+        if (_record.detail & parameterBit(static_cast<DF_parameter>(i))) {
+          message += " ";
+          message += parameter_names[i];
+        }
+      }
+      return message;
+    }
+    case Health_event::unknown_yaw_mode:
+      return "Unknown yaw mode " + std::to_string(_record.detail);
+    case Health_event::unknown_control_mode:
+      return "Unknown control mode " + std::to_string(_record.detail);
+    case Health_event::realtime_command_stale:
+      return "Real-time thread command is " + std::to_string(_record.detail / 1000) + " ms old";
+    case Health_event::perf_counters_disabled: {
+      const int error     = static_cast<int>(_record.detail);
+      std::string message = std::string("Hardware counters disabled: ") + std::strerror(error);
+      if (error == EACCES || error == EPERM) {
+        message += ", kernel.perf_event_paranoid must be 2 or lower";
+      } else if (error == ENOENT || error == EOPNOTSUPP) {
+        message += ", no hardware counters exposed to this system";
+      }
+      return message;
+    }
+    case Health_event::perf_counter_unavailable: {
+      std::string message = "Hardware counters not available:";
+      for (std::size_t i = 0; i < perf_event_count; i++) {
+        if (_record.detail & (uint64_t(1) << i)) {
+          message += " ";
+          message += perf_event_names[i];
+        }
+      }
+      return message;
+    }
+    default:
+      return "Unknown health event";
+  }
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,117 @@
+/*!*******************************************************************************************
+ *  \file       latency_histogram.cpp
+ *  \brief      Lock-free fixed bucket latency histogram.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "latency_histogram.hpp"
+
+#include <cmath>
+
+namespace controller_plugin_differential_flatness {
+
+std::size_t LatencyHistogram::bucketIndex(uint64_t _value_ns) {
+  if (_value_ns < sub_bucket_count) {
+    return static_cast<std::size_t>(_value_ns);
+  }
+  const uint64_t saturation = (uint64_t(1) << (max_exponent + 1)) - 1;
+  if (_value_ns > saturation) {
+    _value_ns = saturation;
+  }
+  // Position of the leading bit, >= sub_bucket_bits here
+  const uint8_t exponent = static_cast<uint8_t>(63 - __builtin_clzll(_value_ns));
+  const uint8_t shift    = exponent - sub_bucket_bits;
+  // Leading bit plus the next sub_bucket_bits bits, in [sub_bucket_count, 2 * sub_bucket_count)
+  const uint64_t mantissa = _value_ns >> shift;
+  return shift * sub_bucket_count + static_cast<std::size_t>(mantissa);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(std::size_t _index) {
+  if (_index < 2 * sub_bucket_count) {
+    return _index;
+  }
+  const std::size_t shift = _index / sub_bucket_count - 1;
+  const uint64_t mantissa = _index % sub_bucket_count + sub_bucket_count;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::snapshot(Snapshot &_snapshot) const {
+  _snapshot.max_ns = max_ns_.load(std::memory_order_relaxed);
+  _snapshot.count  = 0;
+  for (std::size_t i = 0; i < bucket_count; i++) {
+    _snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    _snapshot.count += _snapshot.counts[i];
+  }
+}
+
+void LatencyHistogram::difference(const Snapshot &_current,
+                                  const Snapshot &_previous,
+                                  Snapshot &_result) {
+  _result.max_ns = _current.max_ns;
+  _result.count  = 0;
+  for (std::size_t i = 0; i < bucket_count; i++) {
+    _result.counts[i] = _current.counts[i] - _previous.counts[i];
+    _result.count += _result.counts[i];
+  }
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(const double &_quantile) const {
+  if (count == 0) {
+    return 0;
+  }
+  // Rank of the requested sample, 1 based
+  uint64_t rank = static_cast<uint64_t>(std::ceil(_quantile * static_cast<double>(count)));
+  if (rank < 1) {
+    rank = 1;
+  }
+  uint64_t accumulated = 0;
+  for (std::size_t i = 0; i < bucket_count; i++) {
+    accumulated += counts[i];
+    if (accumulated >= rank) {
+      return bucketUpperBound(i);
+    }
+  }
+  return maxBucket();
+}
+
+uint64_t LatencyHistogram::Snapshot::maxBucket() const {
+  for (std::size_t i = bucket_count; i > 0; i--) {
+    if (counts[i - 1] != 0) {
+      return bucketUpperBound(i - 1);
+    }
+  }
+  return 0;
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,221 @@
+/*!*******************************************************************************************
+ *  \file       lookahead_cache.cpp
+ *  \brief      Flatness terms of the reference precomputed over the upcoming horizon.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "lookahead_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace controller_plugin_differential_flatness {
+
+static constexpr uint64_t window_index_mask = (1ull << 48) - 1;
+
+static inline uint64_t packWindow(uint32_t _epoch, int64_t _end) {
+  return (static_cast<uint64_t>(_epoch & 0xFFFF) << 48) |
+         (static_cast<uint64_t>(_end) & window_index_mask);
+}
+
+template <typename T>
+static inline T lerp(const T &_a, const T &_b, const double &_w) {
+  return _a + _w * (_b - _a);
+}
+
+Flatness_sample makeFlatnessSample(const UAV_reference &_reference) {
+  const Eigen::Vector3d gravitational_accel(0.0, 0.0, -9.81);
+
+  Flatness_sample sample;
+  sample.reference      = _reference;
+  sample.specific_force = _reference.acceleration - gravitational_accel;
+  sample.heading        = Eigen::Vector3d(std::cos(_reference.yaw), std::sin(_reference.yaw), 0.0);
+  return sample;
+}
+
+void LookaheadCache::start() {
+  if (thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = false;
+  }
+  thread_ = std::thread(&LookaheadCache::run, this);
+}
+
+void LookaheadCache::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void LookaheadCache::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_requested_) {
+    lock.unlock();
+    catchUp();
+    fill();
+    lock.lock();
+
+    // Wakes about once per sample, which keeps the horizon filled as the consumer advances
+    const double period = std::clamp(worker_options_.sample_period, 1e-4, 0.01);
+    wake_.wait_for(lock, std::chrono::duration<double>(period), [this]() {
+      return stop_requested_;
+    });
+  }
+}
+
+/* Apply the commands of a new epoch and restart filling at the consumer position */
+void LookaheadCache::catchUp() {
+  const uint32_t epoch = requested_epoch_.load(std::memory_order_acquire);
+  if (epoch == built_epoch_) {
+    return;
+  }
+
+  Command command;
+  while (commands_.pop(command)) {
+    if (command.reset) {
+      segments_.clear();
+      worker_origin_  = command.origin;
+      worker_options_ = command.options;
+    } else {
+      segments_.push(command.segment);
+    }
+  }
+
+  // The consumer does not read samples of an older epoch any more, so every slot can be reused
+  built_epoch_ = epoch;
+  next_        = cursor_.load(std::memory_order_acquire);
+  window_.store(packWindow(built_epoch_, next_), std::memory_order_release);
+}
+
+/* Fill up to the horizon past the consumer, never overwriting a sample it may still read */
+void LookaheadCache::fill() {
+  const double period = worker_options_.sample_period;
+  if (segments_.empty() || !(period > 0.0)) {
+    return;
+  }
+
+  const int64_t cursor = cursor_.load(std::memory_order_acquire);
+  const int64_t ahead  = std::min<int64_t>(
+      static_cast<int64_t>(std::ceil(worker_options_.horizon / period)) + 1, capacity - 1);
+  next_ = std::max(next_, cursor);
+
+  UAV_reference reference;
+  for (; next_ <= cursor + ahead; next_++) {
+    segments_.sample(worker_origin_ + next_ * period, reference);
+    samples_[next_ % capacity] = makeFlatnessSample(reference);
+    window_.store(packWindow(built_epoch_, next_ + 1), std::memory_order_release);
+  }
+  segments_.discardBefore(worker_origin_ + cursor * period);
+}
+
+void LookaheadCache::requestEpoch() {
+  epoch_++;
+  requested_epoch_.store(epoch_, std::memory_order_release);
+}
+
+bool LookaheadCache::reset(const double &_now, const Lookahead_options &_options) {
+  origin_  = _now;
+  options_ = _options;
+  cursor_.store(0, std::memory_order_relaxed);
+
+  Command command;
+  command.reset   = true;
+  command.origin  = _now;
+  command.options = _options;
+  // A full queue leaves the epoch without a reset, which never serves a sample until the next one
+  epoch_valid_ = commands_.push(command);
+  requestEpoch();
+  return epoch_valid_;
+}
+
+bool LookaheadCache::pushSegment(const Trajectory_segment &_segment) {
+  Command command;
+  command.segment = _segment;
+  const bool pushed = commands_.push(command);
+  // Samples built without the segment are stale either way
+  requestEpoch();
+  epoch_valid_ = epoch_valid_ && pushed;
+  return pushed;
+}
+
+bool LookaheadCache::sample(const double &_t, Flatness_sample &_sample) {
+  const double period   = options_.sample_period;
+  const double x        = (_t - origin_) / period;
+  const uint64_t window = window_.load(std::memory_order_acquire);
+  const bool in_grid    = x >= 0.0 && x < static_cast<double>(window_index_mask);
+  if (!epoch_valid_ || !(period > 0.0) || !in_grid) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  const int64_t k      = static_cast<int64_t>(x);
+  const int64_t cursor = cursor_.load(std::memory_order_relaxed);
+  if (k < cursor || (window >> 48) != (epoch_ & 0xFFFF) ||
+      k + 1 >= static_cast<int64_t>(window & window_index_mask)) {
+    // After a tick gap longer than the horizon the worker refills from k, not from the last hit
+    if (k > cursor) {
+      cursor_.store(k, std::memory_order_release);
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  const Flatness_sample &a = samples_[k % capacity];
+  const Flatness_sample &b = samples_[(k + 1) % capacity];
+  const double w           = x - static_cast<double>(k);
+
+  _sample.reference.position     = lerp(a.reference.position, b.reference.position, w);
+  _sample.reference.velocity     = lerp(a.reference.velocity, b.reference.velocity, w);
+  _sample.reference.acceleration = lerp(a.reference.acceleration, b.reference.acceleration, w);
+  const double yaw_diff          = std::remainder(b.reference.yaw - a.reference.yaw, 2.0 * M_PI);
+  _sample.reference.yaw          = std::remainder(a.reference.yaw + w * yaw_diff, 2.0 * M_PI);
+  _sample.specific_force         = lerp(a.specific_force, b.specific_force, w);
+  _sample.heading                = lerp(a.heading, b.heading, w);
+
+  // Samples before k are free for the worker once both are copied
+  cursor_.store(k, std::memory_order_release);
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,68 @@
+/*!*******************************************************************************************
+ *  \file       multi_rate_control.cpp
+ *  \brief      Outer position loop running slower than the attitude loop.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "multi_rate_control.hpp"
+
+namespace controller_plugin_differential_flatness {
+
+void MultiRateControl::setRate(const double &_rate) {
+  const double period = _rate > 0.0 ? 1.0 / _rate : 0.0;
+  if (period != period_) {
+    period_ = period;
+    valid_  = false;
+  }
+}
+
+bool MultiRateControl::outerLoopDue(const double &_dt, double &_outer_dt) {
+  elapsed_ += _dt;
+  // Run on this tick unless the next one is closer to the period
+  if (valid_ && elapsed_ + 0.5 * _dt < period_) {
+    return false;
+  }
+  _outer_dt = valid_ ? elapsed_ : _dt;
+  elapsed_  = 0.0;
+  return true;
+}
+
+void MultiRateControl::storeOuterLoop(const Eigen::Vector3d &_desired_force,
+                                      const Eigen::Matrix3d &_R_des) {
+  desired_force_ = _desired_force;
+  R_des_         = _R_des;
+  valid_         = true;
+}
+
+};  // namespace controller_plugin_differential_flatness
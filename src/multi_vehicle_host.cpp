@@ -0,0 +1,220 @@
+/*!*******************************************************************************************
+ *  \file       multi_vehicle_host.cpp
+ *  \brief      Many plugin instances in one process, behind a single executor and a batched tick.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "multi_vehicle_host.hpp"
+
+#include <as2_core/names/topics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace controller_plugin_differential_flatness {
+
+/* [s] between two reports of a vehicle, as the plugin's own report timer */
+static constexpr double report_period = 0.2;
+
+MultiVehicleHost::MultiVehicleHost(const rclcpp::NodeOptions &_options)
+    : rclcpp::Node("multi_vehicle_host", _options) {
+  const int64_t vehicles   = this->declare_parameter<int64_t>("vehicles", 1);
+  const std::string prefix = this->declare_parameter<std::string>("namespace_prefix", "drone");
+  const double rate        = this->declare_parameter<double>("rate", 100.0);
+  const int64_t threads    = this->declare_parameter<int64_t>("threads", 0);
+  const std::vector<std::string> gains_files =
+      this->declare_parameter<std::vector<std::string>>("gains_files", std::vector<std::string>());
+  const std::vector<int64_t> vehicle_profiles =
+      this->declare_parameter<std::vector<int64_t>>("vehicle_profiles", std::vector<int64_t>());
+  odometry_topic_ = this->declare_parameter<std::string>("odometry_topic", "");
+
+  if (vehicles <= 0 || rate <= 0.0 || threads < 0) {
+    RCLCPP_ERROR(this->get_logger(), "vehicles and rate must be positive, threads not negative");
+    return;
+  }
+  if (!loadProfiles(gains_files)) {
+    return;
+  }
+  for (int64_t profile : vehicle_profiles) {
+    if (profile < 0 || static_cast<std::size_t>(profile) >= profiles_.size()) {
+      RCLCPP_ERROR(this->get_logger(), "Vehicle profile %ld out of range", profile);
+      return;
+    }
+  }
+
+  vehicles_.reserve(vehicles);
+  for (std::size_t i = 0; i < static_cast<std::size_t>(vehicles); i++) {
+    const std::size_t profile =
+        vehicle_profiles.empty() ? 0 : vehicle_profiles[i % vehicle_profiles.size()];
+    addVehicle(i, "/" + prefix + std::to_string(i), profile);
+  }
+
+  period_        = 1.0 / rate;
+  report_stride_ = std::max<std::size_t>(1, std::lround(report_period / period_));
+  pool_          = std::make_unique<ThreadPool>(threads);
+  tick_timer_ = this->create_wall_timer(std::chrono::duration<double>(1.0 / rate),
+                                        std::bind(&MultiVehicleHost::tick, this));
+  RCLCPP_INFO(this->get_logger(), "Hosting %zu vehicles with %zu gain profiles on %zu threads",
+              vehicles_.size(), profiles_.size(), pool_->size());
+}
+
+/* Parse every gains file once, the updates are shared by all the vehicles flying them */
+bool MultiVehicleHost::loadProfiles(const std::vector<std::string> &_gains_files) {
+  if (_gains_files.empty()) {
+    RCLCPP_ERROR(this->get_logger(), "No gains_files given");
+    return false;
+  }
+  for (const std::string &path : _gains_files) {
+    DF_controller_config config;
+    std::string error;
+    if (!loadControllerConfig(path, config, error)) {
+      RCLCPP_ERROR(this->get_logger(), "Could not load %s: %s", path.c_str(), error.c_str());
+      return false;
+    }
+    std::shared_ptr<const Control_law_update> update = makeControlLawUpdate(config);
+    if (!update) {
+      RCLCPP_ERROR(this->get_logger(), "Unknown control law in %s", path.c_str());
+      return false;
+    }
+    profiles_.push_back(std::move(update));
+  }
+  return true;
+}
+
+void MultiVehicleHost::addVehicle(std::size_t _index,
+                                  const std::string &_namespace,
+                                  std::size_t _profile) {
+  // Thousands of vehicles would otherwise add a parameter service set each
+  rclcpp::NodeOptions options;
+  options.use_intra_process_comms(true);
+  options.start_parameter_services(false);
+  options.start_parameter_event_publisher(false);
+  if (!odometry_topic_.empty()) {
+    // The plugin subscribes to it and then ignores the pose and twist
+    options.parameter_overrides({rclcpp::Parameter("trajectory_control.odometry_topic",
+                                                   odometry_topic_)});
+  }
+
+  vehicles_.emplace_back();
+  Hosted_vehicle &vehicle = vehicles_.back();
+  vehicle.node            = std::make_shared<as2::Node>("controller", _namespace, options);
+  vehicle.plugin          = std::make_shared<Plugin>();
+  vehicle.profile         = _profile;
+
+  // Reported from the host tick, a timer per vehicle would swamp the executor
+  vehicle.plugin->useExternalReports();
+  vehicle.plugin->initialize(vehicle.node.get());
+  vehicle.plugin->shareControlLaw(profiles_[_profile]);
+
+  as2_msgs::msg::ControlMode mode_in;
+  mode_in.control_mode = as2_msgs::msg::ControlMode::TRAJECTORY;
+  mode_in.yaw_mode     = as2_msgs::msg::ControlMode::YAW_ANGLE;
+  as2_msgs::msg::ControlMode mode_out;
+  mode_out.control_mode = as2_msgs::msg::ControlMode::ACRO;
+  if (!vehicle.plugin->setMode(mode_in, mode_out)) {
+    RCLCPP_ERROR(this->get_logger(), "Could not set the mode of vehicle %zu", _index);
+  }
+
+  // The vector is reserved, so the element outlives the callbacks at this address
+  Hosted_vehicle *hosted = &vehicle;
+  if (odometry_topic_.empty()) {
+    vehicle.pose_sub = vehicle.node->create_subscription<geometry_msgs::msg::PoseStamped>(
+        as2_names::topics::self_localization::pose, as2_names::topics::self_localization::qos,
+        [hosted](const geometry_msgs::msg::PoseStamped::SharedPtr _msg) {
+          hosted->pose          = *_msg;
+          hosted->pose_received = true;
+        });
+    vehicle.twist_sub = vehicle.node->create_subscription<geometry_msgs::msg::TwistStamped>(
+        as2_names::topics::self_localization::twist, as2_names::topics::self_localization::qos,
+        [hosted](const geometry_msgs::msg::TwistStamped::SharedPtr _msg) {
+          if (hosted->pose_received) {
+            hosted->plugin->updateState(hosted->pose, *_msg);
+          }
+        });
+  }
+  vehicle.reference_sub = vehicle.node->create_subscription<as2_msgs::msg::TrajectoryPoint>(
+      as2_names::topics::motion_reference::trajectory, as2_names::topics::motion_reference::qos,
+      [hosted](const as2_msgs::msg::TrajectoryPoint::SharedPtr _msg) {
+        hosted->plugin->updateReference(*_msg);
+      });
+
+  vehicle.twist_pub = vehicle.node->create_publisher<geometry_msgs::msg::TwistStamped>(
+      as2_names::topics::actuator_command::twist, as2_names::topics::actuator_command::qos);
+  vehicle.thrust_pub = vehicle.node->create_publisher<as2_msgs::msg::Thrust>(
+      as2_names::topics::actuator_command::thrust, as2_names::topics::actuator_command::qos);
+}
+
+void MultiVehicleHost::addToExecutor(rclcpp::Executor &_executor) {
+  _executor.add_node(this->get_node_base_interface());
+  for (Hosted_vehicle &vehicle : vehicles_) {
+    _executor.add_node(vehicle.node->get_node_base_interface());
+  }
+}
+
+/* One tick of every vehicle. The control stages are spread over the pool, each vehicle is only
+ * touched by one worker, and the commands are published from the executor thread afterwards so
+ * the publishers are never used concurrently */
+void MultiVehicleHost::tick() {
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const double dt =
+      first_tick_ ? period_ : std::chrono::duration<double>(now - last_tick_).count();
+  first_tick_ = false;
+  last_tick_  = now;
+
+  produced_.assign(vehicles_.size(), 0);
+  pool_->parallelFor(vehicles_.size(), [this, dt](std::size_t _index) {
+    Hosted_vehicle &vehicle = vehicles_[_index];
+    produced_[_index] = vehicle.plugin->computeOutput(dt, vehicle.pose_out, vehicle.twist_out,
+                                                      vehicle.thrust_out);
+  });
+
+  for (std::size_t i = 0; i < vehicles_.size(); i++) {
+    if (!produced_[i]) {
+      continue;
+    }
+    Hosted_vehicle &vehicle = vehicles_[i];
+    // Owned messages let intra-process subscribers take them without a copy
+    vehicle.twist_pub->publish(
+        std::make_unique<geometry_msgs::msg::TwistStamped>(vehicle.twist_out));
+    vehicle.thrust_pub->publish(std::make_unique<as2_msgs::msg::Thrust>(vehicle.thrust_out));
+  }
+
+  // A slice of the vehicles per tick, so the reports are spread evenly over the ticks
+  for (std::size_t i = report_phase_; i < vehicles_.size(); i += report_stride_) {
+    vehicles_[i].plugin->report();
+  }
+  report_phase_ = (report_phase_ + 1) % report_stride_;
+}
+
+};  // namespace controller_plugin_differential_flatness
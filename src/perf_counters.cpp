@@ -0,0 +1,143 @@
+/*!*******************************************************************************************
+ *  \file       perf_counters.cpp
+ *  \brief      Hardware performance counters of the calling thread, per stage summaries.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "perf_counters.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace controller_plugin_differential_flatness {
+
+static constexpr std::array<uint64_t, perf_event_count> perf_event_configs = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+static int openPerfEvent(uint64_t _config, int _group_fd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.config         = _config;
+  attr.disabled       = _group_fd < 0 ? 1 : 0;  // the group starts when the leader is enabled
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP;
+  return static_cast<int>(
+      syscall(__NR_perf_event_open, &attr, 0, -1, _group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+int PerfCounterGroup::open() {
+  close();
+
+  for (std::size_t i = 0; i < perf_event_count; i++) {
+    const int fd = openPerfEvent(perf_event_configs[i], leader_fd_);
+    if (fd < 0) {
+      if (i == 0) {
+        return errno;
+      }
+      continue;
+    }
+    if (leader_fd_ < 0) {
+      leader_fd_ = fd;
+    }
+    fds_[i]         = fd;
+    group_index_[i] = static_cast<uint8_t>(group_size_++);
+    available_ |= 1u << i;
+  }
+
+  ioctl(leader_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  if (ioctl(leader_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+    const int error = errno;
+    close();
+    return error;
+  }
+  return 0;
+}
+
+void PerfCounterGroup::close() {
+  for (int &fd : fds_) {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  leader_fd_  = -1;
+  group_size_ = 0;
+  available_  = 0;
+}
+
+bool PerfCounterGroup::read(Perf_sample &_sample) const {
+  // PERF_FORMAT_GROUP layout: number of events, then one value per event in opening order
+  uint64_t buffer[1 + perf_event_count];
+  const ssize_t size = ::read(leader_fd_, buffer, sizeof(buffer));
+  if (size < static_cast<ssize_t>((1 + group_size_) * sizeof(uint64_t))) {
+    return false;
+  }
+  for (std::size_t i = 0; i < perf_event_count; i++) {
+    _sample.values[i] = (available_ & (1u << i)) ? buffer[1 + group_index_[i]] : 0;
+  }
+  return true;
+}
+
+double PerfStageCounters::Snapshot::mean(Perf_event _event) const {
+  if (samples == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(sums[static_cast<std::size_t>(_event)]) / samples;
+}
+
+double PerfStageCounters::Snapshot::ipc() const {
+  const uint64_t cycles = sums[static_cast<std::size_t>(Perf_event::cycles)];
+  if (cycles == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(sums[static_cast<std::size_t>(Perf_event::instructions)]) / cycles;
+}
+
+void PerfStageCounters::snapshot(Snapshot &_snapshot) const {
+  _snapshot.samples = samples_.load(std::memory_order_relaxed);
+  for (std::size_t i = 0; i < perf_event_count; i++) {
+    _snapshot.sums[i] = sums_[i].load(std::memory_order_relaxed);
+  }
+}
+
+};  // namespace controller_plugin_differential_flatness
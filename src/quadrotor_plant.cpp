@@ -0,0 +1,79 @@
+/*!*******************************************************************************************
+ *  \file       quadrotor_plant.cpp
+ *  \brief      Rigid body quadrotor model driven by ACRO commands.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "quadrotor_plant.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace controller_plugin_differential_flatness {
+
+void QuadrotorPlant::resetHover(const Eigen::Vector3d &_position, const double &_yaw) {
+  state_          = Plant_state();
+  state_.position = _position;
+  state_.attitude = Eigen::AngleAxisd(_yaw, Eigen::Vector3d::UnitZ());
+  state_.thrust   = params_.mass * 9.81;
+}
+
+void QuadrotorPlant::step(const Acro_command &_command, const double &_dt) {
+  const Eigen::Vector3d gravitational_accel(0.0, 0.0, -9.81);
+
+  // Exact discretization of the first order lags
+  const double rate_decay     = std::exp(-_dt / params_.rate_time_constant);
+  const double thrust_decay   = std::exp(-_dt / params_.thrust_time_constant);
+  const double thrust_command = std::clamp(_command.thrust, 0.0, params_.max_thrust);
+  state_.body_rates = _command.PQR + (state_.body_rates - _command.PQR) * rate_decay;
+  state_.thrust     = thrust_command + (state_.thrust - thrust_command) * thrust_decay;
+
+  const Eigen::Vector3d rotation = state_.body_rates * _dt;
+  const double angle             = rotation.norm();
+  if (angle > 1e-12) {
+    state_.attitude =
+        (state_.attitude * Eigen::Quaterniond(Eigen::AngleAxisd(angle, rotation / angle)))
+            .normalized();
+  }
+
+  const Eigen::Vector3d acceleration =
+      (state_.thrust * (state_.attitude * Eigen::Vector3d::UnitZ()) -
+       params_.linear_drag * state_.velocity) /
+          params_.mass +
+      gravitational_accel;
+  state_.velocity += acceleration * _dt;
+  state_.position += state_.velocity * _dt;
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,174 @@
+/*!*******************************************************************************************
+ *  \file       realtime_thread.cpp
+ *  \brief      Periodic thread with real-time scheduling, CPU pinning and prefaulted memory.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "realtime_thread.hpp"
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <cerrno>
+#include <cstring>
+#include <future>
+
+namespace controller_plugin_differential_flatness {
+
+bool setCurrentThreadRealtime(int _priority, int _cpu, std::string &_error) {
+  bool success = true;
+  if (_priority > 0) {
+    sched_param param{};
+    param.sched_priority = _priority;
+    const int result     = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0) {
+      _error += "SCHED_FIFO priority " + std::to_string(_priority) + ": " + std::strerror(result) +
+                ". ";
+      success = false;
+    }
+  }
+  if (_cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(_cpu, &cpus);
+    const int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (result != 0) {
+      _error += "Affinity to CPU " + std::to_string(_cpu) + ": " + std::strerror(result) + ". ";
+      success = false;
+    }
+  }
+  return success;
+}
+
+bool lockProcessMemory(std::string &_error) {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    _error += std::string("mlockall: ") + std::strerror(errno) + ". ";
+    return false;
+  }
+  return true;
+}
+
+void prefaultStack(std::size_t _bytes) {
+  if (_bytes == 0) {
+    return;
+  }
+  // Variable length on purpose, so the touched size is the requested one
+  volatile unsigned char *stack = static_cast<volatile unsigned char *>(alloca(_bytes));
+  for (std::size_t i = 0; i < _bytes; i += 4096) {
+    stack[i] = 0;
+  }
+}
+
+static inline void addNs(timespec &_time, int64_t _ns) {
+  _time.tv_nsec += _ns;
+  while (_time.tv_nsec >= 1000000000) {
+    _time.tv_nsec -= 1000000000;
+    _time.tv_sec++;
+  }
+}
+
+static inline int64_t toNs(const timespec &_time) {
+  return static_cast<int64_t>(_time.tv_sec) * 1000000000 + _time.tv_nsec;
+}
+
+bool PeriodicThread::start(const Realtime_options &_options,
+                           std::function<void()> _setup,
+                           std::function<void(double)> _tick,
+                           std::string &_error) {
+  stop();
+
+  _error.clear();
+  bool success = true;
+  if (_options.lock_memory) {
+    success = lockProcessMemory(_error);
+  }
+
+  std::promise<std::string> configured;
+  std::future<std::string> configuration_error = configured.get_future();
+  running_.store(true, std::memory_order_release);
+  thread_ = std::thread([this, _options, configured = std::move(configured),
+                         _setup = std::move(_setup), _tick = std::move(_tick)]() mutable {
+    std::string error;
+    setCurrentThreadRealtime(_options.priority, _options.cpu, error);
+    prefaultStack(_options.prefault_stack);
+    if (_setup) {
+      _setup();
+    }
+    configured.set_value(error);
+    run(_options, _tick);
+  });
+
+  const std::string thread_error = configuration_error.get();
+  _error += thread_error;
+  return success && thread_error.empty();
+}
+
+void PeriodicThread::run(const Realtime_options &_options,
+                         const std::function<void(double)> &_tick) {
+  const int64_t period_ns = static_cast<int64_t>(1e9 / _options.rate);
+
+  timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  int64_t previous_ns = toNs(deadline);
+  while (running_.load(std::memory_order_acquire)) {
+    addNs(deadline, period_ns);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t now_ns = toNs(now);
+    _tick((now_ns - previous_ns) * 1e-9);
+    previous_ns = now_ns;
+    ticks_.fetch_add(1, std::memory_order_relaxed);
+
+    // Missed the next deadline, start again from now instead of ticking back to back
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (toNs(now) > toNs(deadline) + period_ns) {
+      overruns_.fetch_add(1, std::memory_order_relaxed);
+      deadline = now;
+    }
+  }
+}
+
+void PeriodicThread::stop() {
+  running_.store(false, std::memory_order_release);
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,89 @@
+/*!*******************************************************************************************
+ *  \file       shm_seqlock_slot.cpp
+ *  \brief      Seqlock slot of 64 bit words in POSIX shared memory, shared by the mailbox and standby.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "shm_seqlock_slot.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace controller_plugin_differential_flatness {
+
+void *mapSharedSegment(const std::string &_name,
+                       std::size_t _size,
+                       bool _writable,
+                       std::string &_error) {
+  const int fd = _writable ? shm_open(_name.c_str(), O_RDWR | O_CREAT, 0660)
+                           : shm_open(_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    _error = "shm_open " + _name + ": " + std::strerror(errno);
+    return nullptr;
+  }
+  // A segment left by a previous writer keeps its size and contents
+  if (_writable && ftruncate(fd, _size) != 0) {
+    _error = "ftruncate " + _name + ": " + std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+  struct stat info;
+  if (!_writable && (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(_size))) {
+    _error = _name + " is smaller than its layout";
+    ::close(fd);
+    return nullptr;
+  }
+  void *map = mmap(nullptr, _size, _writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd,
+                   0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    _error = "mmap " + _name + ": " + std::strerror(errno);
+    return nullptr;
+  }
+  return map;
+}
+
+void unmapSharedSegment(const void *_map, std::size_t _size) {
+  munmap(const_cast<void *>(_map), _size);
+}
+
+bool removeSharedSegment(const std::string &_name) {
+  return shm_unlink(_name.c_str()) == 0;
+}
+
+};  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,110 @@
+/*!*******************************************************************************************
+ *  \file       thread_pool.cpp
+ *  \brief      Fixed size thread pool for offline tools.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace controller_plugin_differential_flatness {
+
+ThreadPool::ThreadPool(std::size_t _threads) {
+  if (_threads == 0) {
+    _threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // The calling thread also runs tasks
+  for (std::size_t i = 1; i < _threads; i++) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::runTasks() {
+  for (std::size_t i = next_index_++; i < task_count_; i = next_index_++) {
+    (*task_)(i);
+  }
+}
+
+void ThreadPool::workerLoop() {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+
+    runTasks();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--running_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::parallelFor(std::size_t _count, const std::function<void(std::size_t)> &_task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_       = &_task;
+    task_count_ = _count;
+    next_index_ = 0;
+    running_    = workers_.size();
+    generation_++;
+  }
+  start_cv_.notify_all();
+
+  runTasks();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [&]() { return running_ == 0; });
+  task_ = nullptr;
+}
+
+};  // namespace controller_plugin_differential_flatness
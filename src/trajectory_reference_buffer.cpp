@@ -0,0 +1,113 @@
+/*!*******************************************************************************************
+ *  \file       trajectory_reference_buffer.cpp
+ *  \brief      Time-indexed trajectory reference buffer with interpolation.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "trajectory_reference_buffer.hpp"
+
+#include <cmath>
+
+namespace controller_plugin_differential_flatness {
+
+void TrajectoryReferenceBuffer::push(const Timed_reference &_point) {
+  // Replan, drop the stored future from the new point on
+  while (size_ > 0 && at(size_ - 1).stamp >= _point.stamp) {
+    size_--;
+  }
+
+  if (size_ == capacity) {
+    head_ = (head_ + 1) % capacity;
+    size_--;
+  }
+  points_[(head_ + size_) % capacity] = _point;
+  size_++;
+}
+
+bool TrajectoryReferenceBuffer::sample(const double &_t, UAV_reference &_reference) const {
+  if (size_ == 0) {
+    return false;
+  }
+  if (_t <= at(0).stamp) {
+    _reference = at(0).reference;
+    return true;
+  }
+  if (_t >= at(size_ - 1).stamp) {
+    _reference = at(size_ - 1).reference;
+    return true;
+  }
+
+  // Last point with stamp <= _t
+  std::size_t low  = 0;
+  std::size_t high = size_ - 1;
+  while (high - low > 1) {
+    const std::size_t mid = (low + high) / 2;
+    if (at(mid).stamp <= _t) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+
+  const UAV_reference &p0 = at(low).reference;
+  const UAV_reference &p1 = at(high).reference;
+  const double h          = at(high).stamp - at(low).stamp;
+  const double s          = (_t - at(low).stamp) / h;
+
+  // Cubic Hermite basis
+  const double s2  = s * s;
+  const double s3  = s2 * s;
+  const double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+  const double h10 = s3 - 2.0 * s2 + s;
+  const double h01 = -2.0 * s3 + 3.0 * s2;
+  const double h11 = s3 - s2;
+
+  _reference.position =
+      h00 * p0.position + h10 * h * p0.velocity + h01 * p1.position + h11 * h * p1.velocity;
+  _reference.velocity     = p0.velocity + s * (p1.velocity - p0.velocity);
+  _reference.acceleration = p0.acceleration + s * (p1.acceleration - p0.acceleration);
+
+  const double yaw_diff = std::remainder(p1.yaw - p0.yaw, 2.0 * M_PI);
+  _reference.yaw        = std::remainder(p0.yaw + s * yaw_diff, 2.0 * M_PI);
+  return true;
+}
+
+void TrajectoryReferenceBuffer::discardBefore(const double &_t) {
+  while (size_ > 1 && at(1).stamp <= _t) {
+    head_ = (head_ + 1) % capacity;
+    size_--;
+  }
+}
+
+}  // namespace controller_plugin_differential_flatness
@@ -0,0 +1,132 @@
+/*!*******************************************************************************************
+ *  \file       trajectory_segment_store.cpp
+ *  \brief      Preallocated store of polynomial trajectory segments.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include "trajectory_segment_store.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace controller_plugin_differential_flatness {
+
+bool parseTrajectorySegment(const double *_record, Trajectory_segment &_segment) {
+  for (std::size_t i = 0; i < segment_record_size; i++) {
+    if (!std::isfinite(_record[i])) {
+      return false;
+    }
+  }
+  if (_record[1] <= 0.0) {
+    return false;
+  }
+
+  _segment.start    = _record[0];
+  _segment.duration = _record[1];
+  _segment.coefficients =
+      Eigen::Map<const Eigen::Matrix<double, 4, segment_coefficient_count, Eigen::RowMajor>>(
+          _record + 2);
+  return true;
+}
+
+void evaluateTrajectorySegment(const Trajectory_segment &_segment,
+                               const double &_t,
+                               UAV_reference &_reference) {
+  const double tau = std::min(std::max(_t - _segment.start, 0.0), _segment.duration);
+  const auto &c    = _segment.coefficients;
+
+  // Horner's scheme for the polynomial and its first two derivatives at once
+  Eigen::Vector4d p = c.col(segment_coefficient_count - 1);
+  Eigen::Vector4d v = Eigen::Vector4d::Zero();
+  Eigen::Vector4d a = Eigen::Vector4d::Zero();
+  for (std::size_t k = segment_coefficient_count - 1; k-- > 0;) {
+    a = a * tau + 2.0 * v;
+    v = v * tau + p;
+    p = p * tau + c.col(k);
+  }
+
+  _reference.position     = p.head<3>();
+  _reference.velocity     = v.head<3>();
+  _reference.acceleration = a.head<3>();
+  _reference.yaw          = std::remainder(p(3), 2.0 * M_PI);
+}
+
+void TrajectorySegmentStore::push(const Trajectory_segment &_segment) {
+  // Replan, drop the stored future from the new segment on
+  while (size_ > 0 && at(size_ - 1).start >= _segment.start) {
+    size_--;
+  }
+
+  if (size_ == capacity) {
+    head_ = (head_ + 1) % capacity;
+    size_--;
+  }
+  at(size_) = _segment;
+  size_++;
+}
+
+bool TrajectorySegmentStore::sample(const double &_t, UAV_reference &_reference) const {
+  if (size_ == 0) {
+    return false;
+  }
+
+  // Last segment with start <= _t, or the first one
+  std::size_t low  = 0;
+  std::size_t high = size_;
+  while (high - low > 1) {
+    const std::size_t mid = (low + high) / 2;
+    if (at(mid).start <= _t) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+
+  const Trajectory_segment &segment = at(low);
+  evaluateTrajectorySegment(segment, _t, _reference);
+  if (_t > segment.start + segment.duration) {
+    _reference.velocity.setZero();
+    _reference.acceleration.setZero();
+  }
+  return true;
+}
+
+void TrajectorySegmentStore::discardBefore(const double &_t) {
+  while (size_ > 1 && at(1).start <= _t) {
+    head_ = (head_ + 1) % capacity;
+    size_--;
+  }
+}
+
+}  // namespace controller_plugin_differential_flatness
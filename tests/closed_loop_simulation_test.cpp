@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "DF_control_law.hpp"
+#include "closed_loop_simulation.hpp"
+#include "quadrotor_plant.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+DF_gains defaultGains() {
+  DF_gains gains;
+  gains.mass              = 0.82;
+  gains.antiwindup_cte    = 1.0;
+  gains.Kp.diagonal()     = Eigen::Vector3d(6.0, 6.0, 6.0);
+  gains.Ki.diagonal()     = Eigen::Vector3d(0.005, 0.005, 0.065);
+  gains.Kd.diagonal()     = Eigen::Vector3d(1.5, 1.5, 3.0);
+  gains.Kp_ang.diagonal() = Eigen::Vector3d(5.5, 5.5, 2.0);
+  return gains;
+}
+
+}  // namespace
+
+TEST(QuadrotorPlant, HoverIsAnEquilibrium) {
+  QuadrotorPlant plant;
+  plant.resetHover(Eigen::Vector3d(1.0, 2.0, 3.0), 0.3);
+
+  Acro_command hover;
+  hover.thrust = plant.getParams().mass * 9.81;
+  for (int i = 0; i < 1000; i++) {
+    plant.step(hover, 0.001);
+  }
+  EXPECT_LT((plant.getState().position - Eigen::Vector3d(1.0, 2.0, 3.0)).norm(), 1e-9);
+  EXPECT_LT(plant.getState().velocity.norm(), 1e-9);
+}
+
+TEST(QuadrotorPlant, FallsWithoutThrustAndFollowsRates) {
+  QuadrotorPlant plant;
+  plant.resetHover(Eigen::Vector3d::Zero(), 0.0);
+
+  Acro_command command;
+  command.PQR = Eigen::Vector3d(0.0, 0.0, 1.0);
+  for (int i = 0; i < 1000; i++) {
+    plant.step(command, 0.001);
+  }
+  // Thrust decays with a 20 ms time constant, so the fall is slightly less than free fall
+  EXPECT_NEAR(plant.getState().velocity.z(), -9.81, 0.25);
+  EXPECT_NEAR(plant.getState().body_rates.z(), 1.0, 1e-9);
+}
+
+TEST(ClosedLoopSimulation, DefaultGainsTrackEveryTrajectory) {
+  for (const char *name : {"step", "circle", "lemniscate"}) {
+    Simulation_options options;
+    ASSERT_TRUE(parseReferenceTrajectory(name, options.trajectory));
+
+    DFControlLawVariant law{DFControlLaw(defaultGains())};
+    const Tracking_metrics metrics = simulateClosedLoop(law, options);
+    EXPECT_FALSE(metrics.diverged) << name;
+    EXPECT_EQ(metrics.ticks, 2000u) << name;
+    EXPECT_LT(metrics.max_position_error, 2.0) << name;
+    EXPECT_LT(metrics.rms_position_error, 0.5) << name;
+  }
+}
+
+TEST(ClosedLoopSimulation, RunsAreDeterministic) {
+  Simulation_options options;
+  options.trajectory = Reference_trajectory::lemniscate;
+  options.mass_scale = 1.2;
+
+  DFControlLawVariant first{DFControlLaw(defaultGains())};
+  DFControlLawVariant second{DFControlLaw(defaultGains())};
+  const Tracking_metrics a = simulateClosedLoop(first, options);
+  const Tracking_metrics b = simulateClosedLoop(second, options);
+  EXPECT_EQ(a.rms_position_error, b.rms_position_error);
+  EXPECT_EQ(a.max_tilt, b.max_tilt);
+}
+
+TEST(ClosedLoopSimulation, UnstableGainsAreReportedAsDiverged) {
+  DF_gains gains      = defaultGains();
+  gains.Kd.diagonal() = Eigen::Vector3d(-3.0, -3.0, -3.0);
+  DFControlLawVariant law{DFControlLaw(gains)};
+
+  Simulation_options options;
+  options.trajectory = Reference_trajectory::step;
+  EXPECT_TRUE(simulateClosedLoop(law, options).diverged);
+}
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "command_mailbox.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+std::string mailboxName(const std::string &_test) {
+  return "/df_mailbox_test_" + _test + "_" + std::to_string(getpid());
+}
+
+/* Every field derived from i, so a torn read shows as a mismatch */
+Acro_command numberedCommand(uint64_t _i) {
+  Acro_command command;
+  command.thrust = static_cast<double>(_i);
+  command.PQR    = Eigen::Vector3d(_i, -static_cast<double>(_i), 2.0 * _i);
+  return command;
+}
+
+bool isConsistent(const Mailbox_command &_command) {
+  const double i = _command.command.thrust;
+  return _command.stamp_ns == static_cast<int64_t>(i) && _command.command.PQR.x() == i &&
+         _command.command.PQR.y() == -i && _command.command.PQR.z() == 2.0 * i;
+}
+
+}  // namespace
+
+TEST(CommandMailbox, ReaderSeesTheLastCommand) {
+  const std::string name = mailboxName("last");
+  CommandMailboxWriter writer;
+  std::string error;
+  ASSERT_TRUE(writer.open(name, error)) << error;
+
+  CommandMailboxReader reader;
+  ASSERT_TRUE(reader.open(name, error)) << error;
+  Mailbox_command command;
+  EXPECT_EQ(reader.sequence(), 0u);
+  EXPECT_FALSE(reader.read(command));
+
+  for (uint64_t i = 1; i <= 3; i++) {
+    ASSERT_TRUE(writer.write(numberedCommand(10 * i), 10 * i));
+  }
+  EXPECT_EQ(reader.sequence(), 3u);
+  ASSERT_TRUE(reader.read(command));
+  EXPECT_EQ(command.sequence, 3u);
+  EXPECT_EQ(command.stamp_ns, 30);
+  EXPECT_EQ(command.command.thrust, 30.0);
+  EXPECT_EQ(command.command.PQR, Eigen::Vector3d(30.0, -30.0, 60.0));
+
+  writer.close();
+  EXPECT_FALSE(writer.write(numberedCommand(40), 40));
+  EXPECT_TRUE(CommandMailboxWriter::remove(name));
+}
+
+TEST(CommandMailbox, ReaderNeedsAWriter) {
+  CommandMailboxReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.open(mailboxName("missing"), error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_EQ(reader.sequence(), 0u);
+}
+
+TEST(CommandMailbox, RestartedWriterKeepsTheSequence) {
+  const std::string name = mailboxName("restart");
+  std::string error;
+  CommandMailboxReader reader;
+  {
+    CommandMailboxWriter writer;
+    ASSERT_TRUE(writer.open(name, error)) << error;
+    ASSERT_TRUE(reader.open(name, error)) << error;
+    ASSERT_TRUE(writer.write(numberedCommand(1), 1));
+    ASSERT_TRUE(writer.write(numberedCommand(2), 2));
+  }
+
+  CommandMailboxWriter writer;
+  ASSERT_TRUE(writer.open(name, error)) << error;
+  ASSERT_TRUE(writer.write(numberedCommand(3), 3));
+
+  // Attached before the restart and still on the same segment
+  Mailbox_command command;
+  ASSERT_TRUE(reader.read(command));
+  EXPECT_EQ(command.sequence, 3u);
+  EXPECT_TRUE(isConsistent(command));
+  EXPECT_TRUE(CommandMailboxWriter::remove(name));
+}
+
+TEST(CommandMailbox, ConcurrentReaderNeverSeesATornCommand) {
+  const std::string name = mailboxName("threads");
+  CommandMailboxWriter writer;
+  std::string error;
+  ASSERT_TRUE(writer.open(name, error)) << error;
+  CommandMailboxReader reader;
+  ASSERT_TRUE(reader.open(name, error)) << error;
+
+  const uint64_t n_commands = 100000;
+  std::atomic<bool> consistent{true};
+  std::thread reading([&]() {
+    uint64_t last_sequence = 0;
+    Mailbox_command command;
+    while (last_sequence < n_commands) {
+      if (!reader.read(command)) {
+        continue;
+      }
+      if (!isConsistent(command) || command.sequence < last_sequence ||
+          command.command.thrust != static_cast<double>(command.sequence)) {
+        consistent = false;
+        return;
+      }
+      last_sequence = command.sequence;
+    }
+  });
+
+  for (uint64_t i = 1; i <= n_commands; i++) {
+    ASSERT_TRUE(writer.write(numberedCommand(i), i));
+  }
+  reading.join();
+  EXPECT_TRUE(consistent);
+  EXPECT_TRUE(CommandMailboxWriter::remove(name));
+}
+
+TEST(CommandMailbox, CloseWaitsForWritesInProgress) {
+  const std::string name = mailboxName("close");
+  CommandMailboxWriter writer;
+  std::string error;
+  ASSERT_TRUE(writer.open(name, error)) << error;
+
+  std::atomic<bool> done{false};
+  std::thread writing([&]() {
+    for (uint64_t i = 1; !done; i++) {
+      writer.write(numberedCommand(i), i);
+    }
+  });
+  for (int i = 0; i < 100; i++) {
+    writer.close();
+    ASSERT_TRUE(writer.open(name, error)) << error;
+  }
+  done = true;
+  writing.join();
+  EXPECT_TRUE(CommandMailboxWriter::remove(name));
+}
+
+TEST(CommandMailbox, ReaderInAnotherProcess) {
+  const std::string name = mailboxName("process");
+  CommandMailboxWriter writer;
+  std::string error;
+  ASSERT_TRUE(writer.open(name, error)) << error;
+
+  const uint64_t n_commands = 100000;
+  const pid_t child         = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    // Only async-signal-safe calls and the mailbox itself until _exit
+    CommandMailboxReader reader;
+    std::string child_error;
+    if (!reader.open(name, child_error)) {
+      _exit(2);
+    }
+    uint64_t last_sequence = 0;
+    Mailbox_command command;
+    while (last_sequence < n_commands) {
+      if (!reader.read(command)) {
+        continue;
+      }
+      if (!isConsistent(command) || command.sequence < last_sequence) {
+        _exit(1);
+      }
+      last_sequence = command.sequence;
+    }
+    _exit(0);
+  }
+
+  for (uint64_t i = 1; i <= n_commands; i++) {
+    ASSERT_TRUE(writer.write(numberedCommand(i), i));
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  EXPECT_TRUE(CommandMailboxWriter::remove(name));
+}
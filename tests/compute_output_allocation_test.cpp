@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "plugin_test_fixture.hpp"
+
+/* Heap allocations made by this thread while counting is on. ROS middleware threads are not
+ * counted */
+static thread_local bool counting_allocations = false;
+static thread_local std::size_t allocation_count = 0;
+
+void *operator new(std::size_t _size) {
+  if (counting_allocations) {
+    allocation_count++;
+  }
+  if (void *ptr = std::malloc(_size ? _size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t _size) { return operator new(_size); }
+void operator delete(void *_ptr) noexcept { std::free(_ptr); }
+void operator delete[](void *_ptr) noexcept { std::free(_ptr); }
+void operator delete(void *_ptr, std::size_t) noexcept { std::free(_ptr); }
+void operator delete[](void *_ptr, std::size_t) noexcept { std::free(_ptr); }
+
+namespace {
+
+class ComputeOutputAllocation : public PluginFixture {
+protected:
+  /* Allocations made by one computeOutput call once the outputs and the law are in place */
+  std::size_t steadyStateAllocations() {
+    for (int i = 0; i < 10; i++) {
+      feedInputs();
+      EXPECT_TRUE(plugin_->computeOutput(0.01, pose_, twist_, thrust_));
+    }
+    feedInputs();
+
+    allocation_count     = 0;
+    counting_allocations = true;
+    const bool output    = plugin_->computeOutput(0.01, pose_, twist_, thrust_);
+    counting_allocations = false;
+    EXPECT_TRUE(output);
+    return allocation_count;
+  }
+};
+
+}  // namespace
+
+TEST_F(ComputeOutputAllocation, SteadyStateTickDoesNotAllocate) {
+  EXPECT_EQ(steadyStateAllocations(), 0u);
+  EXPECT_EQ(twist_.header.frame_id, thrust_.header.frame_id);
+  EXPECT_EQ(rclcpp::Time(twist_.header.stamp), rclcpp::Time(thrust_.header.stamp));
+}
+
+TEST_F(ComputeOutputAllocation, MissingStateIsReportedWithoutAllocating) {
+  allocation_count     = 0;
+  counting_allocations = true;
+  for (int i = 0; i < 100; i++) {
+    EXPECT_FALSE(plugin_->computeOutput(0.01, pose_, twist_, thrust_));
+  }
+  counting_allocations = false;
+  EXPECT_EQ(allocation_count, 0u);
+  EXPECT_EQ(plugin_->getHealthEvents(df::Health_event::state_not_received), 100u);
+}
+
+TEST_F(ComputeOutputAllocation, OptionalStagesDoNotAllocate) {
+  plugin_->parametersCallback({
+      rclcpp::Parameter("trajectory_control.latency.enabled", true),
+      rclcpp::Parameter("trajectory_control.state_prediction.enabled", true),
+      rclcpp::Parameter("trajectory_control.reference_buffer.enabled", true),
+      rclcpp::Parameter("trajectory_control.reference_buffer.lookahead", 0.02),
+  });
+  EXPECT_EQ(steadyStateAllocations(), 0u);
+}
+
+TEST_F(ComputeOutputAllocation, OdometryStateDoesNotAllocate) {
+  steadyStateAllocations();
+  nav_msgs::msg::Odometry odometry;
+  odometry.header.frame_id         = plugin_->getDesiredPoseFrameId();
+  odometry.header.stamp            = node_->now();
+  odometry.child_frame_id          = plugin_->getDesiredTwistFrameId();
+  odometry.pose.pose.position.z    = 1.0;
+  odometry.pose.pose.orientation.w = 1.0;
+
+  allocation_count     = 0;
+  counting_allocations = true;
+  plugin_->updateOdometry(odometry);
+  const bool output    = plugin_->computeOutput(0.01, pose_, twist_, thrust_);
+  counting_allocations = false;
+  EXPECT_TRUE(output);
+  EXPECT_EQ(allocation_count, 0u);
+
+  // Rejected for its frame, counted and not logged
+  odometry.header.frame_id = "earth";
+  allocation_count         = 0;
+  counting_allocations     = true;
+  plugin_->updateOdometry(odometry);
+  counting_allocations = false;
+  EXPECT_EQ(allocation_count, 0u);
+  EXPECT_EQ(plugin_->getRejectedStates(), 1u);
+}
+
+TEST_F(ComputeOutputAllocation, StandbyPrimaryDoesNotAllocate) {
+  const std::string channel = "/df_allocation_test_standby";
+  plugin_->parametersCallback({
+      rclcpp::Parameter("trajectory_control.standby.role", "primary"),
+      rclcpp::Parameter("trajectory_control.standby.channel", channel),
+  });
+  EXPECT_EQ(steadyStateAllocations(), 0u);
+
+  df::SnapshotChannelReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.open(channel, error)) << error;
+  df::Controller_snapshot snapshot;
+  uint64_t sequence = 0;
+  ASSERT_TRUE(reader.read(snapshot, sequence));
+  EXPECT_GE(sequence, 11u);
+  EXPECT_EQ(snapshot.command.thrust, plugin_->takeSnapshot().command.thrust);
+  df::SnapshotChannelWriter::remove(channel);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "DF_control_law.hpp"
+#include "DF_control_law_batch.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+constexpr std::size_t n_vehicles = 103;  // not a multiple of the SIMD width
+constexpr double dt              = 0.01;
+
+/* _zero_ki leaves Ki and antiwindup_cte at their DF_gains defaults of 0, so the anti-windup bound
+ * is 0 / 0 */
+DF_gains randomGains(std::mt19937 &gen, bool _zero_ki) {
+  std::uniform_real_distribution<double> gain(0.5, 8.0);
+  std::uniform_real_distribution<double> ki(0.001, 0.1);
+  DF_gains gains;
+  gains.mass          = std::uniform_real_distribution<double>(0.5, 2.0)(gen);
+  gains.Kp.diagonal() = Eigen::Vector3d(gain(gen), gain(gen), gain(gen));
+  if (!_zero_ki) {
+    gains.antiwindup_cte = 1.0;
+    gains.Ki.diagonal()  = Eigen::Vector3d(ki(gen), ki(gen), ki(gen));
+  }
+  gains.Kd.diagonal()     = Eigen::Vector3d(gain(gen), gain(gen), gain(gen));
+  gains.Kp_ang.diagonal() = Eigen::Vector3d(gain(gen), gain(gen), gain(gen));
+  return gains;
+}
+
+struct Vehicle {
+  DFControlLaw law;
+  Eigen::Vector3d position, velocity;
+  Eigen::Quaterniond attitude;
+  UAV_reference reference;
+};
+
+void fillBatch(DF_batch &batch, std::vector<Vehicle> &vehicles, std::mt19937 &gen) {
+  std::uniform_real_distribution<double> u(-3.0, 3.0);
+  for (std::size_t i = 0; i < vehicles.size(); i++) {
+    Vehicle &v = vehicles[i];
+    v.position = Eigen::Vector3d(u(gen), u(gen), u(gen));
+    v.velocity = Eigen::Vector3d(u(gen), u(gen), u(gen));
+    v.attitude = Eigen::Quaterniond(Eigen::Vector4d(u(gen), u(gen), u(gen), u(gen))).normalized();
+    v.reference.position     = Eigen::Vector3d(u(gen), u(gen), u(gen));
+    v.reference.velocity     = Eigen::Vector3d(u(gen), u(gen), u(gen));
+    v.reference.acceleration = Eigen::Vector3d(u(gen), u(gen), u(gen));
+    v.reference.yaw          = u(gen);
+
+    batch.position.x[i]         = v.position.x();
+    batch.position.y[i]         = v.position.y();
+    batch.position.z[i]         = v.position.z();
+    batch.velocity.x[i]         = v.velocity.x();
+    batch.velocity.y[i]         = v.velocity.y();
+    batch.velocity.z[i]         = v.velocity.z();
+    batch.attitude.w[i]         = v.attitude.w();
+    batch.attitude.x[i]         = v.attitude.x();
+    batch.attitude.y[i]         = v.attitude.y();
+    batch.attitude.z[i]         = v.attitude.z();
+    batch.ref_position.x[i]     = v.reference.position.x();
+    batch.ref_position.y[i]     = v.reference.position.y();
+    batch.ref_position.z[i]     = v.reference.position.z();
+    batch.ref_velocity.x[i]     = v.reference.velocity.x();
+    batch.ref_velocity.y[i]     = v.reference.velocity.y();
+    batch.ref_velocity.z[i]     = v.reference.velocity.z();
+    batch.ref_acceleration.x[i] = v.reference.acceleration.x();
+    batch.ref_acceleration.y[i] = v.reference.acceleration.y();
+    batch.ref_acceleration.z[i] = v.reference.acceleration.z();
+    batch.ref_yaw[i]            = v.reference.yaw;
+  }
+}
+
+void expectMatchesPerVehicle(void (*kernel)(DF_batch &, const double &, std::size_t, std::size_t)) {
+  std::mt19937 gen(42);
+  std::vector<Vehicle> vehicles(n_vehicles);
+  DF_batch batch;
+  batch.resize(n_vehicles);
+  for (std::size_t i = 0; i < n_vehicles; i++) {
+    const DF_gains gains = randomGains(gen, i % 5 == 0);
+    vehicles[i].law.setGains(gains);
+    batch.setGains(i, gains);
+  }
+
+  // Several ticks so the integrator is carried between calls
+  for (int tick = 0; tick < 20; tick++) {
+    fillBatch(batch, vehicles, gen);
+    kernel(batch, dt, 0, n_vehicles);
+
+    for (std::size_t i = 0; i < n_vehicles; i++) {
+      Vehicle &v             = vehicles[i];
+      const Acro_command ref = v.law.computeTrajectoryControl(
+          dt, v.position, v.velocity, v.attitude.toRotationMatrix(), v.reference.position,
+          v.reference.velocity, v.reference.acceleration, v.reference.yaw);
+      const Acro_command out = batch.getCommand(i);
+
+      ASSERT_TRUE(std::isfinite(ref.thrust)) << i;
+      EXPECT_NEAR(out.thrust, ref.thrust, 1e-5 * (1.0 + std::abs(ref.thrust))) << i;
+      EXPECT_LT((out.PQR - ref.PQR).norm(), 1e-9 * (1.0 + ref.PQR.norm()));
+      EXPECT_LT((Eigen::Vector3d(batch.accum_pos_error.x[i], batch.accum_pos_error.y[i],
+                                 batch.accum_pos_error.z[i]) -
+                 v.law.getIntegral())
+                    .norm(),
+                1e-12);
+    }
+  }
+}
+
+}  // namespace
+
+TEST(DFControlLawBatch, ScalarKernelMatchesPerVehicleLaw) {
+  expectMatchesPerVehicle(&computeTrajectoryControlBatchScalar);
+}
+
+TEST(DFControlLawBatch, DispatchedKernelMatchesPerVehicleLaw) {
+  expectMatchesPerVehicle(
+      [](DF_batch &batch, const double &_dt, std::size_t begin, std::size_t end) {
+        computeTrajectoryControlBatch(batch, _dt, begin, end);
+      });
+}
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "DF_control_law.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+DF_gains defaultGains() {
+  DF_gains gains;
+  gains.mass              = 0.82;
+  gains.antiwindup_cte    = 1.0;
+  gains.Kp.diagonal()     = Eigen::Vector3d(6.0, 6.0, 6.0);
+  gains.Ki.diagonal()     = Eigen::Vector3d(0.005, 0.005, 0.065);
+  gains.Kd.diagonal()     = Eigen::Vector3d(1.5, 1.5, 3.0);
+  gains.Kp_ang.diagonal() = Eigen::Vector3d(5.5, 5.5, 2.0);
+  return gains;
+}
+
+}  // namespace
+
+TEST(DFControlLaw, HoverAtReferenceCompensatesGravity) {
+  DFControlLaw law(defaultGains());
+
+  const Eigen::Vector3d position(1.0, -2.0, 3.0);
+  const Acro_command cmd = law.computeTrajectoryControl(
+      0.01, position, Eigen::Vector3d::Zero(), Eigen::Matrix3d::Identity(), position,
+      Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), 0.0);
+
+  EXPECT_NEAR(cmd.thrust, 0.82 * 9.81, 1e-5);
+  EXPECT_NEAR(cmd.PQR.norm(), 0.0, 1e-12);
+}
+
+TEST(DFControlLaw, YawErrorProducesYawRate) {
+  DFControlLaw law(defaultGains());
+
+  const Acro_command cmd = law.computeTrajectoryControl(
+      0.01, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), Eigen::Matrix3d::Identity(),
+      Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), 0.5);
+
+  EXPECT_GT(cmd.PQR.z(), 0.0);
+  EXPECT_NEAR(cmd.PQR.x(), 0.0, 1e-12);
+  EXPECT_NEAR(cmd.PQR.y(), 0.0, 1e-12);
+}
+
+TEST(DFControlLaw, IntegralIsClampedByAntiwindup) {
+  DFControlLaw law(defaultGains());
+
+  for (int i = 0; i < 10000; i++) {
+    law.getForce(0.01, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(),
+                 Eigen::Vector3d(10.0, 10.0, 10.0), Eigen::Vector3d::Zero(),
+                 Eigen::Vector3d::Zero());
+  }
+
+  EXPECT_NEAR(law.getIntegral().x(), 1.0 / 0.005, 1e-9);
+  EXPECT_NEAR(law.getIntegral().z(), 1.0 / 0.065, 1e-9);
+
+  law.resetIntegral();
+  EXPECT_EQ(law.getIntegral(), Eigen::Vector3d::Zero());
+}
+
+TEST(DFControlLaw, GainSetPrecomputesAntiwindupBounds) {
+  const DF_gain_set gain_set = makeGainSet(defaultGains(), 0.1);
+  EXPECT_NEAR(gain_set.antiwindup_bound.x(), 1.0 / 0.005, 1e-9);
+  EXPECT_NEAR(gain_set.antiwindup_bound.z(), 1.0 / 0.065, 1e-9);
+  EXPECT_EQ(gain_set.alpha, 0.1);
+
+  DFControlLaw from_gains(defaultGains());
+  DFControlLaw from_gain_set;
+  from_gain_set.setGains(gain_set);
+  for (int i = 0; i < 10000; i++) {
+    const Eigen::Vector3d position(10.0, 10.0, 10.0);
+    const Eigen::Vector3d a = from_gains.getForce(0.01, Eigen::Vector3d::Zero(),
+                                                  Eigen::Vector3d::Zero(), position,
+                                                  Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+    const Eigen::Vector3d b = from_gain_set.getForce(
+        0.01, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), position, Eigen::Vector3d::Zero(),
+        Eigen::Vector3d::Zero());
+    ASSERT_EQ(a, b);
+  }
+}
+
+TEST(DFControlLaw, DesiredAttitudeIsOrthonormal) {
+  const Eigen::Matrix3d R_des =
+      DFControlLaw::computeDesiredAttitude(Eigen::Vector3d(1.0, -0.5, 9.0), 1.2);
+
+  EXPECT_TRUE((R_des.transpose() * R_des).isIdentity(1e-12));
+  EXPECT_NEAR(R_des.determinant(), 1.0, 1e-12);
+}
+
+TEST(DFControlLaw, PrecomputedReferenceTermsAgreeWithTheFullLaw) {
+  DFControlLaw full(defaultGains());
+  DFControlLaw precomputed(defaultGains());
+
+  const Eigen::Vector3d ref_position(1.0, 0.5, 1.5);
+  const Eigen::Vector3d ref_velocity(0.4, 0.0, 0.1);
+  const Eigen::Vector3d ref_acceleration(0.3, -0.2, 0.5);
+  const double yaw = 0.7;
+  const Eigen::Vector3d specific_force = ref_acceleration + Eigen::Vector3d(0.0, 0.0, 9.81);
+  const Eigen::Vector3d heading(std::cos(yaw), std::sin(yaw), 0.0);
+
+  for (int i = 0; i < 100; i++) {
+    const Eigen::Vector3d position(0.01 * i, -0.5, 1.0);
+    const Eigen::Vector3d velocity(0.2, 0.0, -0.1);
+    const Eigen::Vector3d a =
+        full.getForce(0.01, position, velocity, ref_position, ref_velocity, ref_acceleration);
+    const Eigen::Vector3d b = precomputed.getForceFeedforward(0.01, position, velocity,
+                                                              ref_position, ref_velocity,
+                                                              specific_force);
+    ASSERT_LT((a - b).norm(), 1e-12);
+
+    // Only the direction of the heading matters
+    EXPECT_EQ(DFControlLaw::computeDesiredAttitude(a, yaw),
+              DFControlLaw::computeDesiredAttitudeFromHeading(a, heading));
+    EXPECT_TRUE(DFControlLaw::computeDesiredAttitude(a, yaw).isApprox(
+        DFControlLaw::computeDesiredAttitudeFromHeading(a, 0.5 * heading), 1e-12));
+  }
+}
+
+TEST(DFControlLaw, PolicyVariantsAgreeWithReferenceLaw) {
+  DFControlLaw reference(defaultGains());
+  DFControlLawT<double, DiagonalGains, ClampAntiwindup> diagonal(defaultGains());
+  DFControlLawT<float, DiagonalGains, ClampAntiwindup> single(defaultGains());
+
+  const Eigen::Matrix3d rot = Eigen::AngleAxisd(0.3, Eigen::Vector3d(1, 2, 3).normalized())
+                                  .toRotationMatrix();
+  for (int i = 0; i < 100; i++) {
+    const Eigen::Vector3d position(0.01 * i, -0.5, 1.0);
+    const Eigen::Vector3d velocity(0.2, 0.0, -0.1);
+    const Eigen::Vector3d ref_position(1.0, 0.5, 1.5);
+    const Eigen::Vector3d ref_acceleration(0.3, 0.0, 0.2);
+
+    const Acro_command a =
+        reference.computeTrajectoryControl(0.01, position, velocity, rot, ref_position,
+                                           Eigen::Vector3d::Zero(), ref_acceleration, 0.7);
+    const Acro_command b =
+        diagonal.computeTrajectoryControl(0.01, position, velocity, rot, ref_position,
+                                          Eigen::Vector3d::Zero(), ref_acceleration, 0.7);
+    const Acro_command c =
+        single.computeTrajectoryControl(0.01, position, velocity, rot, ref_position,
+                                        Eigen::Vector3d::Zero(), ref_acceleration, 0.7);
+
+    EXPECT_NEAR(a.thrust, b.thrust, 1e-6);
+    EXPECT_LT((a.PQR - b.PQR).norm(), 1e-12);
+    EXPECT_NEAR(a.thrust, c.thrust, 1e-4);
+    EXPECT_LT((a.PQR - c.PQR).norm(), 1e-4);
+  }
+}
+
+TEST(DFControlLaw, NoAntiwindupKeepsIntegrating) {
+  DFControlLawT<double, DiagonalGains, NoAntiwindup> law(defaultGains());
+
+  for (int i = 0; i < 10000; i++) {
+    law.getForce(0.01, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(),
+                 Eigen::Vector3d(10.0, 10.0, 10.0), Eigen::Vector3d::Zero(),
+                 Eigen::Vector3d::Zero());
+  }
+  EXPECT_NEAR(law.getIntegral().x(), 1000.0, 1e-6);
+}
+
+TEST(DFControlLaw, SelectLawKeepsGainsAndIntegral) {
+  DFControlLawVariant law{DFControlLaw(defaultGains())};
+  std::get<DFControlLaw>(law).setIntegral(Eigen::Vector3d(1.0, 2.0, 3.0));
+
+  ASSERT_TRUE(selectDFControlLaw("float", "diagonal", "clamp", law));
+  using Selected = DFControlLawT<float, DiagonalGains, ClampAntiwindup>;
+  ASSERT_TRUE(std::holds_alternative<Selected>(law));
+  EXPECT_EQ(std::get<Selected>(law).getGains().mass, 0.82);
+  EXPECT_EQ(std::get<Selected>(law).getIntegral(), Eigen::Vector3d(1.0, 2.0, 3.0));
+
+  EXPECT_FALSE(selectDFControlLaw("half", "diagonal", "clamp", law));
+  EXPECT_TRUE(std::holds_alternative<Selected>(law));
+}
@@ -0,0 +1,577 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "as2_core/node.hpp"
+#include "as2_core/utils/tf_utils.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+#include "DF_control_law.hpp"
+#include "DF_control_law_batch.hpp"
+#include "DF_controller_plugin.hpp"
+#include "command_mailbox.hpp"
+#include "controller_snapshot.hpp"
+#include "flight_recorder.hpp"
+#include "gain_schedule.hpp"
+#include "latency_histogram.hpp"
+#include "lookahead_cache.hpp"
+#include "state_predictor.hpp"
+#include "trajectory_segment_store.hpp"
+
+namespace df = controller_plugin_differential_flatness;
+
+/* Exposes the stages of computeOutput that are not part of the ControllerBase interface */
+class PluginUnderTest : public df::Plugin {
+public:
+  using Plugin::adoptControlLaw;
+  using Plugin::computeTrajectoryControl;
+  using Plugin::getOutput;
+  using Plugin::resetCommands;
+  using Plugin::updateDFParameter;
+};
+
+static std::shared_ptr<as2::Node> node_ptr;
+static std::shared_ptr<PluginUnderTest> plugin_ptr;
+
+static const std::vector<rclcpp::Parameter> default_parameters = {
+    rclcpp::Parameter("mass", 0.82),
+    rclcpp::Parameter("trajectory_control.antiwindup_cte", 1.0),
+    rclcpp::Parameter("trajectory_control.alpha", 0.1),
+    rclcpp::Parameter("trajectory_control.kp.x", 6.0),
+    rclcpp::Parameter("trajectory_control.kp.y", 6.0),
+    rclcpp::Parameter("trajectory_control.kp.z", 6.0),
+    rclcpp::Parameter("trajectory_control.ki.x", 0.005),
+    rclcpp::Parameter("trajectory_control.ki.y", 0.005),
+    rclcpp::Parameter("trajectory_control.ki.z", 0.065),
+    rclcpp::Parameter("trajectory_control.kd.x", 1.5),
+    rclcpp::Parameter("trajectory_control.kd.y", 1.5),
+    rclcpp::Parameter("trajectory_control.kd.z", 3.0),
+    rclcpp::Parameter("trajectory_control.roll_control.kp", 5.5),
+    rclcpp::Parameter("trajectory_control.pitch_control.kp", 5.5),
+    rclcpp::Parameter("trajectory_control.yaw_control.kp", 2.0),
+};
+
+static df::DF_gains defaultGains() {
+  df::DF_gains gains;
+  gains.mass              = 0.82;
+  gains.antiwindup_cte    = 1.0;
+  gains.Kp.diagonal()     = Eigen::Vector3d(6.0, 6.0, 6.0);
+  gains.Ki.diagonal()     = Eigen::Vector3d(0.005, 0.005, 0.065);
+  gains.Kd.diagonal()     = Eigen::Vector3d(1.5, 1.5, 3.0);
+  gains.Kp_ang.diagonal() = Eigen::Vector3d(5.5, 5.5, 2.0);
+  return gains;
+}
+
+static geometry_msgs::msg::PoseStamped makePose(double _yaw) {
+  geometry_msgs::msg::PoseStamped pose;
+  pose.header.frame_id    = plugin_ptr->getDesiredPoseFrameId();
+  pose.pose.position.x    = 0.1;
+  pose.pose.position.y    = -0.2;
+  pose.pose.position.z    = 1.0;
+  pose.pose.orientation.z = std::sin(_yaw / 2.0);
+  pose.pose.orientation.w = std::cos(_yaw / 2.0);
+  return pose;
+}
+
+static geometry_msgs::msg::TwistStamped makeTwist() {
+  geometry_msgs::msg::TwistStamped twist;
+  twist.header.frame_id = plugin_ptr->getDesiredTwistFrameId();
+  twist.twist.linear.x  = 0.5;
+  twist.twist.linear.y  = 0.1;
+  twist.twist.linear.z  = -0.05;
+  return twist;
+}
+
+static as2_msgs::msg::TrajectoryPoint makeReference(double _yaw) {
+  as2_msgs::msg::TrajectoryPoint ref;
+  ref.position.x     = 1.0;
+  ref.position.y     = 0.5;
+  ref.position.z     = 1.5;
+  ref.twist.x        = 0.4;
+  ref.acceleration.z = 0.2;
+  ref.yaw_angle      = _yaw;
+  return ref;
+}
+
+/* State and reference of the parameterized stages */
+struct Scenario {
+  Eigen::Vector3d pos{0.1, -0.2, 1.0};
+  Eigen::Vector3d vel{0.5, 0.1, -0.05};
+  Eigen::Vector3d pos_ref{1.0, 0.5, 1.5};
+  Eigen::Vector3d vel_ref{0.4, 0.0, 0.0};
+  Eigen::Vector3d acc_ref{0.0, 0.0, 0.2};
+};
+
+/* 0 nominal, 1 near free fall, 2 aggressive tilt. Near free fall tracks the reference exactly,
+ * so with a zero integral the desired force is mass * 1e-6 and its normalization near-singular */
+static Scenario makeScenario(int64_t _scenario) {
+  Scenario scenario;
+  switch (_scenario) {
+    case 1:
+      scenario.pos     = scenario.pos_ref;
+      scenario.vel     = scenario.vel_ref;
+      scenario.acc_ref = Eigen::Vector3d(0.0, 0.0, -9.81 + 1e-6);
+      break;
+    case 2:
+      scenario.acc_ref = Eigen::Vector3d(8.0, -6.0, 0.0);
+      break;
+    default:
+      break;
+  }
+  return scenario;
+}
+
+static void BM_COMPUTE_OUTPUT(benchmark::State &state) {
+  const double yaw = state.range(0) * M_PI / 180.0;
+  plugin_ptr->updateState(makePose(0.0), makeTwist());
+  plugin_ptr->updateReference(makeReference(yaw));
+
+  geometry_msgs::msg::PoseStamped pose;
+  geometry_msgs::msg::TwistStamped twist;
+  as2_msgs::msg::Thrust thrust;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plugin_ptr->computeOutput(0.01, pose, twist, thrust));
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_COMPUTE_OUTPUT)->DenseRange(-180, 180, 90);
+
+/* computeOutput with the per stage latency histograms off (0) and on (1) */
+static void BM_COMPUTE_OUTPUT_LATENCY(benchmark::State &state) {
+  plugin_ptr->updateDFParameter("trajectory_control.latency.enabled",
+                                rclcpp::Parameter("trajectory_control.latency.enabled",
+                                                  static_cast<bool>(state.range(0))));
+  plugin_ptr->updateState(makePose(0.0), makeTwist());
+  plugin_ptr->updateReference(makeReference(0.0));
+
+  geometry_msgs::msg::PoseStamped pose;
+  geometry_msgs::msg::TwistStamped twist;
+  as2_msgs::msg::Thrust thrust;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plugin_ptr->computeOutput(0.01, pose, twist, thrust));
+    benchmark::ClobberMemory();
+  }
+  plugin_ptr->updateDFParameter("trajectory_control.latency.enabled",
+                                rclcpp::Parameter("trajectory_control.latency.enabled", false));
+}
+BENCHMARK(BM_COMPUTE_OUTPUT_LATENCY)->DenseRange(0, 1);
+
+static void BM_LATENCY_RECORD(benchmark::State &state) {
+  auto histogram = std::make_unique<df::LatencyHistogram>();
+  uint64_t value = 0;
+  for (auto _ : state) {
+    histogram->record(value);
+    value = (value + 977) % 100000;
+  }
+}
+BENCHMARK(BM_LATENCY_RECORD);
+
+static void BM_GET_FORCE(benchmark::State &state) {
+  df::DFControlLaw law(defaultGains());
+  const Scenario s = makeScenario(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(law.getForce(0.01, s.pos, s.vel, s.pos_ref, s.vel_ref, s.acc_ref));
+  }
+}
+BENCHMARK(BM_GET_FORCE)->DenseRange(0, 2);
+
+static void BM_PREDICT_STATE(benchmark::State &state) {
+  const Eigen::Quaterniond attitude(Eigen::AngleAxisd(0.2, Eigen::Vector3d(1, 1, 0).normalized()));
+  const Eigen::Vector3d body_rates(0.3, -0.1, 0.5);
+  for (auto _ : state) {
+    Eigen::Vector3d position(0.1, -0.2, 1.0);
+    Eigen::Vector3d velocity(0.5, 0.1, -0.05);
+    Eigen::Quaterniond predicted = attitude;
+    const Eigen::Vector3d acceleration = df::commandedAcceleration(9.0, 0.82, predicted);
+    df::propagateState(0.02, acceleration, body_rates, position, velocity, predicted);
+    benchmark::DoNotOptimize(position);
+    benchmark::DoNotOptimize(predicted);
+  }
+}
+BENCHMARK(BM_PREDICT_STATE);
+
+/* Reference evaluation from a full store of 7th order segments */
+static void BM_SAMPLE_TRAJECTORY_SEGMENT(benchmark::State &state) {
+  df::TrajectorySegmentStore store;
+  df::Trajectory_segment segment;
+  segment.duration = 0.5;
+  segment.coefficients.setConstant(0.1);
+  for (std::size_t i = 0; i < df::TrajectorySegmentStore::capacity; i++) {
+    segment.start = 0.5 * i;
+    store.push(segment);
+  }
+  df::UAV_reference reference;
+  double t = 0.0;
+  for (auto _ : state) {
+    store.sample(t, reference);
+    benchmark::DoNotOptimize(reference);
+    t = t > 30.0 ? 0.0 : t + 0.01;
+  }
+}
+BENCHMARK(BM_SAMPLE_TRAJECTORY_SEGMENT);
+
+/* Reference and position loop of a tick on segments: evaluated in the tick (0) or interpolated
+ * from the lookahead cache (1) */
+static void BM_LOOKAHEAD_REFERENCE(benchmark::State &state) {
+  df::Trajectory_segment segment;
+  segment.duration = 100.0;
+  segment.coefficients.setConstant(0.1);
+  df::TrajectorySegmentStore store;
+  store.push(segment);
+
+  df::LookaheadCache cache;
+  cache.reset(0.0, df::Lookahead_options());
+  cache.pushSegment(segment);
+  cache.start();
+  df::Flatness_sample sample;
+  const double t = 0.0501;
+  while (state.range(0) && !cache.sample(t, sample)) {
+  }
+
+  df::DFControlLaw law(defaultGains());
+  const Eigen::Vector3d pos(0.1, -0.2, 1.0);
+  const Eigen::Vector3d vel(0.5, 0.1, -0.05);
+  df::UAV_reference reference;
+  for (auto _ : state) {
+    Eigen::Vector3d force;
+    Eigen::Matrix3d R_des;
+    if (state.range(0)) {
+      cache.sample(t, sample);
+      force = law.getForceFeedforward(0.01, pos, vel, sample.reference.position,
+                                      sample.reference.velocity, sample.specific_force);
+      R_des = df::DFControlLaw::computeDesiredAttitudeFromHeading(force, sample.heading);
+    } else {
+      store.sample(t, reference);
+      force = law.getForce(0.01, pos, vel, reference.position, reference.velocity,
+                           reference.acceleration);
+      R_des = df::DFControlLaw::computeDesiredAttitude(force, reference.yaw);
+    }
+    benchmark::DoNotOptimize(R_des);
+  }
+  cache.stop();
+}
+BENCHMARK(BM_LOOKAHEAD_REFERENCE)->DenseRange(0, 1);
+
+/* Per tick cost of gain scheduling: sample a 16 point table and apply it to the law */
+static void BM_SCHEDULE_GAINS(benchmark::State &state) {
+  std::string yaml = "profiles:\n  - {name: nominal, mass: 0.82, antiwindup_cte: 1.0, points: [";
+  for (int i = 0; i < 16; i++) {
+    yaml += std::string(i ? ", " : "") + "{speed: " + std::to_string(0.5 * i) +
+            ", kp: [6, 6, 6], ki: [0.005, 0.005, 0.065], kd: [1.5, 1.5, 3], kp_ang: [5.5, 5.5, 2]}";
+  }
+  yaml += "]}\n";
+  df::GainSchedule schedule;
+  std::string error;
+  if (!schedule.loadString(yaml, error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  df::DFControlLaw law(defaultGains());
+  df::DF_gain_set gain_set = df::makeGainSet(defaultGains(), 0.1);
+  double speed             = 0.0;
+  for (auto _ : state) {
+    schedule.sample(0, speed, gain_set.gains);
+    gain_set = df::makeGainSet(gain_set.gains, gain_set.alpha);
+    law.setGains(gain_set);
+    benchmark::DoNotOptimize(law);
+    speed = speed > 8.0 ? 0.0 : speed + 0.01;
+  }
+}
+BENCHMARK(BM_SCHEDULE_GAINS);
+
+/* Control thread side of the flight recorder, the writer drains to a file in the meantime */
+static void BM_FLIGHT_RECORDER_PUSH(benchmark::State &state) {
+  df::FlightRecorder recorder;
+  std::string error;
+  if (!recorder.start("/tmp/controller_benchmark.dfrec", 0.001, error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  const Eigen::Quaterniond attitude(Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitX()));
+  const Eigen::Matrix3d rotation = attitude.toRotationMatrix();
+  df::UAV_reference reference;
+  reference.position = Eigen::Vector3d(1.0, 2.0, 3.0);
+  const Eigen::Vector3d force(0.1, 0.2, 8.0);
+  const Eigen::Matrix3d R_des = df::DFControlLaw::computeDesiredAttitude(force, 0.3);
+  df::Acro_command command;
+
+  double stamp = 0.0;
+  for (auto _ : state) {
+    df::Flight_record record;
+    df::fillFlightRecord(stamp, 0.01, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), attitude,
+                         rotation, reference, Eigen::Vector3d::Zero(), force, R_des, command,
+                         record);
+    benchmark::DoNotOptimize(recorder.push(record));
+    stamp += 0.01;
+  }
+  recorder.stop();
+  state.counters["overruns"] = static_cast<double>(recorder.getOverruns());
+  std::remove("/tmp/controller_benchmark.dfrec");
+}
+BENCHMARK(BM_FLIGHT_RECORDER_PUSH);
+
+/* Last hop to a co-located bridge, one mailbox write and the read of the bridge side */
+static void BM_COMMAND_MAILBOX(benchmark::State &state) {
+  const std::string name = "/df_controller_benchmark";
+  df::CommandMailboxWriter writer;
+  df::CommandMailboxReader reader;
+  std::string error;
+  if (!writer.open(name, error) || !reader.open(name, error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  df::Acro_command command;
+  command.PQR    = Eigen::Vector3d(0.1, -0.2, 0.3);
+  command.thrust = 8.0;
+  df::Mailbox_command received;
+
+  int64_t stamp_ns = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(writer.write(command, stamp_ns++));
+    benchmark::DoNotOptimize(reader.read(received));
+  }
+  df::CommandMailboxWriter::remove(name);
+}
+BENCHMARK(BM_COMMAND_MAILBOX);
+
+/* Per tick cost of a hot standby pair, one snapshot published and restored on the other side */
+static void BM_CONTROLLER_SNAPSHOT(benchmark::State &state) {
+  const std::string name = "/df_controller_benchmark_standby";
+  df::SnapshotChannelWriter writer;
+  df::SnapshotChannelReader reader;
+  std::string error;
+  if (!writer.open(name, error) || !reader.open(name, error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  df::Controller_snapshot snapshot;
+  snapshot.integral       = Eigen::Vector3d(0.1, -0.2, 0.3);
+  snapshot.command.thrust = 8.0;
+  df::Controller_snapshot received;
+  uint64_t sequence;
+
+  for (auto _ : state) {
+    snapshot.stamp += 0.01;
+    benchmark::DoNotOptimize(writer.publish(snapshot));
+    benchmark::DoNotOptimize(reader.read(received, sequence));
+  }
+  df::SnapshotChannelWriter::remove(name);
+}
+BENCHMARK(BM_CONTROLLER_SNAPSHOT);
+
+static void BM_COMPUTE_TRAJECTORY_CONTROL(benchmark::State &state) {
+  df::DFControlLaw law(defaultGains());
+  const Scenario s = makeScenario(state.range(0));
+  const double yaw = state.range(1) * M_PI / 180.0;
+  const Eigen::Matrix3d rot =
+      Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(law.computeTrajectoryControl(0.01, s.pos, s.vel, rot, s.pos_ref,
+                                                          s.vel_ref, s.acc_ref, yaw));
+  }
+}
+BENCHMARK(BM_COMPUTE_TRAJECTORY_CONTROL)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, 2, 1),
+                   benchmark::CreateDenseRange(-180, 180, 45)});
+
+/* Compile-time law variants on the same nominal input */
+template <typename Law>
+static void BM_COMPUTE_TRAJECTORY_CONTROL_LAW(benchmark::State &state) {
+  Law law(defaultGains());
+  const Eigen::Vector3d pos(0.1, -0.2, 1.0);
+  const Eigen::Vector3d vel(0.5, 0.1, -0.05);
+  const Eigen::Matrix3d rot =
+      Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  const Eigen::Vector3d pos_ref(1.0, 0.5, 1.5);
+  const Eigen::Vector3d vel_ref(0.4, 0.0, 0.0);
+  const Eigen::Vector3d acc_ref(0.0, 0.0, 0.2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        law.computeTrajectoryControl(0.01, pos, vel, rot, pos_ref, vel_ref, acc_ref, 0.3));
+  }
+}
+BENCHMARK_TEMPLATE(BM_COMPUTE_TRAJECTORY_CONTROL_LAW,
+                   df::DFControlLawT<double, df::FullGains, df::ClampAntiwindup>);
+BENCHMARK_TEMPLATE(BM_COMPUTE_TRAJECTORY_CONTROL_LAW,
+                   df::DFControlLawT<double, df::DiagonalGains, df::ClampAntiwindup>);
+BENCHMARK_TEMPLATE(BM_COMPUTE_TRAJECTORY_CONTROL_LAW,
+                   df::DFControlLawT<float, df::FullGains, df::ClampAntiwindup>);
+BENCHMARK_TEMPLATE(BM_COMPUTE_TRAJECTORY_CONTROL_LAW,
+                   df::DFControlLawT<float, df::DiagonalGains, df::ClampAntiwindup>);
+
+/* Batched law for a swarm, items are vehicles. Second argument selects the scalar kernel (0) or
+ * the dispatched one (1) */
+static void BM_COMPUTE_TRAJECTORY_CONTROL_BATCH(benchmark::State &state) {
+  df::DF_batch batch;
+  batch.resize(state.range(0));
+  for (std::size_t i = 0; i < batch.size; i++) {
+    batch.setGains(i, defaultGains());
+    batch.ref_position.x[i] = 0.01 * i;
+    batch.ref_yaw[i]        = 0.1 * i;
+  }
+  for (auto _ : state) {
+    if (state.range(1)) {
+      df::computeTrajectoryControlBatch(batch, 0.01);
+    } else {
+      df::computeTrajectoryControlBatchScalar(batch, 0.01, 0, batch.size);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_COMPUTE_TRAJECTORY_CONTROL_BATCH)->ArgsProduct({{16, 128, 512}, {0, 1}});
+
+/* Same stage through the plugin adapter, which takes the rotation matrix cached by updateState */
+static void BM_PLUGIN_COMPUTE_TRAJECTORY_CONTROL(benchmark::State &state) {
+  const Scenario s = makeScenario(state.range(0));
+  const Eigen::Matrix3d attitude =
+      Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  // Earlier benchmarks leave an integral behind, near free fall needs it at zero
+  plugin_ptr->resetCommands();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plugin_ptr->computeTrajectoryControl(
+        0.01, s.pos, s.vel, attitude, s.pos_ref, s.vel_ref, s.acc_ref, 0.0));
+  }
+}
+BENCHMARK(BM_PLUGIN_COMPUTE_TRAJECTORY_CONTROL)->DenseRange(0, 2);
+
+static void BM_GET_OUTPUT(benchmark::State &state) {
+  geometry_msgs::msg::TwistStamped twist;
+  as2_msgs::msg::Thrust thrust;
+  const rclcpp::Time stamp = node_ptr->now();
+  df::Acro_command command;
+  command.thrust = 8.0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plugin_ptr->getOutput(stamp, command, twist, thrust));
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_GET_OUTPUT);
+
+static void BM_UPDATE_STATE(benchmark::State &state) {
+  const auto pose  = makePose(state.range(0) * M_PI / 180.0);
+  const auto twist = makeTwist();
+  for (auto _ : state) {
+    plugin_ptr->updateState(pose, twist);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_UPDATE_STATE)->DenseRange(-180, 180, 90);
+
+/* Same state as a single odometry message, with the twist in base_link as usual */
+static void BM_UPDATE_ODOMETRY(benchmark::State &state) {
+  const auto pose  = makePose(state.range(0) * M_PI / 180.0);
+  const auto twist = makeTwist();
+  nav_msgs::msg::Odometry odometry;
+  odometry.header         = pose.header;
+  odometry.child_frame_id = as2::tf::generateTfName(node_ptr, "base_link");
+  odometry.pose.pose      = pose.pose;
+  odometry.twist.twist    = twist.twist;
+  for (auto _ : state) {
+    plugin_ptr->updateOdometry(odometry);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_UPDATE_ODOMETRY)->DenseRange(-180, 180, 90);
+
+static void BM_UPDATE_REFERENCE(benchmark::State &state) {
+  const auto ref = makeReference(state.range(0) * M_PI / 180.0);
+  for (auto _ : state) {
+    plugin_ptr->updateReference(ref);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_UPDATE_REFERENCE)->DenseRange(-180, 180, 90);
+
+static void BM_UPDATE_DF_PARAMETER(benchmark::State &state) {
+  const rclcpp::Parameter &param = default_parameters[state.range(0)];
+  state.SetLabel(param.get_name());
+  for (auto _ : state) {
+    plugin_ptr->updateDFParameter(param.get_name(), param);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_UPDATE_DF_PARAMETER)->DenseRange(0, 14);
+
+/* Full batch: dispatch of every parameter plus building and publishing the gain set */
+static void BM_PARAMETERS_CALLBACK(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(plugin_ptr->parametersCallback(default_parameters));
+  }
+}
+BENCHMARK(BM_PARAMETERS_CALLBACK);
+
+/* Tick side of a gain update, a new gain set is published every iteration */
+static void BM_ADOPT_CONTROL_LAW(benchmark::State &state) {
+  const std::vector<rclcpp::Parameter> parameters = {default_parameters[3]};
+  for (auto _ : state) {
+    state.PauseTiming();
+    plugin_ptr->parametersCallback(parameters);
+    state.ResumeTiming();
+    plugin_ptr->adoptControlLaw();
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_ADOPT_CONTROL_LAW);
+
+/* Writes a JSON report next to the console output unless --benchmark_out is given */
+static std::vector<char *> addDefaultJsonOutput(int argc, char **argv, std::string &out_flag) {
+  std::vector<char *> args(argv, argv + argc);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--benchmark_out=", 16) == 0) {
+      return args;
+    }
+  }
+  out_flag = "--benchmark_out=controller_benchmark.json";
+  args.push_back(out_flag.data());
+  static std::string format_flag = "--benchmark_out_format=json";
+  args.push_back(format_flag.data());
+  return args;
+}
+
+int main(int argc, char **argv) {
+  rclcpp::init(argc, argv);
+
+  rclcpp::NodeOptions options;
+  options.automatically_declare_parameters_from_overrides(true);
+  options.parameter_overrides(default_parameters);
+  node_ptr = std::make_shared<as2::Node>("controller_benchmark", options);
+  if (rcutils_logging_set_logger_level(node_ptr->get_logger().get_name(),
+                                       RCUTILS_LOG_SEVERITY_WARN) == RCUTILS_RET_ERROR) {
+    throw std::runtime_error("Error setting logger level");
+  }
+
+  plugin_ptr = std::make_shared<PluginUnderTest>();
+  plugin_ptr->initialize(node_ptr.get());
+  std::vector<std::string> param_names;
+  for (auto &param : default_parameters) {
+    param_names.push_back(param.get_name());
+  }
+  plugin_ptr->updateParams(param_names);
+  plugin_ptr->adoptControlLaw();
+
+  as2_msgs::msg::ControlMode mode_in;
+  mode_in.control_mode = as2_msgs::msg::ControlMode::TRAJECTORY;
+  mode_in.yaw_mode     = as2_msgs::msg::ControlMode::YAW_ANGLE;
+  as2_msgs::msg::ControlMode mode_out;
+  mode_out.control_mode = as2_msgs::msg::ControlMode::ACRO;
+  plugin_ptr->setMode(mode_in, mode_out);
+
+  std::string out_flag;
+  std::vector<char *> args = addDefaultJsonOutput(argc, argv, out_flag);
+  int args_count           = static_cast<int>(args.size());
+  benchmark::Initialize(&args_count, args.data());
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  plugin_ptr.reset();
+  node_ptr.reset();
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "controller_config.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+/* Default gains, as in config/default_controller.yaml */
+const char *config_text = R"(/**:
+  ros__parameters:
+    mass: 0.82
+    trajectory_control:
+      law:
+        scalar_type: double
+      reset_integral: false
+      odometry_topic: ""
+      antiwindup_cte: 1.0
+      alpha: 0.1
+      kp: {x: 6.0, y: 6.0, z: 6.0}
+      ki: {x: 0.005, y: 0.005, z: 0.065}
+      kd: {x: 1.5, y: 1.5, z: 3.0}
+      roll_control:
+        kp: 5.5
+      pitch_control:
+        kp: 5.5
+      yaw_control:
+        kp: 2.0
+)";
+
+std::string writeConfig(const std::string &_text) {
+  const std::string path = ::testing::TempDir() + "controller_config_test.yaml";
+  std::ofstream file(path);
+  file << _text;
+  return path;
+}
+
+}  // namespace
+
+TEST(ControllerConfig, LoadsEveryRequiredParameter) {
+  const std::string path = writeConfig(config_text);
+  DF_controller_config config;
+  std::string error;
+  ASSERT_TRUE(loadControllerConfig(path, config, error)) << error;
+  std::remove(path.c_str());
+
+  EXPECT_EQ(config.gains.mass, 0.82);
+  EXPECT_EQ(config.alpha, 0.1);
+  EXPECT_EQ(config.gains.Ki(2, 2), 0.065);
+  EXPECT_EQ(config.gains.Kd(2, 2), 3.0);
+  EXPECT_EQ(config.gains.Kp_ang(0, 0), 5.5);
+  EXPECT_EQ(config.gains.Kp_ang(2, 2), 2.0);
+  EXPECT_FALSE(config.reset_integral);
+
+  DFControlLawVariant law;
+  ASSERT_TRUE(makeControlLaw(config, law));
+  EXPECT_TRUE(std::holds_alternative<DFControlLaw>(law));
+}
+
+TEST(ControllerConfig, RejectsMissingAndMalformedParameters) {
+  DF_controller_config config;
+  std::string error;
+
+  const std::string missing = writeConfig("/**:\n  ros__parameters:\n    mass: 0.82\n");
+  EXPECT_FALSE(loadControllerConfig(missing, config, error));
+  EXPECT_FALSE(error.empty());
+  std::remove(missing.c_str());
+
+  std::string heavy = config_text;
+  heavy.replace(heavy.find("0.82"), 4, "heavy");
+  const std::string malformed = writeConfig(heavy);
+  EXPECT_FALSE(loadControllerConfig(malformed, config, error));
+  std::remove(malformed.c_str());
+
+  // The name=value format of older gains files is not a parameter file
+  const std::string flat = writeConfig("mass=0.82\ntrajectory_control.kp.x=6.0\n");
+  EXPECT_FALSE(loadControllerConfig(flat, config, error));
+  std::remove(flat.c_str());
+
+  uint32_t parameters_to_read = required_parameters_mask;
+  EXPECT_FALSE(setConfigParameter("trajectory_control.kp.w", "1.0", config, parameters_to_read));
+  EXPECT_TRUE(setConfigParameter("trajectory_control.kp.y", "7.5", config, parameters_to_read));
+  EXPECT_EQ(config.gains.Kp(1, 1), 7.5);
+  EXPECT_EQ(parameters_to_read & parameterBit(DF_parameter::kp_y), 0u);
+
+  EXPECT_FALSE(setConfigParameter("trajectory_control.reset_integral", "yes", config,
+                                  parameters_to_read));
+  EXPECT_TRUE(config.reset_integral);
+  EXPECT_TRUE(setConfigParameter("trajectory_control.reset_integral", "false", config,
+                                 parameters_to_read));
+  EXPECT_FALSE(config.reset_integral);
+}
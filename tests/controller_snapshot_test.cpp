@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "controller_snapshot.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+/* Every field derived from _i, so a torn read shows as a mismatch */
+Controller_snapshot numberedSnapshot(double _i) {
+  Controller_snapshot snapshot;
+  snapshot.stamp                  = _i;
+  snapshot.mode                   = 0x0204;
+  snapshot.integral               = Eigen::Vector3d(_i, 2.0 * _i, 3.0 * _i);
+  snapshot.reference.position     = Eigen::Vector3d(1.0, -_i, 0.5);
+  snapshot.reference.velocity     = Eigen::Vector3d(_i, 0.0, 0.0);
+  snapshot.reference.acceleration = Eigen::Vector3d(0.0, 0.0, -_i);
+  snapshot.reference.yaw          = 0.1 * _i;
+  snapshot.command.PQR            = Eigen::Vector3d(-_i, _i, 0.0);
+  snapshot.command.thrust         = 7.0 + _i;
+  return snapshot;
+}
+
+bool equalSnapshots(const Controller_snapshot &_a, const Controller_snapshot &_b) {
+  return _a.stamp == _b.stamp && _a.mode == _b.mode && _a.integral == _b.integral &&
+         _a.reference.position == _b.reference.position &&
+         _a.reference.velocity == _b.reference.velocity &&
+         _a.reference.acceleration == _b.reference.acceleration &&
+         _a.reference.yaw == _b.reference.yaw && _a.command.PQR == _b.command.PQR &&
+         _a.command.thrust == _b.command.thrust;
+}
+
+}  // namespace
+
+TEST(ControllerSnapshot, PackAndUnpackAreInverse) {
+  const Controller_snapshot snapshot = numberedSnapshot(3.25);
+  Snapshot_words words;
+  packSnapshot(snapshot, words);
+
+  Controller_snapshot unpacked;
+  ASSERT_TRUE(unpackSnapshot(words, unpacked));
+  EXPECT_TRUE(equalSnapshots(snapshot, unpacked));
+}
+
+TEST(ControllerSnapshot, OtherVersionsAreRejected) {
+  Snapshot_words words;
+  packSnapshot(numberedSnapshot(1.0), words);
+  words[0] += static_cast<uint64_t>(1) << 32;
+
+  Controller_snapshot unpacked = numberedSnapshot(2.0);
+  EXPECT_FALSE(unpackSnapshot(words, unpacked));
+  EXPECT_TRUE(equalSnapshots(unpacked, numberedSnapshot(2.0)));
+}
+
+TEST(ControllerSnapshot, StandbyReadsTheLastPublishedSnapshot) {
+  const std::string name = "/df_snapshot_test_last_" + std::to_string(getpid());
+  SnapshotChannelReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.open(name, error));
+
+  SnapshotChannelWriter writer;
+  ASSERT_TRUE(writer.open(name, error)) << error;
+  ASSERT_TRUE(reader.open(name, error)) << error;
+
+  Controller_snapshot snapshot;
+  uint64_t sequence = 0;
+  EXPECT_FALSE(reader.read(snapshot, sequence));
+
+  ASSERT_TRUE(writer.publish(numberedSnapshot(1.0)));
+  ASSERT_TRUE(writer.publish(numberedSnapshot(2.0)));
+  ASSERT_TRUE(reader.read(snapshot, sequence));
+  EXPECT_EQ(sequence, 2u);
+  EXPECT_TRUE(equalSnapshots(snapshot, numberedSnapshot(2.0)));
+
+  // A restarted primary continues the sequence
+  writer.close();
+  ASSERT_TRUE(writer.open(name, error)) << error;
+  ASSERT_TRUE(writer.publish(numberedSnapshot(3.0)));
+  ASSERT_TRUE(reader.read(snapshot, sequence));
+  EXPECT_EQ(sequence, 3u);
+
+  reader.close();
+  EXPECT_FALSE(reader.read(snapshot, sequence));
+  EXPECT_TRUE(SnapshotChannelWriter::remove(name));
+}
+
+TEST(ControllerSnapshot, ConcurrentStandbyNeverSeesATornSnapshot) {
+  const std::string name = "/df_snapshot_test_threads_" + std::to_string(getpid());
+  SnapshotChannelWriter writer;
+  SnapshotChannelReader reader;
+  std::string error;
+  ASSERT_TRUE(writer.open(name, error)) << error;
+  ASSERT_TRUE(reader.open(name, error)) << error;
+
+  const uint64_t n_snapshots = 50000;
+  std::atomic<bool> consistent{true};
+  std::thread standby([&]() {
+    uint64_t last_sequence = 0;
+    Controller_snapshot snapshot;
+    uint64_t sequence;
+    while (last_sequence < n_snapshots) {
+      if (!reader.read(snapshot, sequence)) {
+        continue;
+      }
+      if (sequence < last_sequence ||
+          !equalSnapshots(snapshot, numberedSnapshot(static_cast<double>(sequence)))) {
+        consistent = false;
+        return;
+      }
+      last_sequence = sequence;
+    }
+  });
+
+  for (uint64_t i = 1; i <= n_snapshots; i++) {
+    ASSERT_TRUE(writer.publish(numberedSnapshot(static_cast<double>(i))));
+  }
+  standby.join();
+  EXPECT_TRUE(consistent);
+  EXPECT_TRUE(SnapshotChannelWriter::remove(name));
+}
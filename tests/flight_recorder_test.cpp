@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "DF_control_law.hpp"
+#include "flight_recorder.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+Flight_record stampedRecord(double _stamp) {
+  Flight_record record{};
+  record.stamp  = _stamp;
+  record.thrust = 2.0 * _stamp;
+  return record;
+}
+
+}  // namespace
+
+TEST(FlightRecorder, RecordsReachTheFileInOrder) {
+  const std::string path = testing::TempDir() + "flight_recorder_order.dfrec";
+  FlightRecorder recorder;
+  std::string error;
+  ASSERT_TRUE(recorder.start(path, 0.001, error)) << error;
+  EXPECT_TRUE(recorder.recording());
+
+  // Several times the ring and the first file chunk, pushed at a pace the writer keeps up with
+  const std::size_t n_records = 10000;
+  for (std::size_t i = 0; i < n_records; i++) {
+    while (!recorder.push(stampedRecord(static_cast<double>(i)))) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  ASSERT_TRUE(recorder.stop()) << recorder.getError();
+  EXPECT_FALSE(recorder.recording());
+  EXPECT_EQ(recorder.getRecorded(), n_records);
+
+  std::vector<Flight_record> records;
+  ASSERT_TRUE(loadFlightRecording(path, records, error)) << error;
+  ASSERT_EQ(records.size(), n_records);
+  for (std::size_t i = 0; i < n_records; i++) {
+    ASSERT_EQ(records[i].stamp, static_cast<double>(i));
+    ASSERT_EQ(records[i].thrust, 2.0 * i);
+  }
+
+  // The preallocated tail is cut on stop
+  struct stat file_stat;
+  ASSERT_EQ(stat(path.c_str(), &file_stat), 0);
+  EXPECT_EQ(static_cast<std::size_t>(file_stat.st_size), 24 + n_records * sizeof(Flight_record));
+  std::remove(path.c_str());
+}
+
+TEST(FlightRecorder, FullRingCountsOverrunsInsteadOfBlocking) {
+  const std::string path = testing::TempDir() + "flight_recorder_overrun.dfrec";
+  FlightRecorder recorder;
+  std::string error;
+  EXPECT_FALSE(recorder.push(stampedRecord(-1.0)));
+  EXPECT_EQ(recorder.getOverruns(), 0u);
+
+  // The writer does not drain before stop
+  ASSERT_TRUE(recorder.start(path, 60.0, error)) << error;
+
+  const std::size_t pushed = FlightRecorder::queue_capacity + 500;
+  std::size_t accepted     = 0;
+  for (std::size_t i = 0; i < pushed; i++) {
+    accepted += recorder.push(stampedRecord(static_cast<double>(i)));
+  }
+  EXPECT_EQ(accepted, FlightRecorder::queue_capacity);
+  EXPECT_EQ(recorder.getOverruns(), 500u);
+
+  ASSERT_TRUE(recorder.stop()) << recorder.getError();
+  std::vector<Flight_record> records;
+  ASSERT_TRUE(loadFlightRecording(path, records, error)) << error;
+  ASSERT_EQ(records.size(), FlightRecorder::queue_capacity);
+  EXPECT_EQ(records.back().stamp, FlightRecorder::queue_capacity - 1.0);
+
+  // Records pushed while stopped do not leak into the next file
+  recorder.push(stampedRecord(-1.0));
+  ASSERT_TRUE(recorder.start(path, 60.0, error)) << error;
+  recorder.push(stampedRecord(7.0));
+  ASSERT_TRUE(recorder.stop());
+  ASSERT_TRUE(loadFlightRecording(path, records, error)) << error;
+  ASSERT_EQ(records.size(), 1u);
+  EXPECT_EQ(records[0].stamp, 7.0);
+  std::remove(path.c_str());
+}
+
+TEST(FlightRecorder, RecordHoldsTheLawInternals) {
+  const Eigen::Quaterniond attitude(Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitX()));
+  const Eigen::Matrix3d rotation = attitude.toRotationMatrix();
+  UAV_reference reference;
+  reference.position = Eigen::Vector3d(1.0, 2.0, 3.0);
+  reference.velocity = Eigen::Vector3d(0.5, 0.0, 0.0);
+  reference.yaw      = 0.3;
+
+  const Eigen::Vector3d desired_force(0.1, -0.2, 8.0);
+  const Eigen::Matrix3d R_des = DFControlLaw::computeDesiredAttitude(desired_force, reference.yaw);
+  Acro_command command;
+  command.PQR    = Eigen::Vector3d(0.1, 0.2, 0.3);
+  command.thrust = 8.1;
+
+  Flight_record record;
+  fillFlightRecord(12.5, 0.01, Eigen::Vector3d(1.0, 1.0, 1.0), Eigen::Vector3d::Zero(), attitude,
+                   rotation, reference, Eigen::Vector3d(0.4, 0.5, 0.6), desired_force, R_des,
+                   command, record);
+
+  EXPECT_EQ(record.position_error[1], 1.0);
+  EXPECT_EQ(record.position_error[2], 2.0);
+  EXPECT_EQ(record.velocity_error[0], 0.5);
+  EXPECT_EQ(record.accum_pos_error[2], 0.6);
+  EXPECT_EQ(record.R_des[3 * 1 + 2], R_des(1, 2));
+  const Eigen::Vector3d E_rot(record.E_rot);
+  EXPECT_LT((E_rot - computeAttitudeError<double>(R_des, rotation)).norm(), 1e-15);
+  EXPECT_GT(E_rot.norm(), 0.0);
+
+  const Flight_sample sample = toFlightSample(record);
+  EXPECT_EQ(sample.dt, 0.01);
+  EXPECT_EQ(sample.reference.position, reference.position);
+  EXPECT_EQ(sample.attitude.coeffs(), attitude.coeffs());
+  EXPECT_EQ(sample.command.PQR, command.PQR);
+  EXPECT_EQ(sample.command.thrust, 8.1);
+}
+
+TEST(FlightRecorder, RejectsFilesItDidNotWrite) {
+  const std::string path = testing::TempDir() + "flight_recorder_bad.dfrec";
+  std::FILE *file        = std::fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fputs("not a recording at all, just text", file);
+  std::fclose(file);
+
+  std::vector<Flight_record> records;
+  std::string error;
+  EXPECT_FALSE(loadFlightRecording(path, records, error));
+  EXPECT_FALSE(error.empty());
+
+  FlightRecorder recorder;
+  EXPECT_FALSE(recorder.start("/nonexistent/dir/recording.dfrec", 0.01, error));
+  EXPECT_FALSE(recorder.recording());
+  std::remove(path.c_str());
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include "DF_control_law.hpp"
+#include "flight_log.hpp"
+#include "flight_replay.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+DF_gains defaultGains() {
+  DF_gains gains;
+  gains.mass              = 0.82;
+  gains.antiwindup_cte    = 1.0;
+  gains.Kp.diagonal()     = Eigen::Vector3d(6.0, 6.0, 6.0);
+  gains.Ki.diagonal()     = Eigen::Vector3d(0.005, 0.005, 0.065);
+  gains.Kd.diagonal()     = Eigen::Vector3d(1.5, 1.5, 3.0);
+  gains.Kp_ang.diagonal() = Eigen::Vector3d(5.5, 5.5, 2.0);
+  return gains;
+}
+
+/* Circle tracked with a position lag, commands recorded from a reference law */
+Flight_log recordFlight(std::size_t _ticks, bool _reset_integral_each_tick) {
+  Flight_log log;
+  log.name = "circle";
+  DFControlLaw law(defaultGains());
+  for (std::size_t i = 0; i < _ticks; i++) {
+    const double t = 0.01 * i;
+    Flight_sample sample;
+    sample.dt                     = 0.01;
+    sample.position               = Eigen::Vector3d(std::cos(t - 0.1), std::sin(t - 0.1), 1.0);
+    sample.velocity               = Eigen::Vector3d(-std::sin(t - 0.1), std::cos(t - 0.1), 0.0);
+    sample.attitude               = Eigen::AngleAxisd(0.1 * std::sin(t), Eigen::Vector3d::UnitX());
+    sample.reference.position     = Eigen::Vector3d(std::cos(t), std::sin(t), 1.0);
+    sample.reference.velocity     = Eigen::Vector3d(-std::sin(t), std::cos(t), 0.0);
+    sample.reference.acceleration = Eigen::Vector3d(-std::cos(t), -std::sin(t), 0.0);
+    sample.reference.yaw          = t;
+
+    if (_reset_integral_each_tick) {
+      law.resetIntegral();
+    }
+    sample.command = law.computeTrajectoryControl(
+        sample.dt, sample.position, sample.velocity, sample.attitude.toRotationMatrix(),
+        sample.reference.position, sample.reference.velocity, sample.reference.acceleration,
+        sample.reference.yaw);
+    log.samples.push_back(sample);
+  }
+  return log;
+}
+
+}  // namespace
+
+TEST(FlightReplay, ReplayReproducesRecordedCommands) {
+  const Flight_log log = recordFlight(500, false);
+
+  Replay_options carry;
+  carry.reset_integral_each_tick = false;
+  DFControlLawVariant law{DFControlLaw(defaultGains())};
+  std::vector<Acro_command> commands;
+  const Replay_statistics statistics = replayFlight(log, law, carry, &commands);
+
+  EXPECT_EQ(statistics.ticks, 500u);
+  EXPECT_EQ(statistics.max_pqr_error, 0.0);
+  EXPECT_EQ(statistics.max_thrust_error, 0.0);
+  ASSERT_EQ(commands.size(), 500u);
+  EXPECT_EQ(commands[42].PQR, log.samples[42].command.PQR);
+}
+
+TEST(FlightReplay, IntegralCarriesOverOnlyWhenAsked) {
+  const Flight_log log = recordFlight(500, true);
+
+  DFControlLawVariant law{DFControlLaw(defaultGains())};
+  EXPECT_EQ(replayFlight(log, law, Replay_options(), nullptr).max_thrust_error, 0.0);
+
+  Replay_options carry;
+  carry.reset_integral_each_tick = false;
+  DFControlLawVariant carry_law{DFControlLaw(defaultGains())};
+  EXPECT_GT(replayFlight(log, carry_law, carry, nullptr).max_thrust_error, 0.0);
+}
+
+TEST(FlightReplay, BinaryAndCSVRoundTrip) {
+  const Flight_log log     = recordFlight(100, true);
+  const std::string binary = testing::TempDir() + "flight_replay_test.bin";
+  const std::string csv    = testing::TempDir() + "flight_replay_test.csv";
+  ASSERT_TRUE(saveFlightLogBinary(binary, log));
+  ASSERT_TRUE(saveFlightLogCSV(csv, log));
+
+  for (const std::string &path : {binary, csv}) {
+    Flight_log loaded;
+    std::string error;
+    ASSERT_TRUE(loadFlightLog(path, loaded, error)) << error;
+    EXPECT_EQ(loaded.name, "flight_replay_test");
+    ASSERT_EQ(loaded.samples.size(), log.samples.size());
+
+    DFControlLawVariant law{DFControlLaw(defaultGains())};
+    const Replay_statistics statistics = replayFlight(loaded, law, Replay_options(), nullptr);
+    EXPECT_EQ(statistics.max_pqr_error, 0.0) << path;
+    EXPECT_EQ(statistics.max_thrust_error, 0.0) << path;
+  }
+  std::remove(binary.c_str());
+  std::remove(csv.c_str());
+}
+
+TEST(FlightReplay, RejectsTruncatedLogs) {
+  const std::string path = testing::TempDir() + "flight_replay_truncated.bin";
+  Flight_log log         = recordFlight(10, false);
+  ASSERT_TRUE(saveFlightLogBinary(path, log));
+  {
+    // Drop the last sample
+    std::FILE *file = std::fopen(path.c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    std::fseek(file, 0, SEEK_END);
+    const long size = std::ftell(file);
+    std::fclose(file);
+    ASSERT_EQ(truncate(path.c_str(), size - 8), 0);
+  }
+
+  std::string error;
+  EXPECT_FALSE(loadFlightLog(path, log, error));
+  EXPECT_FALSE(error.empty());
+  std::remove(path.c_str());
+}
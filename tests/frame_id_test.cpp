@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "frame_id.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(FrameId, MatchesOnlyTheInternedName) {
+  const InternedFrameId odom("drone0/odom");
+  EXPECT_TRUE(odom.matches("drone0/odom"));
+  EXPECT_TRUE(odom.matches(std::string("drone0/") + "odom"));
+  EXPECT_FALSE(odom.matches(""));
+  EXPECT_FALSE(odom.matches("odom"));
+  EXPECT_FALSE(odom.matches("drone1/odom"));
+  EXPECT_FALSE(odom.matches("drone0/odom/"));
+  EXPECT_EQ(odom.name(), "drone0/odom");
+}
+
+TEST(FrameId, UsualFramesOfAFleetOnlyMatchThemselves) {
+  const char *frames[] = {"odom", "map", "earth", "base_link"};
+  for (int i = 0; i < 100; i++) {
+    for (const char *frame : frames) {
+      const std::string name = "drone" + std::to_string(i) + "/" + frame;
+      const InternedFrameId interned(name);
+      for (int j = 0; j < 100; j++) {
+        for (const char *other : frames) {
+          const std::string other_name = "drone" + std::to_string(j) + "/" + other;
+          ASSERT_EQ(interned.matches(other_name), other_name == name) << name << " " << other_name;
+        }
+      }
+    }
+  }
+}
+
+TEST(FrameId, ReassignReplacesTheName) {
+  InternedFrameId frame;
+  EXPECT_TRUE(frame.matches(""));
+  frame.assign("base_link");
+  EXPECT_TRUE(frame.matches("base_link"));
+  EXPECT_FALSE(frame.matches(""));
+}
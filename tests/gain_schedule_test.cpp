@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "gain_schedule.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+const char *schedule_yaml = R"(
+profiles:
+  - name: nominal
+    mass: 0.82
+    antiwindup_cte: 1.0
+    points:
+      - speed: 0.0
+        kp: [6.0, 6.0, 6.0]
+        ki: [0.005, 0.005, 0.065]
+        kd: [1.5, 1.5, 3.0]
+        kp_ang: [5.5, 5.5, 2.0]
+      - speed: 4.0
+        kp: [8.0, 8.0, 7.0]
+        ki: [0.005, 0.005, 0.065]
+        kd: [2.5, 2.5, 3.0]
+        kp_ang: [7.5, 7.5, 2.0]
+  - name: payload
+    mass: 1.3
+    antiwindup_cte: 2.0
+    points:
+      - speed: 1.0
+        kp: [5.0, 5.0, 5.0]
+        ki: [0.01, 0.01, 0.1]
+        kd: [2.0, 2.0, 3.5]
+        kp_ang: [4.0, 4.0, 1.5]
+)";
+
+}  // namespace
+
+TEST(GainSchedule, InterpolatesOverSpeedAndHoldsTheEnds) {
+  GainSchedule schedule;
+  std::string error;
+  ASSERT_TRUE(schedule.loadString(schedule_yaml, error)) << error;
+  ASSERT_EQ(schedule.profileCount(), 2u);
+  EXPECT_EQ(schedule.findProfile("payload"), 1u);
+  EXPECT_EQ(schedule.findProfile("missing"), 2u);
+
+  DF_gains gains;
+  schedule.sample(0, 1.0, gains);
+  EXPECT_DOUBLE_EQ(gains.Kp(0, 0), 6.5);
+  EXPECT_DOUBLE_EQ(gains.Kp(2, 2), 6.25);
+  EXPECT_DOUBLE_EQ(gains.Kd(1, 1), 1.75);
+  EXPECT_DOUBLE_EQ(gains.Kp_ang(0, 0), 6.0);
+  EXPECT_EQ(gains.Kp(0, 1), 0.0);
+  EXPECT_EQ(gains.mass, 0.82);
+
+  schedule.sample(0, -1.0, gains);
+  EXPECT_EQ(gains.Kp(0, 0), 6.0);
+  schedule.sample(0, 10.0, gains);
+  EXPECT_EQ(gains.Kp(0, 0), 8.0);
+
+  // Single point profile, the same gains at every speed
+  schedule.sample(1, 3.0, gains);
+  EXPECT_EQ(gains.mass, 1.3);
+  EXPECT_EQ(gains.antiwindup_cte, 2.0);
+  EXPECT_EQ(gains.Ki(2, 2), 0.1);
+}
+
+TEST(GainSchedule, InvalidTablesAreRejectedAndKeepThePreviousOne) {
+  GainSchedule schedule;
+  std::string error;
+  ASSERT_TRUE(schedule.loadString(schedule_yaml, error)) << error;
+
+  EXPECT_FALSE(schedule.loadString("profiles: []", error));
+  EXPECT_FALSE(schedule.loadString(R"(
+profiles:
+  - name: bad
+    mass: 1.0
+    antiwindup_cte: 1.0
+    points:
+      - {speed: 1.0, kp: [1, 1, 1], ki: [0, 0, 0], kd: [1, 1, 1], kp_ang: [1, 1, 1]}
+      - {speed: 0.5, kp: [1, 1, 1], ki: [0, 0, 0], kd: [1, 1, 1], kp_ang: [1, 1, 1]}
+)",
+                                   error));
+  EXPECT_NE(error.find("increasing"), std::string::npos) << error;
+  EXPECT_FALSE(schedule.loadString(R"(
+profiles:
+  - name: short
+    mass: 1.0
+    antiwindup_cte: 1.0
+    points:
+      - {speed: 0.0, kp: [1, 1], ki: [0, 0, 0], kd: [1, 1, 1], kp_ang: [1, 1, 1]}
+)",
+                                   error));
+  EXPECT_FALSE(schedule.loadString("profiles: [{name: no_mass}]", error));
+  EXPECT_FALSE(schedule.loadFile("/nonexistent/schedule.yaml", error));
+
+  EXPECT_EQ(schedule.profileCount(), 2u);
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "health_events.hpp"
+#include "parameter_table.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(HealthEvents, RepeatedEventTakesOneSlot) {
+  HealthEvents events;
+  Health_record record;
+  EXPECT_FALSE(events.pop(record));
+
+  for (uint64_t i = 1; i <= 1000; i++) {
+    events.raise(Health_event::realtime_command_stale, i);
+  }
+  events.raise(Health_event::state_not_received);
+
+  ASSERT_TRUE(events.pop(record));
+  EXPECT_EQ(record.event, Health_event::realtime_command_stale);
+  EXPECT_EQ(record.detail, 1000u);
+  EXPECT_EQ(record.count, 1000u);
+  ASSERT_TRUE(events.pop(record));
+  EXPECT_EQ(record.event, Health_event::state_not_received);
+  EXPECT_FALSE(events.pop(record));
+
+  // Queued again by the next raise, the count keeps growing
+  events.raise(Health_event::realtime_command_stale, 7);
+  ASSERT_TRUE(events.pop(record));
+  EXPECT_EQ(record.detail, 7u);
+  EXPECT_EQ(record.count, 1001u);
+  EXPECT_EQ(events.getCount(Health_event::realtime_command_stale), 1001u);
+}
+
+TEST(HealthEvents, ThrottleCountsTheSuppressedRaises) {
+  HealthEventThrottle throttle;
+  uint64_t occurrences = 0;
+  Health_record record;
+  record.event = Health_event::state_not_received;
+
+  record.count = 1;
+  ASSERT_TRUE(throttle.admit(record, 10.0, occurrences));
+  EXPECT_EQ(occurrences, 1u);
+  record.count = 400;
+  EXPECT_FALSE(throttle.admit(record, 12.0, occurrences));
+  record.count = 600;
+  ASSERT_TRUE(throttle.admit(record, 15.0, occurrences));
+  EXPECT_EQ(occurrences, 599u);
+}
+
+TEST(HealthEvents, ThrottledRecordIsReportedOnceItsPeriodExpires) {
+  HealthEventThrottle throttle;
+  uint64_t occurrences = 0;
+  Health_record record;
+  record.event  = Health_event::unknown_control_mode;
+  record.detail = 42;
+  record.count  = 1;
+  ASSERT_TRUE(throttle.admit(record, 10.0, occurrences));
+
+  // Raised once more within the period and never again
+  record.count = 2;
+  EXPECT_FALSE(throttle.admit(record, 11.0, occurrences));
+  Health_record due;
+  EXPECT_FALSE(throttle.takeDue(12.0, due, occurrences));
+  ASSERT_TRUE(throttle.takeDue(15.0, due, occurrences));
+  EXPECT_EQ(due.event, Health_event::unknown_control_mode);
+  EXPECT_EQ(due.detail, 42u);
+  EXPECT_EQ(occurrences, 1u);
+  EXPECT_FALSE(throttle.takeDue(30.0, due, occurrences));
+
+  // A later admitted record replaces the pending one
+  record.count = 3;
+  EXPECT_FALSE(throttle.admit(record, 16.0, occurrences));
+  record.count = 4;
+  ASSERT_TRUE(throttle.admit(record, 21.0, occurrences));
+  EXPECT_EQ(occurrences, 2u);
+  EXPECT_FALSE(throttle.takeDue(30.0, due, occurrences));
+}
+
+TEST(HealthEvents, ChangedDetailsBypassTheThrottle) {
+  HealthEventThrottle throttle;
+  uint64_t occurrences = 0;
+  Health_record record;
+  record.event  = Health_event::parameters_missing;
+  record.detail = required_parameters_mask;
+  record.count  = 1;
+  ASSERT_TRUE(throttle.admit(record, 0.0, occurrences));
+  record.count = 2;
+  EXPECT_FALSE(throttle.admit(record, 0.1, occurrences));
+  record.detail = parameterBit(DF_parameter::mass);
+  record.count  = 3;
+  ASSERT_TRUE(throttle.admit(record, 0.2, occurrences));
+  EXPECT_EQ(occurrences, 2u);
+}
+
+TEST(HealthEvents, DescriptionsNameTheDetail) {
+  Health_record record;
+  record.event  = Health_event::parameters_missing;
+  record.detail = parameterBit(DF_parameter::mass) | parameterBit(DF_parameter::kp_z);
+  EXPECT_EQ(describeHealthEvent(record),
+            "Parameters not read yet: mass trajectory_control.kp.z");
+
+  record.event  = Health_event::realtime_command_stale;
+  record.detail = 25000;
+  EXPECT_EQ(describeHealthEvent(record), "Real-time thread command is 25 ms old");
+
+  for (std::size_t i = 0; i < health_event_count; i++) {
+    record.event = static_cast<Health_event>(i);
+    EXPECT_FALSE(describeHealthEvent(record).empty());
+    EXPECT_NE(health_event_info[i].level, Health_level::ok) << health_event_info[i].name;
+  }
+}
+
+TEST(HealthEvents, ReporterSeesEveryEventRaisedByTheTick) {
+  HealthEvents events;
+  const uint64_t n_ticks = 200000;
+  std::atomic<bool> done{false};
+
+  std::thread tick([&]() {
+    for (uint64_t i = 1; i <= n_ticks; i++) {
+      events.raise(static_cast<Health_event>(i % health_event_count), i);
+    }
+    done = true;
+  });
+
+  std::array<uint64_t, health_event_count> last_count{};
+  bool consistent = true;
+  const auto check = [&](const Health_record &_record) {
+    const std::size_t i = static_cast<std::size_t>(_record.event);
+    consistent &= _record.count >= last_count[i] && _record.detail % health_event_count == i;
+    last_count[i] = _record.count;
+  };
+  Health_record record;
+  while (!done) {
+    if (events.pop(record)) {
+      check(record);
+    }
+  }
+  tick.join();
+  while (events.pop(record)) {
+    check(record);
+  }
+
+  EXPECT_TRUE(consistent);
+  uint64_t total = 0;
+  for (std::size_t i = 0; i < health_event_count; i++) {
+    EXPECT_EQ(events.getCount(static_cast<Health_event>(i)), n_ticks / health_event_count);
+    total += events.getCount(static_cast<Health_event>(i));
+  }
+  EXPECT_EQ(total, n_ticks);
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+#include "latency_histogram.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(LatencyHistogram, BucketsAreContiguousAndBounded) {
+  std::size_t previous = 0;
+  for (uint64_t value = 0; value < (1u << 20); value++) {
+    const std::size_t index = LatencyHistogram::bucketIndex(value);
+    ASSERT_TRUE(index == previous || index == previous + 1) << value;
+    ASSERT_LE(value, LatencyHistogram::bucketUpperBound(index));
+    // Relative error below 2^-sub_bucket_bits
+    ASSERT_LE(LatencyHistogram::bucketUpperBound(index) - value,
+              value / LatencyHistogram::sub_bucket_count + 1);
+    previous = index;
+  }
+  EXPECT_EQ(LatencyHistogram::bucketIndex(UINT64_MAX), LatencyHistogram::bucket_count - 1);
+}
+
+TEST(LatencyHistogram, PercentilesOfUniformSamples) {
+  auto histogram = std::make_unique<LatencyHistogram>();
+  for (uint64_t value = 1; value <= 1000; value++) {
+    histogram->record(value * 100);
+  }
+
+  LatencyHistogram::Snapshot snapshot;
+  histogram->snapshot(snapshot);
+  EXPECT_EQ(snapshot.count, 1000u);
+  EXPECT_EQ(snapshot.max_ns, 100000u);
+  EXPECT_NEAR(snapshot.percentile(0.5), 50000.0, 50000.0 / 16);
+  EXPECT_NEAR(snapshot.percentile(0.99), 99000.0, 99000.0 / 16);
+  EXPECT_GE(snapshot.maxBucket(), 100000u);
+}
+
+TEST(LatencyHistogram, DifferenceCoversTheInterval) {
+  auto histogram = std::make_unique<LatencyHistogram>();
+  auto previous  = std::make_unique<LatencyHistogram::Snapshot>();
+  auto current   = std::make_unique<LatencyHistogram::Snapshot>();
+  auto interval  = std::make_unique<LatencyHistogram::Snapshot>();
+
+  histogram->record(1000000);
+  histogram->snapshot(*previous);
+  for (int i = 0; i < 10; i++) {
+    histogram->record(500);
+  }
+  histogram->snapshot(*current);
+  LatencyHistogram::difference(*current, *previous, *interval);
+
+  EXPECT_EQ(interval->count, 10u);
+  const uint64_t bucket_500 =
+      LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(500));
+  EXPECT_EQ(interval->percentile(1.0), bucket_500);
+  EXPECT_EQ(interval->maxBucket(), bucket_500);
+  EXPECT_EQ(interval->max_ns, 1000000u);
+}
+
+TEST(LatencyHistogram, ConcurrentSnapshotsAreMonotonic) {
+  auto histogram = std::make_unique<LatencyHistogram>();
+  std::thread writer([&histogram]() {
+    for (uint64_t i = 0; i < 200000; i++) {
+      histogram->record(i % 5000);
+    }
+  });
+
+  auto snapshot = std::make_unique<LatencyHistogram::Snapshot>();
+  uint64_t last = 0;
+  for (int i = 0; i < 100; i++) {
+    histogram->snapshot(*snapshot);
+    EXPECT_GE(snapshot->count, last);
+    last = snapshot->count;
+  }
+  writer.join();
+
+  histogram->snapshot(*snapshot);
+  EXPECT_EQ(snapshot->count, 200000u);
+  EXPECT_EQ(snapshot->max_ns, 4999u);
+}
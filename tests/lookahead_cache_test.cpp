@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "DF_control_law.hpp"
+#include "lookahead_cache.hpp"
+#include "trajectory_segment_store.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+/* x = t^3 / 6, y = sin-like cubic, z = 1 + t^2 / 2 and yaw = 0.5 t over [_start, _start + 10] */
+Trajectory_segment cubicSegment(double _start) {
+  Trajectory_segment segment;
+  segment.start               = _start;
+  segment.duration            = 10.0;
+  segment.coefficients(0, 3)  = 1.0 / 6.0;
+  segment.coefficients(1, 1)  = 1.0;
+  segment.coefficients(1, 3)  = -0.05;
+  segment.coefficients(2, 0)  = 1.0;
+  segment.coefficients(2, 2)  = 0.5;
+  segment.coefficients(3, 1)  = 0.5;
+  return segment;
+}
+
+/* Wait for the worker to build the current epoch up to _t */
+bool waitForSample(LookaheadCache &_cache, double _t, Flatness_sample &_sample) {
+  for (int i = 0; i < 2000; i++) {
+    if (_cache.sample(_t, _sample)) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(LookaheadCache, SamplesMatchTheSegmentsWithinTheInterpolationError) {
+  const Trajectory_segment segment = cubicSegment(100.0);
+  LookaheadCache cache;
+  Lookahead_options options;
+  options.sample_period = 0.002;
+  options.horizon       = 0.1;
+  ASSERT_TRUE(cache.reset(100.0, options));
+  ASSERT_TRUE(cache.pushSegment(segment));
+  cache.start();
+
+  Flatness_sample sample;
+  ASSERT_TRUE(waitForSample(cache, 100.0, sample));
+
+  for (double t = 100.0; t < 100.5; t += 0.0013) {
+    ASSERT_TRUE(waitForSample(cache, t, sample)) << t;
+    UAV_reference exact;
+    evaluateTrajectorySegment(segment, t, exact);
+    // Linear interpolation error is below h^2 / 8 times the second derivative
+    EXPECT_LT((sample.reference.position - exact.position).norm(), 1e-5);
+    EXPECT_LT((sample.reference.velocity - exact.velocity).norm(), 1e-5);
+    EXPECT_LT((sample.reference.acceleration - exact.acceleration).norm(), 1e-5);
+    EXPECT_NEAR(sample.reference.yaw, exact.yaw, 1e-9);
+
+    const Flatness_sample direct = makeFlatnessSample(exact);
+    EXPECT_LT((sample.specific_force - direct.specific_force).norm(), 1e-5);
+    EXPECT_LT((sample.heading.normalized() - direct.heading).norm(), 1e-6);
+  }
+  cache.stop();
+  EXPECT_GT(cache.getHits(), 0u);
+}
+
+TEST(LookaheadCache, YawIsInterpolatedAcrossTheWrap) {
+  // yaw = 3.0 + 2 t crosses pi at t = 0.07, between two samples
+  Trajectory_segment segment;
+  segment.start              = 0.0;
+  segment.duration           = 10.0;
+  segment.coefficients(3, 0) = 3.0;
+  segment.coefficients(3, 1) = 2.0;
+
+  LookaheadCache cache;
+  Lookahead_options options;
+  options.sample_period = 0.01;
+  options.horizon       = 0.1;
+  ASSERT_TRUE(cache.reset(0.0, options));
+  ASSERT_TRUE(cache.pushSegment(segment));
+  cache.start();
+
+  Flatness_sample sample;
+  for (double t = 0.0; t < 0.15; t += 0.0013) {
+    ASSERT_TRUE(waitForSample(cache, t, sample)) << t;
+    UAV_reference exact;
+    evaluateTrajectorySegment(segment, t, exact);
+    EXPECT_NEAR(std::remainder(sample.reference.yaw - exact.yaw, 2.0 * M_PI), 0.0, 1e-9) << t;
+    EXPECT_LE(std::abs(sample.reference.yaw), M_PI);
+  }
+  cache.stop();
+}
+
+TEST(LookaheadCache, NewSegmentsInvalidateTheCachedSamples) {
+  LookaheadCache cache;
+  ASSERT_TRUE(cache.reset(0.0, Lookahead_options()));
+  ASSERT_TRUE(cache.pushSegment(cubicSegment(0.0)));
+  cache.start();
+
+  Flatness_sample sample;
+  ASSERT_TRUE(waitForSample(cache, 0.01, sample));
+
+  // A replan from t = 0.02 on, hovering at a different altitude
+  Trajectory_segment hover;
+  hover.start             = 0.02;
+  hover.duration          = 10.0;
+  hover.coefficients(2, 0) = 5.0;
+  ASSERT_TRUE(cache.pushSegment(hover));
+  ASSERT_TRUE(waitForSample(cache, 0.05, sample));
+  EXPECT_NEAR(sample.reference.position.z(), 5.0, 1e-12);
+  EXPECT_NEAR(sample.specific_force.z(), 9.81, 1e-12);
+  cache.stop();
+}
+
+TEST(LookaheadCache, MissesWithoutSegmentsOrBeyondTheHorizon) {
+  LookaheadCache cache;
+  Flatness_sample sample;
+  EXPECT_FALSE(cache.sample(0.0, sample));
+
+  Lookahead_options options;
+  options.horizon = 0.05;
+  ASSERT_TRUE(cache.reset(0.0, options));
+  cache.start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_FALSE(cache.sample(0.0, sample));
+
+  ASSERT_TRUE(cache.pushSegment(cubicSegment(0.0)));
+  ASSERT_TRUE(waitForSample(cache, 0.0, sample));
+  // Going back in time is never served
+  ASSERT_TRUE(waitForSample(cache, 0.04, sample));
+  EXPECT_FALSE(cache.sample(0.0, sample));
+  EXPECT_FALSE(cache.sample(1.0, sample));
+  cache.stop();
+  EXPECT_GT(cache.getMisses(), 0u);
+}
+
+TEST(LookaheadCache, RefillsAfterAGapLongerThanTheHorizon) {
+  const Trajectory_segment segment = cubicSegment(0.0);
+  LookaheadCache cache;
+  Lookahead_options options;
+  options.sample_period = 0.002;
+  options.horizon       = 0.1;
+  ASSERT_TRUE(cache.reset(0.0, options));
+  ASSERT_TRUE(cache.pushSegment(segment));
+  cache.start();
+
+  Flatness_sample sample;
+  ASSERT_TRUE(waitForSample(cache, 0.01, sample));
+  // A 0.3 s tick gap, then ticks every 10 ms again
+  for (double t = 0.31; t < 1.31; t += 0.01) {
+    ASSERT_TRUE(waitForSample(cache, t, sample)) << t;
+    UAV_reference exact;
+    evaluateTrajectorySegment(segment, t, exact);
+    EXPECT_LT((sample.reference.position - exact.position).norm(), 1e-5) << t;
+  }
+  cache.stop();
+}
+
+TEST(LookaheadCache, ConsumerRacingTheWorkerAlwaysGetsConsistentSamples) {
+  // Constant velocity along x, so any mix of two samples shows as a wrong position
+  Trajectory_segment segment;
+  segment.start              = 0.0;
+  segment.duration           = 100.0;
+  segment.coefficients(0, 1) = 1.0;
+
+  LookaheadCache cache;
+  Lookahead_options options;
+  options.sample_period = 0.0001;
+  options.horizon       = 0.02;
+  ASSERT_TRUE(cache.reset(0.0, options));
+  ASSERT_TRUE(cache.pushSegment(segment));
+  cache.start();
+
+  Flatness_sample sample;
+  ASSERT_TRUE(waitForSample(cache, 0.0, sample));
+
+  // Trajectory time follows the wall clock, the worker refills behind a consumer polling nonstop
+  std::size_t hits                                 = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (double t = 0.0; t < 0.5;
+       t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()) {
+    if (cache.sample(t, sample)) {
+      ASSERT_NEAR(sample.reference.position.x(), t, 1e-9);
+      ASSERT_NEAR(sample.reference.velocity.x(), 1.0, 1e-12);
+      hits++;
+    }
+  }
+  cache.stop();
+  EXPECT_GT(hits, 1000u);
+}
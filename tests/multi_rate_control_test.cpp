@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include "DF_control_law.hpp"
+#include "closed_loop_simulation.hpp"
+#include "multi_rate_control.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+DF_gains defaultGains() {
+  DF_gains gains;
+  gains.mass              = 0.82;
+  gains.antiwindup_cte    = 1.0;
+  gains.Kp.diagonal()     = Eigen::Vector3d(6.0, 6.0, 6.0);
+  gains.Ki.diagonal()     = Eigen::Vector3d(0.005, 0.005, 0.065);
+  gains.Kd.diagonal()     = Eigen::Vector3d(1.5, 1.5, 3.0);
+  gains.Kp_ang.diagonal() = Eigen::Vector3d(5.5, 5.5, 2.0);
+  return gains;
+}
+
+}  // namespace
+
+TEST(MultiRateControl, OuterLoopRunsAtItsRate) {
+  MultiRateControl multi_rate;
+  multi_rate.setRate(100.0);
+
+  double outer_dt = 0.0;
+  ASSERT_TRUE(multi_rate.outerLoopDue(0.002, outer_dt));  // nothing stored yet
+  EXPECT_EQ(outer_dt, 0.002);
+  multi_rate.storeOuterLoop(Eigen::Vector3d::UnitZ(), Eigen::Matrix3d::Identity());
+
+  int runs = 0;
+  for (int tick = 0; tick < 500; tick++) {
+    if (multi_rate.outerLoopDue(0.002, outer_dt)) {
+      EXPECT_NEAR(outer_dt, 0.01, 1e-9);
+      runs++;
+    }
+  }
+  EXPECT_EQ(runs, 100);
+
+  multi_rate.invalidate();
+  EXPECT_TRUE(multi_rate.outerLoopDue(0.002, outer_dt));
+  multi_rate.storeOuterLoop(Eigen::Vector3d::UnitZ(), Eigen::Matrix3d::Identity());
+  multi_rate.setRate(50.0);
+  EXPECT_TRUE(multi_rate.outerLoopDue(0.002, outer_dt));
+}
+
+TEST(MultiRateControl, SingleRateMatchesTheLaw) {
+  DFControlLaw reference(defaultGains());
+  DFControlLaw law(defaultGains());
+  MultiRateControl multi_rate;
+
+  const Eigen::Matrix3d rot =
+      Eigen::AngleAxisd(0.3, Eigen::Vector3d(1, 2, 3).normalized()).toRotationMatrix();
+  for (int i = 0; i < 100; i++) {
+    const Eigen::Vector3d position(0.01 * i, -0.5, 1.0);
+    const Acro_command a = reference.computeTrajectoryControl(
+        0.01, position, Eigen::Vector3d::Zero(), rot, Eigen::Vector3d(1.0, 0.5, 1.5),
+        Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), 0.7);
+    const Acro_command b = computeMultiRateControl(
+        law, multi_rate, 0.01, position, Eigen::Vector3d::Zero(), rot,
+        Eigen::Vector3d(1.0, 0.5, 1.5), Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), 0.7);
+    ASSERT_EQ(a.thrust, b.thrust);
+    ASSERT_EQ(a.PQR, b.PQR);
+  }
+}
+
+TEST(MultiRateControl, FastAttitudeLoopTracksInClosedLoop) {
+  for (const char *name : {"step", "circle", "lemniscate"}) {
+    Simulation_options single_rate;
+    ASSERT_TRUE(parseReferenceTrajectory(name, single_rate.trajectory));
+
+    // Attitude loop at 500 Hz, position loop at the 100 Hz of the single rate run
+    Simulation_options multi_rate = single_rate;
+    multi_rate.control_dt         = 0.002;
+    multi_rate.plant_substeps     = 2;
+    multi_rate.outer_loop_rate    = 100.0;
+
+    DFControlLawVariant a{DFControlLaw(defaultGains())};
+    DFControlLawVariant b{DFControlLaw(defaultGains())};
+    const Tracking_metrics single = simulateClosedLoop(a, single_rate);
+    const Tracking_metrics multi  = simulateClosedLoop(b, multi_rate);
+    EXPECT_FALSE(multi.diverged) << name;
+    EXPECT_LT(multi.rms_position_error, 1.2 * single.rms_position_error) << name;
+  }
+}
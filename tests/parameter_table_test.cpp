@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "parameter_table.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(ParameterTable, EveryNameMapsToItsParameter) {
+  for (std::size_t i = 0; i < parameter_count; i++) {
+    EXPECT_EQ(findParameter(parameter_names[i]), static_cast<DF_parameter>(i))
+        << parameter_names[i];
+  }
+}
+
+TEST(ParameterTable, UnprefixedNamesMapToTheirParameter) {
+  for (std::size_t i = 0; i < parameter_count; i++) {
+    const std::string_view alias = parameterAlias(i);
+    if (!alias.empty()) {
+      EXPECT_EQ(findParameter(alias), static_cast<DF_parameter>(i)) << alias;
+    }
+  }
+  EXPECT_EQ(findParameter("kp.x"), DF_parameter::kp_x);
+  EXPECT_EQ(findParameter("roll_control.kp"), DF_parameter::roll_kp);
+}
+
+TEST(ParameterTable, UnknownNamesAreRejected) {
+  EXPECT_EQ(findParameter(""), DF_parameter::unknown);
+  EXPECT_EQ(findParameter("kp.w"), DF_parameter::unknown);
+  EXPECT_EQ(findParameter("trajectory_control.kp.w"), DF_parameter::unknown);
+  EXPECT_EQ(findParameter("trajectory_control.mass"), DF_parameter::unknown);
+  EXPECT_EQ(findParameter(std::string("trajectory_control.kp.x") + "x"), DF_parameter::unknown);
+}
+
+TEST(ParameterTable, RequiredMaskCoversRequiredParameters) {
+  uint32_t mask = 0;
+  for (std::size_t i = 0; i < required_parameter_count; i++) {
+    mask |= parameterBit(static_cast<DF_parameter>(i));
+  }
+  EXPECT_EQ(mask, required_parameters_mask);
+  EXPECT_EQ(required_parameters_mask & parameterBit(DF_parameter::law_scalar_type), 0u);
+  EXPECT_EQ(parameterBit(DF_parameter::gain_schedule_profile), 0u);
+}
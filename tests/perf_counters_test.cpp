@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "perf_counters.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(PerfCounters, CountTheCallingThread) {
+  PerfCounterGroup group;
+  const int error = group.open();
+  if (error != 0) {
+    GTEST_SKIP() << "Hardware counters not available: " << std::strerror(error);
+  }
+  ASSERT_TRUE(group.isOpen());
+  ASSERT_TRUE(group.isAvailable(Perf_event::cycles));
+
+  Perf_sample start;
+  Perf_sample end;
+  ASSERT_TRUE(group.read(start));
+  volatile double sum = 0.0;
+  for (int i = 0; i < 1000000; i++) {
+    sum = sum + i;
+  }
+  ASSERT_TRUE(group.read(end));
+
+  EXPECT_GT(end.values[0], start.values[0]);
+  if (group.isAvailable(Perf_event::instructions)) {
+    // At least an add, a compare and a branch per iteration
+    EXPECT_GT(end.values[1] - start.values[1], 3000000u);
+  }
+
+  group.close();
+  EXPECT_FALSE(group.isOpen());
+  EXPECT_FALSE(group.read(end));
+}
+
+TEST(PerfCounters, StageSummariesAreMeansOfTheDeltas) {
+  PerfStageCounters counters;
+  Perf_sample start;
+  Perf_sample end;
+  start.values = {1000, 500, 7, 3};
+  end.values   = {1400, 1300, 9, 3};
+  counters.record(start, end);
+  start.values = {0, 0, 0, 0};
+  end.values   = {600, 1200, 4, 2};
+  counters.record(start, end);
+
+  PerfStageCounters::Snapshot snapshot;
+  counters.snapshot(snapshot);
+  EXPECT_EQ(snapshot.samples, 2u);
+  EXPECT_EQ(snapshot.mean(Perf_event::cycles), 500.0);
+  EXPECT_EQ(snapshot.mean(Perf_event::instructions), 1000.0);
+  EXPECT_EQ(snapshot.mean(Perf_event::cache_misses), 3.0);
+  EXPECT_EQ(snapshot.mean(Perf_event::branch_misses), 1.0);
+  EXPECT_EQ(snapshot.ipc(), 2.0);
+
+  PerfStageCounters::Snapshot empty;
+  EXPECT_EQ(empty.mean(Perf_event::cycles), 0.0);
+  EXPECT_EQ(empty.ipc(), 0.0);
+}
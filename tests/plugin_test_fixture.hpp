@@ -0,0 +1,108 @@
+#ifndef __PLUGIN_TEST_FIXTURE_H__
+#define __PLUGIN_TEST_FIXTURE_H__
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "as2_core/node.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+#include "DF_controller_plugin.hpp"
+
+namespace df = controller_plugin_differential_flatness;
+
+/* Gains of config/default_controller.yaml */
+inline const std::vector<rclcpp::Parameter> default_parameters = {
+    rclcpp::Parameter("mass", 0.82),
+    rclcpp::Parameter("trajectory_control.antiwindup_cte", 1.0),
+    rclcpp::Parameter("trajectory_control.alpha", 0.1),
+    rclcpp::Parameter("trajectory_control.kp.x", 6.0),
+    rclcpp::Parameter("trajectory_control.kp.y", 6.0),
+    rclcpp::Parameter("trajectory_control.kp.z", 6.0),
+    rclcpp::Parameter("trajectory_control.ki.x", 0.005),
+    rclcpp::Parameter("trajectory_control.ki.y", 0.005),
+    rclcpp::Parameter("trajectory_control.ki.z", 0.065),
+    rclcpp::Parameter("trajectory_control.kd.x", 1.5),
+    rclcpp::Parameter("trajectory_control.kd.y", 1.5),
+    rclcpp::Parameter("trajectory_control.kd.z", 3.0),
+    rclcpp::Parameter("trajectory_control.roll_control.kp", 5.5),
+    rclcpp::Parameter("trajectory_control.pitch_control.kp", 5.5),
+    rclcpp::Parameter("trajectory_control.yaw_control.kp", 2.0),
+};
+
+/* Plugin on its own node with the default gains, in trajectory mode */
+class PluginFixture : public ::testing::Test {
+protected:
+  std::shared_ptr<as2::Node> node_;
+  std::shared_ptr<df::Plugin> plugin_;
+
+  geometry_msgs::msg::PoseStamped pose_;
+  geometry_msgs::msg::TwistStamped twist_;
+  as2_msgs::msg::Thrust thrust_;
+
+  static void SetUpTestSuite() { rclcpp::init(0, nullptr); }
+  static void TearDownTestSuite() { rclcpp::shutdown(); }
+
+  void SetUp() override { startPlugin(default_parameters); }
+
+  void TearDown() override {
+    plugin_.reset();
+    node_.reset();
+  }
+
+  /* Replace the plugin with one initialized on a new node with _parameters */
+  void startPlugin(const std::vector<rclcpp::Parameter> &_parameters) {
+    plugin_.reset();
+    node_.reset();
+
+    rclcpp::NodeOptions options;
+    options.automatically_declare_parameters_from_overrides(true);
+    options.parameter_overrides(_parameters);
+    node_ = std::make_shared<as2::Node>("df_plugin_test", options);
+
+    plugin_ = std::make_shared<df::Plugin>();
+    plugin_->initialize(node_.get());
+    std::vector<std::string> param_names;
+    for (auto &param : _parameters) {
+      param_names.push_back(param.get_name());
+    }
+    ASSERT_TRUE(plugin_->updateParams(param_names));
+    ASSERT_TRUE(setTrajectoryMode());
+  }
+
+  bool setTrajectoryMode() {
+    as2_msgs::msg::ControlMode mode_in;
+    mode_in.control_mode = as2_msgs::msg::ControlMode::TRAJECTORY;
+    mode_in.yaw_mode     = as2_msgs::msg::ControlMode::YAW_ANGLE;
+    as2_msgs::msg::ControlMode mode_out;
+    mode_out.control_mode = as2_msgs::msg::ControlMode::ACRO;
+    return plugin_->setMode(mode_in, mode_out);
+  }
+
+  /* Moving towards a fixed reference 1 m ahead and 0.5 m above, so the integral grows on every
+   * tick */
+  void feedInputs() {
+    geometry_msgs::msg::PoseStamped pose;
+    pose.header.frame_id    = plugin_->getDesiredPoseFrameId();
+    pose.header.stamp       = node_->now();
+    pose.pose.position.z    = 1.0;
+    pose.pose.orientation.w = 1.0;
+    geometry_msgs::msg::TwistStamped twist;
+    twist.header.frame_id = plugin_->getDesiredTwistFrameId();
+    twist.twist.linear.x  = 0.5;
+    plugin_->updateState(pose, twist);
+
+    as2_msgs::msg::TrajectoryPoint reference;
+    reference.header.stamp = node_->now();
+    reference.position.x   = 1.0;
+    reference.position.z   = 1.5;
+    reference.twist.x      = 0.4;
+    reference.yaw_angle    = 0.3;
+    plugin_->updateReference(reference);
+  }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "plugin_test_fixture.hpp"
+
+namespace {
+
+class PluginTick : public PluginFixture {
+protected:
+  /* Keep the integral over ticks instead of clearing it before every one */
+  void carryIntegral() {
+    plugin_->parametersCallback({rclcpp::Parameter("trajectory_control.reset_integral", false)});
+  }
+
+  /* Integral after one more tick on the same inputs */
+  Eigen::Vector3d tick() {
+    feedInputs();
+    EXPECT_TRUE(plugin_->computeOutput(0.01, pose_, twist_, thrust_));
+    return plugin_->takeSnapshot().integral;
+  }
+};
+
+}  // namespace
+
+TEST_F(PluginTick, IntegralAccumulatesAcrossTicks) {
+  carryIntegral();
+  const Eigen::Vector3d first  = tick();
+  const Eigen::Vector3d second = tick();
+  const Eigen::Vector3d third  = tick();
+  EXPECT_GT(first.norm(), 0.0);
+  EXPECT_GT(second.norm(), first.norm());
+  EXPECT_GT(third.norm(), second.norm());
+}
+
+TEST_F(PluginTick, IntegralResetsOnNewMode) {
+  carryIntegral();
+  const Eigen::Vector3d first = tick();
+  tick();
+  tick();
+
+  // The first tick of the new mode starts from a zero integral
+  ASSERT_TRUE(setTrajectoryMode());
+  EXPECT_TRUE(tick().isApprox(first));
+}
+
+TEST_F(PluginTick, IntegralIsClearedEveryTickByDefault) {
+  const Eigen::Vector3d first = tick();
+  EXPECT_GT(first.norm(), 0.0);
+  EXPECT_TRUE(tick().isApprox(first));
+  EXPECT_TRUE(tick().isApprox(first));
+}
+
+TEST_F(PluginTick, StandbyPairHandsOverOnlyACarriedIntegral) {
+  const std::string channel = "/df_plugin_tick_test_standby";
+  plugin_->parametersCallback({
+      rclcpp::Parameter("trajectory_control.standby.role", "primary"),
+      rclcpp::Parameter("trajectory_control.standby.channel", channel),
+  });
+  df::SnapshotChannelReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.open(channel, error)) << error;
+  df::Controller_snapshot snapshot;
+  uint64_t sequence = 0;
+
+  // reset_integral still clears it every tick in a pair, and the snapshots leave it out
+  const Eigen::Vector3d first = tick();
+  EXPECT_TRUE(tick().isApprox(first));
+  ASSERT_TRUE(reader.read(snapshot, sequence));
+  EXPECT_TRUE(snapshot.integral.isZero());
+
+  carryIntegral();
+  tick();
+  const Eigen::Vector3d carried = tick();
+  EXPECT_GT(carried.norm(), first.norm());
+  ASSERT_TRUE(reader.read(snapshot, sequence));
+  EXPECT_TRUE(snapshot.integral.isApprox(carried));
+
+  reader.close();
+  plugin_.reset();
+  df::SnapshotChannelWriter::remove(channel);
+}
+
+/* The state and reference callbacks run on other executor threads than the tick. Run under an
+ * ENABLE_TSAN build to check the buffers between them */
+TEST_F(PluginTick, InputsUpdateConcurrentlyWithTicks) {
+  feedInputs();
+  std::atomic<bool> done{false};
+
+  std::thread state_thread([this, &done] {
+    geometry_msgs::msg::PoseStamped pose;
+    pose.header.frame_id    = plugin_->getDesiredPoseFrameId();
+    pose.pose.orientation.w = 1.0;
+    geometry_msgs::msg::TwistStamped twist;
+    twist.header.frame_id = plugin_->getDesiredTwistFrameId();
+    for (int i = 0; !done.load(); i++) {
+      pose.header.stamp    = node_->now();
+      pose.pose.position.z = 1.0 + 0.001 * (i % 100);
+      twist.twist.linear.z = 0.01 * (i % 10);
+      plugin_->updateState(pose, twist);
+    }
+  });
+
+  std::thread reference_thread([this, &done] {
+    as2_msgs::msg::TrajectoryPoint reference;
+    for (int i = 0; !done.load(); i++) {
+      reference.header.stamp = node_->now();
+      reference.position.z   = 1.5 + 0.001 * (i % 100);
+      reference.yaw_angle    = 0.01 * (i % 10);
+      plugin_->updateReference(reference);
+    }
+  });
+
+  for (int i = 0; i < 2000; i++) {
+    EXPECT_TRUE(plugin_->computeOutput(0.01, pose_, twist_, thrust_));
+    EXPECT_TRUE(std::isfinite(thrust_.thrust));
+    EXPECT_TRUE(std::isfinite(twist_.twist.angular.x));
+  }
+  done = true;
+  state_thread.join();
+  reference_thread.join();
+}
+
+TEST_F(PluginTick, OdometryTopicReplacesPoseAndTwist) {
+  std::vector<rclcpp::Parameter> parameters = default_parameters;
+  parameters.emplace_back("trajectory_control.odometry_topic", "odometry");
+  startPlugin(parameters);
+
+  // Pose and twist pairs are ignored, the odometry is the only state source
+  feedInputs();
+  EXPECT_FALSE(plugin_->computeOutput(0.01, pose_, twist_, thrust_));
+  EXPECT_EQ(plugin_->getHealthEvents(df::Health_event::state_not_received), 1u);
+
+  nav_msgs::msg::Odometry odometry;
+  odometry.header.frame_id         = plugin_->getDesiredPoseFrameId();
+  odometry.header.stamp            = node_->now();
+  odometry.child_frame_id          = plugin_->getDesiredTwistFrameId();
+  odometry.pose.pose.position.z    = 1.0;
+  odometry.pose.pose.orientation.w = 1.0;
+  plugin_->updateOdometry(odometry);
+  EXPECT_TRUE(plugin_->computeOutput(0.01, pose_, twist_, thrust_));
+  EXPECT_EQ(node_->count_subscribers("odometry"), 1u);
+}
@@ -1,37 +1,38 @@
 find_package(benchmark QUIET)
-if (${benckmark_FOUND})
+if (${benchmark_FOUND})
   MESSAGE(STATUS "Found Google Benchmark.")
-else (${benckmark_FOUND})
+else (${benchmark_FOUND})
   MESSAGE(STATUS "Could not find Google Benchmark.")
   include(FetchContent)
   FetchContent_Declare(
   benchmark
   URL https://github.com/google/benchmark/archive/fe2e8aa1b4b01a8d2a7675c1edb3fb0ed48ce11c.zip
   )
-  set(BENCHMARK_ENABLE_TESTING FALSE) 
+  set(BENCHMARK_ENABLE_TESTING FALSE)
   FetchContent_MakeAvailable(benchmark)
 
+endif(${benchmark_FOUND})
 
-endif(${benckmark_FOUND})
+# find all *benchmark.cpp files in the tests directory
+file(GLOB BENCHMARK_SOURCES tests/*benchmark.cpp)
 
-include(GoogleTest)
+# create a benchmark executable for each file, and a run_<name> target that stores a JSON report
+foreach(BENCHMARK_SOURCE ${BENCHMARK_SOURCES})
 
-enable_testing()
-# find all *.cpp files in the tests directory
+  get_filename_component(BENCHMARK_NAME ${BENCHMARK_SOURCE} NAME_WE)
 
-file(GLOB TEST_SOURCES tests/*benchmark.cpp )
-
-# create a test executable for each test file
-foreach(TEST_SOURCE ${TEST_SOURCES})
-
-  get_filename_component(_src_filename ${TEST_SOURCE} NAME)
-  string(LENGTH ${_src_filename} name_length)
-  math(EXPR final_length  "${name_length}-4") # remove .cpp of the name
-  string(SUBSTRING ${_src_filename} 0 ${final_length} TEST_NAME)
-  
-  add_executable(${TEST_NAME}_test ${TEST_SOURCE} ${SOURCE_CPP_FILES})
-  ament_target_dependencies(${TEST_NAME}_test  ${PROJECT_DEPENDENCIES})
-  target_link_libraries(${TEST_NAME}_test benchmark::benchmark )
+  add_executable(${BENCHMARK_NAME} ${BENCHMARK_SOURCE})
+  ament_target_dependencies(${BENCHMARK_NAME} ${PROJECT_DEPENDENCIES})
+  target_link_libraries(${BENCHMARK_NAME} ${PROJECT_NAME} ${CONTROL_LAW_LIBRARY} benchmark::benchmark)
 
+  add_custom_target(run_${BENCHMARK_NAME}
+    COMMAND ${BENCHMARK_NAME}
+      --benchmark_out=${CMAKE_BINARY_DIR}/${BENCHMARK_NAME}.json
+      --benchmark_out_format=json
+      --benchmark_repetitions=5
+      --benchmark_report_aggregates_only=true
+    DEPENDS ${BENCHMARK_NAME}
+    WORKING_DIRECTORY ${CMAKE_BINARY_DIR}
+    COMMENT "Running ${BENCHMARK_NAME}, JSON report in ${CMAKE_BINARY_DIR}/${BENCHMARK_NAME}.json")
 
   endforeach()
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <sched.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "realtime_thread.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(PeriodicThread, TicksAtItsRateAfterSetup) {
+  Realtime_options options;
+  options.rate        = 1000.0;
+  options.priority    = 0;  // SCHED_FIFO needs privileges the test may not have
+  options.lock_memory = false;
+
+  std::atomic<bool> setup_done{false};
+  std::atomic<int> ticks_before_setup{0};
+  std::atomic<int> ticks{0};
+  std::atomic<double> max_dt{0.0};
+
+  PeriodicThread thread;
+  std::string error;
+  ASSERT_TRUE(thread.start(
+      options, [&]() { setup_done = true; },
+      [&](double dt) {
+        if (!setup_done) {
+          ticks_before_setup++;
+        }
+        ticks++;
+        if (dt > max_dt) {
+          max_dt = dt;
+        }
+      },
+      error))
+      << error;
+  EXPECT_TRUE(setup_done);
+  EXPECT_TRUE(thread.running());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  thread.stop();
+  EXPECT_FALSE(thread.running());
+
+  const int count = ticks;
+  EXPECT_EQ(ticks_before_setup, 0);
+  EXPECT_EQ(thread.getTicks(), static_cast<uint64_t>(count));
+  EXPECT_GT(count, 50);
+  EXPECT_LT(count, 250);
+  EXPECT_GT(max_dt, 0.0);
+
+  // Stopped threads stay stopped
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(ticks, count);
+}
+
+TEST(PeriodicThread, PinsToTheRequestedCpu) {
+  Realtime_options options;
+  options.rate        = 1000.0;
+  options.priority    = 0;
+  options.cpu         = 0;
+  options.lock_memory = false;
+
+  std::atomic<int> cpu{-1};
+  PeriodicThread thread;
+  std::string error;
+  ASSERT_TRUE(thread.start(options, nullptr, [&cpu](double) { cpu = sched_getcpu(); }, error))
+      << error;
+  while (thread.getTicks() == 0) {
+    std::this_thread::yield();
+  }
+  thread.stop();
+  EXPECT_EQ(cpu, 0);
+}
+
+TEST(RealtimeThread, PrefaultStackAndFailuresAreReported) {
+  prefaultStack(1024 * 1024);
+
+  std::string error;
+  EXPECT_FALSE(setCurrentThreadRealtime(0, CPU_SETSIZE + 1, error));
+  EXPECT_FALSE(error.empty());
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "state_predictor.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(StatePredictor, ConstantAccelerationIsExact) {
+  Eigen::Vector3d position(1.0, 2.0, 3.0);
+  Eigen::Vector3d velocity(0.5, 0.0, -1.0);
+  Eigen::Quaterniond attitude = Eigen::Quaterniond::Identity();
+
+  propagateState(0.03, Eigen::Vector3d(2.0, 0.0, 1.0), Eigen::Vector3d::Zero(), position,
+                 velocity, attitude);
+
+  EXPECT_NEAR(position.x(), 1.0 + 0.5 * 0.03 + 0.5 * 2.0 * 0.03 * 0.03, 1e-12);
+  EXPECT_NEAR(position.z(), 3.0 - 1.0 * 0.03 + 0.5 * 1.0 * 0.03 * 0.03, 1e-12);
+  EXPECT_NEAR(velocity.x(), 0.5 + 2.0 * 0.03, 1e-12);
+  EXPECT_NEAR(velocity.z(), -1.0 + 1.0 * 0.03, 1e-12);
+  EXPECT_TRUE(attitude.isApprox(Eigen::Quaterniond::Identity()));
+}
+
+TEST(StatePredictor, BodyRatesRotateInBodyFrame) {
+  Eigen::Vector3d position = Eigen::Vector3d::Zero();
+  Eigen::Vector3d velocity = Eigen::Vector3d::Zero();
+  // Pitched 90 degrees, a body yaw rate turns about the world x axis
+  Eigen::Quaterniond attitude(Eigen::AngleAxisd(M_PI_2, Eigen::Vector3d::UnitY()));
+
+  propagateState(0.1, Eigen::Vector3d::Zero(), Eigen::Vector3d(0.0, 0.0, 1.0), position, velocity,
+                 attitude);
+
+  const Eigen::Quaterniond expected =
+      Eigen::Quaterniond(Eigen::AngleAxisd(M_PI_2, Eigen::Vector3d::UnitY())) *
+      Eigen::Quaterniond(Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitZ()));
+  EXPECT_TRUE(attitude.isApprox(expected, 1e-12));
+  EXPECT_NEAR(attitude.norm(), 1.0, 1e-12);
+}
+
+TEST(StatePredictor, HoverThrustCancelsGravity) {
+  const Eigen::Vector3d acceleration =
+      commandedAcceleration(0.82 * 9.81, 0.82, Eigen::Quaterniond::Identity());
+  EXPECT_NEAR(acceleration.norm(), 0.0, 1e-12);
+
+  EXPECT_EQ(commandedAcceleration(0.0, 0.82, Eigen::Quaterniond::Identity()),
+            Eigen::Vector3d::Zero());
+}
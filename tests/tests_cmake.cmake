@@ -1,7 +1,7 @@
-find_package(gtest QUIET)
-if (${Gtest_FOUND})
+find_package(GTest QUIET)
+if (${GTest_FOUND})
   MESSAGE(STATUS "Found Gtest.")
-else (${Gtest_FOUND})
+else (${GTest_FOUND})
   MESSAGE(STATUS "Could not locate Gtest.")
   include(FetchContent)
   FetchContent_Declare(
@@ -12,14 +12,53 @@ else (${Gtest_FOUND})
   set(gtest_force_shared_crt ON CACHE BOOL "" FORCE)
   FetchContent_MakeAvailable(googletest)
 
-endif(${Gtest_FOUND})
+endif(${GTest_FOUND})
 
 include(GoogleTest)
 
 enable_testing()
-# find all *.cpp files in the tests directory
 
-file(GLOB TEST_SOURCES tests/*test.cpp )
+# plugin_test.cpp is a manual node that needs a running aerostack2 setup, so it is not listed here
+set(TEST_SOURCES
+  tests/control_law_test.cpp
+  tests/control_law_batch_test.cpp
+  tests/triple_buffer_test.cpp
+  tests/trajectory_reference_buffer_test.cpp
+  tests/trajectory_segment_store_test.cpp
+  tests/state_predictor_test.cpp
+  tests/parameter_table_test.cpp
+  tests/frame_id_test.cpp
+  tests/latency_histogram_test.cpp
+  tests/flight_replay_test.cpp
+  tests/thread_pool_test.cpp
+  tests/controller_config_test.cpp
+  tests/closed_loop_simulation_test.cpp
+  tests/multi_rate_control_test.cpp
+  tests/realtime_thread_test.cpp
+  tests/gain_schedule_test.cpp
+  tests/flight_recorder_test.cpp
+  tests/perf_counters_test.cpp
+  tests/command_mailbox_test.cpp
+  tests/lookahead_cache_test.cpp
+  tests/controller_snapshot_test.cpp
+  tests/health_events_test.cpp
+  tests/compute_output_allocation_test.cpp
+  tests/plugin_tick_test.cpp
+)
+
+# Concurrency tests, labelled so an ENABLE_TSAN build can run them alone with ctest -L concurrency
+set(TSAN_TESTS
+  triple_buffer_test
+  latency_histogram_test
+  thread_pool_test
+  realtime_thread_test
+  flight_recorder_test
+  command_mailbox_test
+  lookahead_cache_test
+  controller_snapshot_test
+  health_events_test
+  plugin_tick_test
+)
 
 # create a test executable for each test file
 foreach(TEST_SOURCE ${TEST_SOURCES})
@@ -28,13 +67,16 @@ foreach(TEST_SOURCE ${TEST_SOURCES})
   string(LENGTH ${_src_filename} name_length)
   math(EXPR final_length  "${name_length}-4") # remove .cpp of the name
   string(SUBSTRING ${_src_filename} 0 ${final_length} TEST_NAME)
-  
-  message(STATUS ${SOURCE_CPP_FILES})
-  add_executable(${TEST_NAME}_test ${TEST_SOURCE} ${SOURCE_CPP_FILES} )
-  ament_target_dependencies(${TEST_NAME}_test  ${PROJECT_DEPENDENCIES})
-  target_link_libraries(${TEST_NAME}_test gtest_main)
+
+  add_executable(${TEST_NAME} ${TEST_SOURCE})
+  ament_target_dependencies(${TEST_NAME} ${PROJECT_DEPENDENCIES})
+  target_link_libraries(${TEST_NAME} ${PROJECT_NAME} ${CONTROL_LAW_LIBRARY} GTest::gtest_main)
 
   # add the test executable to the list of executables to build
-  gtest_discover_tests(${TEST_NAME}_test)
+  if(${TEST_NAME} IN_LIST TSAN_TESTS)
+    gtest_discover_tests(${TEST_NAME} PROPERTIES LABELS concurrency)
+  else()
+    gtest_discover_tests(${TEST_NAME})
+  endif()
 
   endforeach()
@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+TEST(ThreadPool, EveryIndexRunsOnce) {
+  ThreadPool pool(4);
+  EXPECT_EQ(pool.size(), 4u);
+
+  for (std::size_t count : {0, 1, 3, 1000}) {
+    std::vector<std::atomic<int>> calls(count);
+    pool.parallelFor(count, [&calls](std::size_t i) { calls[i]++; });
+    for (std::size_t i = 0; i < count; i++) {
+      ASSERT_EQ(calls[i].load(), 1) << i;
+    }
+  }
+}
+
+TEST(ThreadPool, SingleThreadRunsOnCaller) {
+  ThreadPool pool(1);
+  EXPECT_EQ(pool.size(), 1u);
+
+  std::size_t sum = 0;
+  pool.parallelFor(100, [&sum](std::size_t i) { sum += i; });
+  EXPECT_EQ(sum, 4950u);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "trajectory_reference_buffer.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+/* Point of x(t) = t^2 along the x axis */
+Timed_reference parabolaPoint(double t) {
+  Timed_reference point;
+  point.stamp                  = t;
+  point.reference.position     = Eigen::Vector3d(t * t, 0.0, 1.0);
+  point.reference.velocity     = Eigen::Vector3d(2.0 * t, 0.0, 0.0);
+  point.reference.acceleration = Eigen::Vector3d(2.0, 0.0, 0.0);
+  return point;
+}
+
+}  // namespace
+
+TEST(TrajectoryReferenceBuffer, HermiteInterpolationIsExactForQuadratics) {
+  TrajectoryReferenceBuffer buffer;
+  for (int i = 0; i < 10; i++) {
+    buffer.push(parabolaPoint(0.5 * i));
+  }
+
+  UAV_reference reference;
+  ASSERT_TRUE(buffer.sample(1.3, reference));
+  EXPECT_NEAR(reference.position.x(), 1.3 * 1.3, 1e-12);
+  EXPECT_NEAR(reference.velocity.x(), 2.6, 1e-12);
+  EXPECT_NEAR(reference.acceleration.x(), 2.0, 1e-12);
+}
+
+TEST(TrajectoryReferenceBuffer, HoldsEndsAndWrapsYaw) {
+  TrajectoryReferenceBuffer buffer;
+  UAV_reference reference;
+  EXPECT_FALSE(buffer.sample(0.0, reference));
+
+  Timed_reference a = parabolaPoint(1.0);
+  Timed_reference b = parabolaPoint(2.0);
+  a.reference.yaw   = 3.0;
+  b.reference.yaw   = -3.0;
+  buffer.push(a);
+  buffer.push(b);
+
+  ASSERT_TRUE(buffer.sample(0.0, reference));
+  EXPECT_EQ(reference.position, a.reference.position);
+  ASSERT_TRUE(buffer.sample(5.0, reference));
+  EXPECT_EQ(reference.position, b.reference.position);
+
+  // Midpoint goes through +-pi, not through zero
+  ASSERT_TRUE(buffer.sample(1.5, reference));
+  EXPECT_NEAR(std::abs(reference.yaw), M_PI, 1e-12);
+}
+
+TEST(TrajectoryReferenceBuffer, ReplanDropsStoredFutureAndCapacityIsBounded) {
+  TrajectoryReferenceBuffer buffer;
+  for (int i = 0; i < 10; i++) {
+    buffer.push(parabolaPoint(i));
+  }
+  buffer.push(parabolaPoint(4.5));
+  EXPECT_EQ(buffer.size(), 6u);
+
+  buffer.discardBefore(2.5);
+  EXPECT_EQ(buffer.size(), 4u);
+
+  for (std::size_t i = 0; i < 2 * TrajectoryReferenceBuffer::capacity; i++) {
+    buffer.push(parabolaPoint(10.0 + i));
+  }
+  EXPECT_EQ(buffer.size(), TrajectoryReferenceBuffer::capacity);
+}
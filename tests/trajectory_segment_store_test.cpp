@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "trajectory_segment_store.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+/* x(tau) = 1 + 2 tau + 3 tau^2 + tau^3, y(tau) = tau^7, constant z and yaw */
+Trajectory_segment cubicSegment(double start, double duration) {
+  Trajectory_segment segment;
+  segment.start              = start;
+  segment.duration           = duration;
+  segment.coefficients(0, 0) = 1.0;
+  segment.coefficients(0, 1) = 2.0;
+  segment.coefficients(0, 2) = 3.0;
+  segment.coefficients(0, 3) = 1.0;
+  segment.coefficients(1, 7) = 1.0;
+  segment.coefficients(2, 0) = 1.5;
+  segment.coefficients(3, 0) = 0.5;
+  return segment;
+}
+
+}  // namespace
+
+TEST(TrajectorySegmentStore, HornerMatchesPolynomialAndDerivatives) {
+  const Trajectory_segment segment = cubicSegment(10.0, 2.0);
+  UAV_reference reference;
+  evaluateTrajectorySegment(segment, 10.5, reference);
+
+  const double tau = 0.5;
+  EXPECT_NEAR(reference.position.x(), 1.0 + 2.0 * tau + 3.0 * tau * tau + tau * tau * tau, 1e-12);
+  EXPECT_NEAR(reference.velocity.x(), 2.0 + 6.0 * tau + 3.0 * tau * tau, 1e-12);
+  EXPECT_NEAR(reference.acceleration.x(), 6.0 + 6.0 * tau, 1e-12);
+  EXPECT_NEAR(reference.position.y(), std::pow(tau, 7), 1e-12);
+  EXPECT_NEAR(reference.velocity.y(), 7.0 * std::pow(tau, 6), 1e-12);
+  EXPECT_NEAR(reference.acceleration.y(), 42.0 * std::pow(tau, 5), 1e-12);
+  EXPECT_EQ(reference.position.z(), 1.5);
+  EXPECT_EQ(reference.yaw, 0.5);
+}
+
+TEST(TrajectorySegmentStore, ParsesRecordsAndRejectsInvalidOnes) {
+  std::vector<double> record(segment_record_size, 0.0);
+  record[0]                                 = 3.0;
+  record[1]                                 = 0.5;
+  record[2 + 1]                             = 2.0;  // x_1
+  record[2 + 3 * segment_coefficient_count] = 1.0;  // yaw_0
+
+  Trajectory_segment segment;
+  ASSERT_TRUE(parseTrajectorySegment(record.data(), segment));
+  EXPECT_EQ(segment.start, 3.0);
+  EXPECT_EQ(segment.duration, 0.5);
+  EXPECT_EQ(segment.coefficients(0, 1), 2.0);
+  EXPECT_EQ(segment.coefficients(3, 0), 1.0);
+
+  record[1] = 0.0;
+  EXPECT_FALSE(parseTrajectorySegment(record.data(), segment));
+  record[1] = 0.5;
+  record[5] = NAN;
+  EXPECT_FALSE(parseTrajectorySegment(record.data(), segment));
+}
+
+TEST(TrajectorySegmentStore, HoldsEndThroughGapsAndReplans) {
+  TrajectorySegmentStore store;
+  UAV_reference reference;
+  EXPECT_FALSE(store.sample(0.0, reference));
+
+  store.push(cubicSegment(0.0, 1.0));
+  store.push(cubicSegment(2.0, 1.0));
+
+  // Before the first segment its start is used
+  ASSERT_TRUE(store.sample(-1.0, reference));
+  EXPECT_EQ(reference.position.x(), 1.0);
+
+  // In the gap the end of the first segment is held at rest
+  ASSERT_TRUE(store.sample(1.5, reference));
+  EXPECT_NEAR(reference.position.x(), 7.0, 1e-12);
+  EXPECT_EQ(reference.velocity, Eigen::Vector3d::Zero());
+  EXPECT_EQ(reference.acceleration, Eigen::Vector3d::Zero());
+
+  ASSERT_TRUE(store.sample(2.0, reference));
+  EXPECT_EQ(reference.position.x(), 1.0);
+
+  // A replan starting inside the first segment replaces the second one
+  store.push(cubicSegment(0.5, 10.0));
+  EXPECT_EQ(store.size(), 2u);
+  ASSERT_TRUE(store.sample(2.5, reference));
+  EXPECT_NEAR(reference.velocity.x(), 2.0 + 6.0 * 2.0 + 3.0 * 4.0, 1e-12);
+
+  store.discardBefore(2.5);
+  EXPECT_EQ(store.size(), 1u);
+}
+
+TEST(TrajectorySegmentStore, CapacityIsBounded) {
+  TrajectorySegmentStore store;
+  for (std::size_t i = 0; i < 2 * TrajectorySegmentStore::capacity; i++) {
+    store.push(cubicSegment(static_cast<double>(i), 1.0));
+  }
+  EXPECT_EQ(store.size(), TrajectorySegmentStore::capacity);
+
+  UAV_reference reference;
+  ASSERT_TRUE(store.sample(0.0, reference));
+  EXPECT_EQ(reference.position.x(), 1.0);  // first kept segment, evaluated at its start
+}
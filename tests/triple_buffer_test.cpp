@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include <Eigen/Core>
+
+#include "DF_control_law.hpp"
+#include "triple_buffer.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+constexpr uint64_t n_writes = 2000000;
+
+/* Non trivially copyable payload, every field holds the write index */
+struct Snapshot {
+  uint64_t index = 0;
+  UAV_reference reference;
+  Eigen::Matrix3d rotation = Eigen::Matrix3d::Zero();
+};
+
+void fill(Snapshot &snapshot, uint64_t index) {
+  const double value              = static_cast<double>(index);
+  snapshot.index                  = index;
+  snapshot.reference.position     = Eigen::Vector3d::Constant(value);
+  snapshot.reference.velocity     = Eigen::Vector3d::Constant(value);
+  snapshot.reference.acceleration = Eigen::Vector3d::Constant(value);
+  snapshot.reference.yaw          = value;
+  snapshot.rotation               = Eigen::Matrix3d::Constant(value);
+}
+
+bool consistent(const Snapshot &snapshot) {
+  const double value = static_cast<double>(snapshot.index);
+  return snapshot.reference.position == Eigen::Vector3d::Constant(value) &&
+         snapshot.reference.velocity == Eigen::Vector3d::Constant(value) &&
+         snapshot.reference.acceleration == Eigen::Vector3d::Constant(value) &&
+         snapshot.reference.yaw == value && snapshot.rotation == Eigen::Matrix3d::Constant(value);
+}
+
+}  // namespace
+
+TEST(TripleBuffer, ReaderOnlySeesNewValuesAfterPublish) {
+  TripleBuffer<int> buffer;
+  EXPECT_FALSE(buffer.update());
+
+  buffer.write(1);
+  buffer.write(2);
+  ASSERT_TRUE(buffer.update());
+  EXPECT_EQ(buffer.read(), 2);
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(buffer.read(), 2);
+
+  buffer.writeBuffer() = 3;
+  EXPECT_FALSE(buffer.update());
+  buffer.publish();
+  ASSERT_TRUE(buffer.update());
+  EXPECT_EQ(buffer.read(), 3);
+}
+
+/* Writer hammers the buffer while the reader polls it. Build with -DENABLE_TSAN=ON to run it
+ * under ThreadSanitizer */
+TEST(TripleBuffer, ConcurrentWriterAndReaderNeverTear) {
+  TripleBuffer<Snapshot> buffer;
+  std::atomic<bool> done{false};
+
+  std::thread writer([&]() {
+    for (uint64_t i = 1; i <= n_writes; i++) {
+      fill(buffer.writeBuffer(), i);
+      buffer.publish();
+    }
+    done = true;
+  });
+
+  uint64_t last_index = 0;
+  uint64_t reads      = 0;
+  bool torn           = false;
+  bool backwards      = false;
+  const auto take = [&]() {
+    const Snapshot &snapshot = buffer.read();
+    torn |= !consistent(snapshot);
+    backwards |= snapshot.index <= last_index;
+    last_index = snapshot.index;
+    reads++;
+  };
+  while (!done) {
+    if (buffer.update()) {
+      take();
+    }
+  }
+  writer.join();
+  // The last value may be published after the final poll above
+  if (buffer.update()) {
+    take();
+  }
+
+  EXPECT_FALSE(torn);
+  EXPECT_FALSE(backwards);
+  EXPECT_EQ(last_index, n_writes);
+  EXPECT_GT(reads, 0u);
+}
@@ -0,0 +1,181 @@
+/*!*******************************************************************************************
+ *  \file       control_law_replay.cpp
+ *  \brief      Replay recorded flights through the control law and compare the commands.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "DF_control_law.hpp"
+#include "controller_config.hpp"
+#include "flight_log.hpp"
+#include "flight_replay.hpp"
+#include "thread_pool.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+struct Replay_config {
+  DF_controller_config controller;
+  Replay_options options;
+  std::size_t threads = 0;
+  std::string output_dir;
+  std::vector<std::string> flights;
+};
+
+void printUsage() {
+  std::fprintf(stderr,
+               "Usage: control_law_replay --gains FILE [--threads N] [--output-dir DIR]\n"
+               "                          FLIGHT...\n"
+               "\n"
+               "FLIGHT is a .csv or binary flight log, see flight_log.hpp.\n"
+               "FILE is a ROS 2 parameter file of the plugin, e.g.\n"
+               "config/default_controller.yaml. The integral is cleared before every tick as\n"
+               "in the plugin, unless FILE sets trajectory_control.reset_integral to false.\n");
+}
+
+bool parseArguments(int argc, char **argv, Replay_config &_config) {
+  bool gains_read = false;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--gains" && i + 1 < argc) {
+      std::string error;
+      if (!loadControllerConfig(argv[++i], _config.controller, error)) {
+        std::fprintf(stderr, "Gains file: %s\n", error.c_str());
+        return false;
+      }
+      gains_read                               = true;
+      _config.options.reset_integral_each_tick = _config.controller.reset_integral;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      _config.threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--output-dir" && i + 1 < argc) {
+      _config.output_dir = argv[++i];
+    } else if (arg.rfind("--", 0) == 0) {
+      return false;
+    } else {
+      _config.flights.push_back(arg);
+    }
+  }
+  return gains_read && !_config.flights.empty();
+}
+
+bool saveCommands(const std::string &_path, const std::vector<Acro_command> &_commands) {
+  std::ofstream file(_path);
+  if (!file) {
+    return false;
+  }
+  file << "p,q,r,thrust\n";
+  file.precision(17);
+  for (const Acro_command &command : _commands) {
+    file << command.PQR.x() << "," << command.PQR.y() << "," << command.PQR.z() << ","
+         << command.thrust << "\n";
+  }
+  return static_cast<bool>(file);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Replay_config config;
+  if (!parseArguments(argc, argv, config)) {
+    printUsage();
+    return 1;
+  }
+
+  DFControlLawVariant prototype;
+  if (!makeControlLaw(config.controller, prototype)) {
+    const DF_controller_config &controller = config.controller;
+    std::fprintf(stderr, "Unknown control law: %s, %s, %s\n", controller.scalar_type.c_str(),
+                 controller.gain_structure.c_str(), controller.antiwindup.c_str());
+    return 1;
+  }
+
+  const std::size_t n_flights = config.flights.size();
+  std::vector<Replay_statistics> statistics(n_flights);
+  std::vector<std::string> errors(n_flights);
+
+  ThreadPool pool(config.threads);
+  const auto start = std::chrono::steady_clock::now();
+
+  // Every flight is independent: its own log, law copy and command trace
+  pool.parallelFor(n_flights, [&](std::size_t i) {
+    Flight_log log;
+    if (!loadFlightLog(config.flights[i], log, errors[i])) {
+      return;
+    }
+
+    DFControlLawVariant law = prototype;
+    std::vector<Acro_command> commands;
+    const bool keep_commands = !config.output_dir.empty();
+    statistics[i] = replayFlight(log, law, config.options, keep_commands ? &commands : nullptr);
+
+    if (keep_commands &&
+        !saveCommands(config.output_dir + "/" + log.name + ".commands.csv", commands)) {
+      errors[i] = "can not write the command trace";
+    }
+  });
+
+  const double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  Replay_statistics total;
+  int failed = 0;
+  std::printf("%-32s %10s %14s %14s %14s %14s\n", "flight", "ticks", "rms_pqr", "max_pqr",
+              "rms_thrust", "max_thrust");
+  for (std::size_t i = 0; i < n_flights; i++) {
+    if (!errors[i].empty()) {
+      std::fprintf(stderr, "%s: %s\n", config.flights[i].c_str(), errors[i].c_str());
+      failed++;
+      continue;
+    }
+    const Replay_statistics &s = statistics[i];
+    std::printf("%-32s %10lu %14.6e %14.6e %14.6e %14.6e\n", config.flights[i].c_str(),
+                static_cast<unsigned long>(s.ticks), s.rmsPQRError(), s.max_pqr_error,
+                s.rmsThrustError(), s.max_thrust_error);
+    total.merge(s);
+  }
+  std::printf("%-32s %10lu %14.6e %14.6e %14.6e %14.6e\n", "total",
+              static_cast<unsigned long>(total.ticks), total.rmsPQRError(), total.max_pqr_error,
+              total.rmsThrustError(), total.max_thrust_error);
+  std::printf("%zu flights on %zu threads in %.3f s, %.2f Mticks/s (loading included)\n",
+              n_flights, pool.size(), elapsed, total.ticks / elapsed * 1e-6);
+
+  return failed ? 1 : 0;
+}
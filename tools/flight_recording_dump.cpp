@@ -0,0 +1,164 @@
+/*!*******************************************************************************************
+ *  \file       flight_recording_dump.cpp
+ *  \brief      Reader of the flight recorder files, summary and conversion to CSV or flight log.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "flight_log.hpp"
+#include "flight_recorder.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+constexpr const char *flight_record_csv_header =
+    "stamp,dt,x,y,z,vx,vy,vz,qw,qx,qy,qz,ref_x,ref_y,ref_z,ref_vx,ref_vy,ref_vz,ref_ax,ref_ay,"
+    "ref_az,ref_yaw,ex,ey,ez,evx,evy,evz,ix,iy,iz,fx,fy,fz,r00,r01,r02,r10,r11,r12,r20,r21,r22,"
+    "e_rot_x,e_rot_y,e_rot_z,p,q,r,thrust";
+
+struct Dump_config {
+  std::string recording;
+  std::string csv;
+  std::string flight_log;
+};
+
+void printUsage() {
+  std::fprintf(stderr,
+               "Usage: flight_recording_dump RECORDING [--csv FILE] [--flight-log FILE]\n"
+               "\n"
+               "RECORDING is a .dfrec file written by trajectory_control.recorder.\n"
+               "Prints a summary, --csv writes every field of every tick and --flight-log\n"
+               "writes the inputs and commands as a binary flight log for control_law_replay.\n");
+}
+
+bool parseArguments(int argc, char **argv, Dump_config &_config) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--csv" && i + 1 < argc) {
+      _config.csv = argv[++i];
+    } else if (arg == "--flight-log" && i + 1 < argc) {
+      _config.flight_log = argv[++i];
+    } else if (arg.rfind("--", 0) == 0 || !_config.recording.empty()) {
+      return false;
+    } else {
+      _config.recording = arg;
+    }
+  }
+  return !_config.recording.empty();
+}
+
+bool saveCSV(const std::string &_path, const std::vector<Flight_record> &_records) {
+  std::ofstream file(_path);
+  if (!file) {
+    return false;
+  }
+  file << flight_record_csv_header << "\n";
+  file.precision(17);
+  for (const Flight_record &record : _records) {
+    const double *fields = reinterpret_cast<const double *>(&record);
+    for (std::size_t i = 0; i < flight_record_fields; i++) {
+      file << fields[i] << (i + 1 < flight_record_fields ? "," : "\n");
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+void printSummary(const std::vector<Flight_record> &_records) {
+  double position_error = 0.0;
+  double max_e_rot      = 0.0;
+  double max_dt         = 0.0;
+  std::size_t gaps      = 0;
+  for (std::size_t i = 0; i < _records.size(); i++) {
+    const Flight_record &record = _records[i];
+    const Eigen::Vector3d error(record.position_error);
+    position_error += error.squaredNorm();
+    max_e_rot = std::max(max_e_rot, Eigen::Vector3d(record.E_rot).norm());
+    max_dt    = std::max(max_dt, record.dt);
+    if (i > 0 && record.stamp - _records[i - 1].stamp > 2.0 * record.dt) {
+      gaps++;
+    }
+  }
+  const double duration = _records.back().stamp - _records.front().stamp;
+  std::printf("%zu ticks over %.3f s, %.1f Hz mean, max dt %.4f s, %zu gaps\n", _records.size(),
+              duration, duration > 0.0 ? (_records.size() - 1) / duration : 0.0, max_dt,
+              gaps);
+  std::printf("RMS position error %.4f m, max attitude error %.4f\n",
+              std::sqrt(position_error / _records.size()), max_e_rot);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Dump_config config;
+  if (!parseArguments(argc, argv, config)) {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<Flight_record> records;
+  std::string error;
+  if (!loadFlightRecording(config.recording, records, error)) {
+    std::fprintf(stderr, "%s: %s\n", config.recording.c_str(), error.c_str());
+    return 1;
+  }
+  if (records.empty()) {
+    std::printf("Empty recording\n");
+    return 0;
+  }
+  printSummary(records);
+
+  if (!config.csv.empty() && !saveCSV(config.csv, records)) {
+    std::fprintf(stderr, "Can not write %s\n", config.csv.c_str());
+    return 1;
+  }
+  if (!config.flight_log.empty()) {
+    Flight_log log;
+    log.samples.reserve(records.size());
+    for (const Flight_record &record : records) {
+      log.samples.push_back(toFlightSample(record));
+    }
+    if (!saveFlightLogBinary(config.flight_log, log)) {
+      std::fprintf(stderr, "Can not write %s\n", config.flight_log.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
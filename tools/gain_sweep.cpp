@@ -0,0 +1,315 @@
+/*!*******************************************************************************************
+ *  \file       gain_sweep.cpp
+ *  \brief      Evaluate grids of controller gains in closed loop simulation.
+ *  \authors    Miguel Fernández Cortizas
+ *              Rafael Pérez Seguí
+ *              Pedro Arias Pérez
+ *              David Pérez Saura
+ *
+ *  \copyright  Copyright (c) 2022 Universidad Politécnica de Madrid
+ *              All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************************/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "DF_control_law.hpp"
+#include "closed_loop_simulation.hpp"
+#include "controller_config.hpp"
+#include "thread_pool.hpp"
+
+using namespace controller_plugin_differential_flatness;
+
+namespace {
+
+/* One dimension of the grid: the parameters it writes and the values it takes */
+struct Sweep_axis {
+  std::string name;
+  std::vector<DF_parameter> parameters;
+  std::vector<double> values;
+};
+
+struct Sweep_config {
+  DF_controller_config controller;
+  Simulation_options simulation;
+  std::vector<Reference_trajectory> trajectories;
+  std::vector<std::string> trajectory_names;
+  std::vector<Sweep_axis> axes;
+  std::size_t threads = 0;
+  std::size_t top     = 10;
+  std::string csv_path;
+};
+
+void printUsage() {
+  std::fprintf(stderr,
+               "Usage: gain_sweep --gains FILE --sweep NAME=VALUES [--sweep NAME=VALUES]...\n"
+               "                  [--trajectory step|circle|lemniscate|all] [--duration S]\n"
+               "                  [--dt S] [--mass-scale X] [--threads N] [--top N] [--csv FILE]\n"
+               "\n"
+               "FILE is the base configuration, a ROS 2 parameter file of the plugin, e.g.\n"
+               "config/default_controller.yaml. NAME is a gain parameter, e.g.\n"
+               "trajectory_control.kp.x, or a group without the axis, e.g.\n"
+               "trajectory_control.kd, which sets x, y and z. VALUES is a list 'a,b,c' or a\n"
+               "range 'first:last:count'. The ki axes only matter when FILE sets\n"
+               "trajectory_control.reset_integral to false, as in the plugin.\n");
+}
+
+bool parseValues(const std::string &_spec, std::vector<double> &_values) {
+  const std::size_t first_colon = _spec.find(':');
+  if (first_colon != std::string::npos) {
+    const std::size_t second_colon = _spec.find(':', first_colon + 1);
+    if (second_colon == std::string::npos) {
+      return false;
+    }
+    const double first = std::strtod(_spec.c_str(), nullptr);
+    const double last  = std::strtod(_spec.c_str() + first_colon + 1, nullptr);
+    const long count   = std::strtol(_spec.c_str() + second_colon + 1, nullptr, 10);
+    if (count < 1) {
+      return false;
+    }
+    for (long i = 0; i < count; i++) {
+      _values.push_back(count == 1 ? first : first + (last - first) * i / (count - 1));
+    }
+    return true;
+  }
+
+  const char *cursor = _spec.c_str();
+  while (*cursor) {
+    char *end = nullptr;
+    _values.push_back(std::strtod(cursor, &end));
+    if (end == cursor || (*end != ',' && *end != '\0')) {
+      return false;
+    }
+    cursor = *end ? end + 1 : end;
+  }
+  return !_values.empty();
+}
+
+bool parseSweep(const std::string &_spec, Sweep_axis &_axis) {
+  const std::size_t separator = _spec.find('=');
+  if (separator == std::string::npos) {
+    return false;
+  }
+  _axis.name = _spec.substr(0, separator);
+
+  DF_gains scratch;
+  const DF_parameter parameter = findParameter(_axis.name);
+  if (setGainParameter(parameter, 0.0, scratch)) {
+    _axis.parameters.push_back(parameter);
+  } else {
+    for (const char *suffix : {".x", ".y", ".z"}) {
+      const DF_parameter axis_parameter = findParameter(_axis.name + suffix);
+      if (!setGainParameter(axis_parameter, 0.0, scratch)) {
+        return false;
+      }
+      _axis.parameters.push_back(axis_parameter);
+    }
+  }
+  return parseValues(_spec.substr(separator + 1), _axis.values);
+}
+
+bool parseTrajectories(const std::string &_name, Sweep_config &_config) {
+  _config.trajectories.clear();
+  _config.trajectory_names.clear();
+  for (const char *name : {"step", "circle", "lemniscate"}) {
+    Reference_trajectory trajectory;
+    parseReferenceTrajectory(name, trajectory);
+    if (_name == "all" || _name == name) {
+      _config.trajectories.push_back(trajectory);
+      _config.trajectory_names.push_back(name);
+    }
+  }
+  return !_config.trajectories.empty();
+}
+
+bool parseArguments(int argc, char **argv, Sweep_config &_config) {
+  bool gains_read = false;
+  parseTrajectories("all", _config);
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const std::string value = argv[++i];
+    if (arg == "--gains") {
+      std::string error;
+      if (!loadControllerConfig(value, _config.controller, error)) {
+        std::fprintf(stderr, "Gains file: %s\n", error.c_str());
+        return false;
+      }
+      gains_read = true;
+    } else if (arg == "--sweep") {
+      Sweep_axis axis;
+      if (!parseSweep(value, axis)) {
+        std::fprintf(stderr, "Bad sweep: %s\n", value.c_str());
+        return false;
+      }
+      _config.axes.push_back(axis);
+    } else if (arg == "--trajectory") {
+      if (!parseTrajectories(value, _config)) {
+        return false;
+      }
+    } else if (arg == "--duration") {
+      _config.simulation.duration = std::strtod(value.c_str(), nullptr);
+    } else if (arg == "--dt") {
+      _config.simulation.control_dt = std::strtod(value.c_str(), nullptr);
+    } else if (arg == "--mass-scale") {
+      _config.simulation.mass_scale = std::strtod(value.c_str(), nullptr);
+    } else if (arg == "--threads") {
+      _config.threads = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (arg == "--top") {
+      _config.top = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (arg == "--csv") {
+      _config.csv_path = value;
+    } else {
+      return false;
+    }
+  }
+  return gains_read && !_config.axes.empty();
+}
+
+/* Value of every axis for grid point _index, the first axis changes fastest */
+void gridPoint(const Sweep_config &_config, std::size_t _index, std::vector<double> &_values) {
+  _values.resize(_config.axes.size());
+  for (std::size_t a = 0; a < _config.axes.size(); a++) {
+    const std::vector<double> &axis_values = _config.axes[a].values;
+    _values[a]                             = axis_values[_index % axis_values.size()];
+    _index /= axis_values.size();
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Sweep_config config;
+  if (!parseArguments(argc, argv, config)) {
+    printUsage();
+    return 1;
+  }
+
+  std::size_t n_points = 1;
+  for (const Sweep_axis &axis : config.axes) {
+    n_points *= axis.values.size();
+  }
+  const std::size_t n_trajectories = config.trajectories.size();
+  std::vector<Tracking_metrics> metrics(n_points * n_trajectories);
+  std::vector<char> valid(n_points, 1);
+
+  ThreadPool pool(config.threads);
+  const auto start = std::chrono::steady_clock::now();
+
+  pool.parallelFor(metrics.size(), [&](std::size_t task) {
+    const std::size_t point = task / n_trajectories;
+    std::vector<double> values;
+    gridPoint(config, point, values);
+
+    DF_controller_config controller = config.controller;
+    for (std::size_t a = 0; a < config.axes.size(); a++) {
+      for (DF_parameter parameter : config.axes[a].parameters) {
+        setGainParameter(parameter, values[a], controller.gains);
+      }
+    }
+
+    DFControlLawVariant law;
+    if (!makeControlLaw(controller, law)) {
+      valid[point] = 0;
+      return;
+    }
+    Simulation_options simulation = config.simulation;
+    simulation.trajectory               = config.trajectories[task % n_trajectories];
+    simulation.reset_integral_each_tick = controller.reset_integral;
+    metrics[task]                       = simulateClosedLoop(law, simulation);
+  });
+
+  const double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Rank by the RMS position error summed over the trajectories, diverged runs last
+  std::vector<double> scores(n_points, 0.0);
+  for (std::size_t point = 0; point < n_points; point++) {
+    for (std::size_t t = 0; t < n_trajectories; t++) {
+      const Tracking_metrics &m = metrics[point * n_trajectories + t];
+      scores[point] += m.diverged || !valid[point] ? std::numeric_limits<double>::infinity()
+                                                   : m.rms_position_error;
+    }
+  }
+  std::vector<std::size_t> order(n_points);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&scores](std::size_t a, std::size_t b) { return scores[a] < scores[b]; });
+
+  std::vector<double> values;
+  std::printf("Best %zu of %zu configurations (score: RMS position error summed over",
+              std::min(config.top, n_points), n_points);
+  for (const std::string &name : config.trajectory_names) {
+    std::printf(" %s", name.c_str());
+  }
+  std::printf(")\n");
+  for (std::size_t rank = 0; rank < std::min(config.top, n_points); rank++) {
+    const std::size_t point = order[rank];
+    gridPoint(config, point, values);
+    std::printf("%3zu  score %10.4f ", rank + 1, scores[point]);
+    for (std::size_t a = 0; a < config.axes.size(); a++) {
+      std::printf(" %s=%g", config.axes[a].name.c_str(), values[a]);
+    }
+    std::printf("\n");
+  }
+
+  if (!config.csv_path.empty()) {
+    std::ofstream csv(config.csv_path);
+    for (const Sweep_axis &axis : config.axes) {
+      csv << axis.name << ",";
+    }
+    csv << "trajectory,diverged,rms_position_error,max_position_error,rms_velocity_error,"
+           "rms_yaw_error,max_tilt\n";
+    for (std::size_t point = 0; point < n_points; point++) {
+      gridPoint(config, point, values);
+      for (std::size_t t = 0; t < n_trajectories; t++) {
+        const Tracking_metrics &m = metrics[point * n_trajectories + t];
+        for (double value : values) {
+          csv << value << ",";
+        }
+        csv << config.trajectory_names[t] << "," << (m.diverged || !valid[point]) << ","
+            << m.rms_position_error << "," << m.max_position_error << ","
+            << m.rms_velocity_error << "," << m.rms_yaw_error << "," << m.max_tilt << "\n";
+      }
+    }
+  }
+
+  const double simulated = metrics.size() * config.simulation.duration;
+  std::printf("%zu runs on %zu threads in %.3f s, %.0fx real time\n", metrics.size(),
+              pool.size(), elapsed, simulated / elapsed);
+  return 0;
+}